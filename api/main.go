@@ -22,6 +22,7 @@ type PassConfig struct {
 	Global struct {
 		Enabled      bool   `yaml:"enabled"       json:"enabled"`
 		PluginDir    string `yaml:"plugin_dir"    json:"plugin_dir,omitempty"`
+		ToolsDir     string `yaml:"tools_dir"     json:"tools_dir,omitempty"`
 		StripSymbols bool   `yaml:"strip_symbols" json:"strip_symbols"`
 	} `yaml:"global" json:"global"`
 	Passes struct {
@@ -30,27 +31,62 @@ type PassConfig struct {
 			Threshold int  `yaml:"threshold"  json:"threshold,omitempty"`
 		} `yaml:"split_basic_block" json:"split_basic_block"`
 		Flattening struct {
-			Enabled     bool    `yaml:"enabled"     json:"enabled"`
-			Probability float64 `yaml:"probability" json:"probability,omitempty"`
+			Enabled       bool    `yaml:"enabled"        json:"enabled"`
+			Probability   float64 `yaml:"probability"    json:"probability,omitempty"`
+			Dispatch      string  `yaml:"dispatch"       json:"dispatch,omitempty"`
+			RegisterState bool    `yaml:"register_state" json:"register_state,omitempty"`
+			KeepHotLoops  bool    `yaml:"keep_hot_loops" json:"keep_hot_loops,omitempty"`
+			HotLoopRatio  float64 `yaml:"hot_loop_ratio" json:"hot_loop_ratio,omitempty"`
+			Threaded      float64 `yaml:"threaded"       json:"threaded,omitempty"`
+			Fanout        int     `yaml:"fanout"         json:"fanout,omitempty"`
 		} `yaml:"flattening" json:"flattening"`
 		OpaquePredicate struct {
 			Enabled     bool    `yaml:"enabled"     json:"enabled"`
 			Probability float64 `yaml:"probability" json:"probability,omitempty"`
 		} `yaml:"opaque_predicate" json:"opaque_predicate"`
 		StringEncryption struct {
-			Enabled bool `yaml:"enabled" json:"enabled"`
+			Enabled         bool   `yaml:"enabled"          json:"enabled"`
+			Mode            string `yaml:"mode"             json:"mode,omitempty"`
+			MaxSize         int    `yaml:"max_size"         json:"max_size,omitempty"`
+			LargePolicy     string `yaml:"large_policy"     json:"large_policy,omitempty"`
+			Cipher          string `yaml:"cipher"           json:"cipher,omitempty"`
+			Prefold         string `yaml:"prefold"          json:"prefold,omitempty"`
+			TransientBudget uint64 `yaml:"transient_budget" json:"transient_budget,omitempty"`
 		} `yaml:"string_encryption" json:"string_encryption"`
 		FunctionOutlining struct {
 			Enabled bool `yaml:"enabled" json:"enabled"`
 		} `yaml:"function_outlining" json:"function_outlining"`
 		AntiDebugging struct {
-			Enabled bool `yaml:"enabled" json:"enabled"`
+			Enabled           bool    `yaml:"enabled"            json:"enabled"`
+			TimingProbability float64 `yaml:"timing_probability" json:"timing_probability,omitempty"`
+			TimingBudget      float64 `yaml:"timing_budget"      json:"timing_budget,omitempty"`
+			TimingLimitMs     *uint64 `yaml:"timing_limit_ms"    json:"timing_limit_ms,omitempty"`
+			TimingConfirm     bool    `yaml:"timing_confirm"     json:"timing_confirm,omitempty"`
 		} `yaml:"anti_debugging" json:"anti_debugging"`
 		APIHiding struct {
-			Enabled bool `yaml:"enabled" json:"enabled"`
+			Enabled      bool    `yaml:"enabled"        json:"enabled"`
+			Resolver     string  `yaml:"resolver"       json:"resolver,omitempty"`
+			HotCallRatio float64 `yaml:"hot_call_ratio" json:"hot_call_ratio,omitempty"`
+			Libcalls     string  `yaml:"libcalls"       json:"libcalls,omitempty"`
+			Report       string  `yaml:"report"         json:"report,omitempty"`
 		} `yaml:"api_hiding" json:"api_hiding"`
 		AntiTampering struct {
-			Enabled bool `yaml:"enabled" json:"enabled"`
+			Enabled        bool    `yaml:"enabled"         json:"enabled"`
+			Mode           string  `yaml:"mode"            json:"mode,omitempty"`
+			SampleRate     int     `yaml:"sample_rate"     json:"sample_rate,omitempty"`
+			Window         uint64  `yaml:"window"          json:"window,omitempty"`
+			Jitter         bool    `yaml:"jitter"          json:"jitter,omitempty"`
+			WatchdogPeriod uint64  `yaml:"watchdog_period" json:"watchdog_period,omitempty"`
+			WatchdogBudget uint64  `yaml:"watchdog_budget" json:"watchdog_budget,omitempty"`
+			Epoch          uint64  `yaml:"epoch"           json:"epoch,omitempty"`
+			Baseline       string  `yaml:"baseline"        json:"baseline,omitempty"`
+			FullLength     bool    `yaml:"full_length"     json:"full_length,omitempty"`
+			Hash           string  `yaml:"hash"            json:"hash,omitempty"`
+			Select         string  `yaml:"select"          json:"select,omitempty"`
+			MinSize        int     `yaml:"min_size"        json:"min_size,omitempty"`
+			HotRatio       float64 `yaml:"hot_ratio"       json:"hot_ratio,omitempty"`
+			Vouch          bool    `yaml:"vouch"           json:"vouch,omitempty"`
+			Report         string  `yaml:"report"          json:"report,omitempty"`
 		} `yaml:"anti_tampering" json:"anti_tampering"`
 	} `yaml:"passes" json:"passes"`
 }
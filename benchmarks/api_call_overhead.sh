@@ -0,0 +1,37 @@
+#!/bin/bash
+#
+# Measures the per-call cost of APIHiding on a hot libc call:
+#   plain  — direct call to strlen
+#   hidden — call through the APIHiding import slot (resolved in the loop preheader)
+#   exempt — APIHiding with HIDEIR_API_HOT_CALL_RATIO, which keeps the hot call direct
+#
+# Usage: benchmarks/api_call_overhead.sh [build dir] [iterations]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+ITERATIONS="${2:-50000000}"
+PLUGIN="$BUILD_DIR/plugins/libAPIHidingPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+# -fno-builtin keeps strlen an external call in both builds.
+clang -O2 -fno-builtin "$SCRIPT_DIR/api_call_overhead.c" -o "$WORK_DIR/plain"
+clang -O2 -fno-builtin -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/api_call_overhead.c" -o "$WORK_DIR/hidden" -ldl
+HIDEIR_API_HOT_CALL_RATIO=8 clang -O2 -fno-builtin -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/api_call_overhead.c" -o "$WORK_DIR/exempt" -ldl
+echo ""
+
+echo "=== Results ($ITERATIONS calls) ==="
+for variant in plain hidden exempt; do
+    read -r ns checksum < <("$WORK_DIR/$variant" "$ITERATIONS")
+    printf "  %-7s %8s ns/call\n" "$variant:" "$ns"
+done
@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# Measures how long APIHiding takes to resolve a module's imports on first use:
+#   plain   — direct calls, lazy PLT binding
+#   dlsym   — import slots filled one symbol at a time by dlsym(RTLD_DEFAULT)
+#   gnuhash — all import slots filled in one pass over the DT_GNU_HASH tables
+# Each variant runs several times; the median first-run and second-run cycle
+# counts are reported, and their difference is the resolution cost.
+#
+# Usage: benchmarks/api_resolve_startup.sh [build dir] [runs]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+RUNS="${2:-21}"
+PLUGIN="$BUILD_DIR/plugins/libAPIHidingPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+# -fno-builtin keeps every libc call an external call in all builds.
+clang -O2 -fno-builtin "$SCRIPT_DIR/api_resolve_startup.c" -o "$WORK_DIR/plain"
+HIDEIR_API_RESOLVER=dlsym clang -O2 -fno-builtin -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/api_resolve_startup.c" -o "$WORK_DIR/dlsym" -ldl
+HIDEIR_API_RESOLVER=gnuhash clang -O2 -fno-builtin -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/api_resolve_startup.c" -o "$WORK_DIR/gnuhash"
+echo ""
+
+echo "=== Results (median of $RUNS runs, cycles) ==="
+printf "  %-9s %12s %12s %12s\n" "" "first run" "second run" "resolution"
+for variant in plain dlsym gnuhash; do
+    for _ in $(seq "$RUNS"); do
+        "$WORK_DIR/$variant"
+    done | awk '{ print $1, $2 }' | sort -n > "$WORK_DIR/$variant.txt"
+    first=$(awk -v n="$RUNS" 'NR == int((n + 1) / 2) { print $1 }' "$WORK_DIR/$variant.txt")
+    second=$(sort -n -k2 "$WORK_DIR/$variant.txt" | awk -v n="$RUNS" 'NR == int((n + 1) / 2) { print $2 }')
+    printf "  %-9s %12s %12s %12s\n" "$variant:" "$first" "$second" "$((first - second))"
+done
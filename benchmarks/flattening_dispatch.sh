@@ -0,0 +1,56 @@
+#!/bin/bash
+#
+# Compares the flattened dispatcher designs against an unflattened baseline:
+#   indirect — BlockAddress state + indirectbr (default)
+#   switch   — dense integer state IDs + switch (HIDEIR_FLATTEN_DISPATCH=switch)
+#   threaded — indirect, with a dispatcher copy in every block (HIDEIR_FLATTEN_THREADED=1.0)
+#
+# Throughput comes from the benchmark itself; branch misses come from
+# `perf stat` when it is installed and permitted.
+#
+# Usage: benchmarks/flattening_dispatch.sh [build dir] [iterations]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+ITERATIONS="${2:-2000}"
+PLUGIN="$BUILD_DIR/plugins/libFlatteningPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+HAVE_PERF=false
+if command -v perf &>/dev/null && perf stat -e branch-misses true &>/dev/null; then
+    HAVE_PERF=true
+fi
+
+echo "=== Building benchmark variants ==="
+clang -O2 "$SCRIPT_DIR/flattening_dispatch.c" -o "$WORK_DIR/baseline"
+HIDEIR_FLATTEN_DISPATCH=indirect clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/flattening_dispatch.c" -o "$WORK_DIR/indirect"
+HIDEIR_FLATTEN_DISPATCH=switch clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/flattening_dispatch.c" -o "$WORK_DIR/switch"
+HIDEIR_FLATTEN_THREADED=1.0 clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/flattening_dispatch.c" -o "$WORK_DIR/threaded"
+echo ""
+
+echo "=== Results ($ITERATIONS iterations over 64 KiB) ==="
+for variant in baseline indirect switch threaded; do
+    printf "  %-9s " "$variant:"
+    "$WORK_DIR/$variant" "$ITERATIONS"
+    if $HAVE_PERF; then
+        perf stat -x, -e branches,branch-misses "$WORK_DIR/$variant" "$ITERATIONS" 2>&1 >/dev/null \
+            | awk -F, '/branches/ && !/misses/ { b = $1 } /branch-misses/ { m = $1 }
+                       END { if (b > 0) printf "            branch-misses: %d of %d (%.2f%%)\n", m, b, 100 * m / b }'
+    fi
+done
+
+if ! $HAVE_PERF; then
+    echo ""
+    echo "[!] perf not available; branch-miss rates skipped."
+fi
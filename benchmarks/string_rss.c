@@ -0,0 +1,51 @@
+/*
+ * Memory-sharing benchmark for StringEncryption.
+ *
+ * The binary embeds 10,000 distinct ~1 KiB string literals (about 10 MiB), of
+ * which each process reads every STRIDE-th one and then stays alive so the
+ * driver script can inspect its memory. With in-place decryption the strings
+ * live in writable .data and every page a process decrypts becomes private to
+ * it; in arena mode the ciphertext stays in shared .rodata and only the copies
+ * of the strings actually used take private memory.
+ *
+ * Usage: string_rss [stride]
+ * Prints a checksum once the strings are read, then waits for a signal.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAD16 "................"
+#define PAD256 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16 PAD16
+#define PAD1K PAD256 PAD256 PAD256 PAD256
+
+#define S(n) case n: return "hideir rss benchmark message #" #n " " PAD1K;
+#define D1(p) S(p##0) S(p##1) S(p##2) S(p##3) S(p##4) S(p##5) S(p##6) S(p##7) S(p##8) S(p##9)
+#define D2(p) D1(p##0) D1(p##1) D1(p##2) D1(p##3) D1(p##4) D1(p##5) D1(p##6) D1(p##7) D1(p##8) D1(p##9)
+#define D3(p) D2(p##0) D2(p##1) D2(p##2) D2(p##3) D2(p##4) D2(p##5) D2(p##6) D2(p##7) D2(p##8) D2(p##9)
+#define D4(p) D3(p##0) D3(p##1) D3(p##2) D3(p##3) D3(p##4) D3(p##5) D3(p##6) D3(p##7) D3(p##8) D3(p##9)
+
+/* Message IDs run from 10000 to 19999. */
+static const char *message(int id) {
+    switch (id) {
+        D4(1)
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char **argv) {
+    int stride = argc > 1 ? atoi(argv[1]) : 20;
+    if (stride < 1) stride = 1;
+
+    unsigned long checksum = 0;
+    for (int id = 10000; id < 20000; id += stride) {
+        checksum += strlen(message(id));
+    }
+    printf("%lu\n", checksum);
+    fflush(stdout);
+
+    pause();
+    return 0;
+}
@@ -0,0 +1,70 @@
+#!/bin/bash
+#
+# Measures the memory footprint of N concurrent processes with
+# StringEncryption:
+#   plain — no string encryption
+#   eager — every string decrypted in place before main (default)
+#   lazy  — each string decrypted in place on first use (HIDEIR_STRING_MODE=lazy)
+#   arena — ciphertext kept read-only, used strings decrypted into a private
+#           arena (HIDEIR_STRING_MODE=arena)
+#
+# Each process embeds ~10 MiB of strings and reads every STRIDE-th one. The
+# table shows the summed proportional set size (PSS) of all N processes and
+# the private dirty memory of one process, from /proc/<pid>/smaps_rollup.
+#
+# Usage: benchmarks/string_rss.sh [build dir] [processes] [stride]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+PROCS="${2:-32}"
+STRIDE="${3:-20}"
+PLUGIN="$BUILD_DIR/plugins/libStringEncryptionPass.so"
+WORK_DIR="$(mktemp -d)"
+PIDS=()
+trap 'kill "${PIDS[@]}" 2>/dev/null || true; rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+if [ ! -r /proc/self/smaps_rollup ]; then
+    echo "[-] /proc/<pid>/smaps_rollup is required (Linux 4.14+)."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+clang -O2 "$SCRIPT_DIR/string_rss.c" -o "$WORK_DIR/plain"
+for mode in eager lazy arena; do
+    HIDEIR_STRING_MODE=$mode clang -O2 -fpass-plugin="$PLUGIN" \
+        "$SCRIPT_DIR/string_rss.c" -o "$WORK_DIR/$mode"
+done
+echo ""
+
+echo "=== Results ($PROCS processes, every ${STRIDE}th string used) ==="
+for variant in plain eager lazy arena; do
+    PIDS=()
+    for ((i = 0; i < PROCS; i++)); do
+        "$WORK_DIR/$variant" "$STRIDE" > "$WORK_DIR/out.$i" &
+        PIDS+=($!)
+    done
+    # Wait until every process has read its strings.
+    for ((i = 0; i < PROCS; i++)); do
+        while [ ! -s "$WORK_DIR/out.$i" ]; do sleep 0.05; done
+    done
+
+    pss=0
+    for pid in "${PIDS[@]}"; do
+        kb=$(awk '/^Pss:/ { print $2 }' "/proc/$pid/smaps_rollup")
+        pss=$((pss + kb))
+    done
+    dirty=$(awk '/^Private_Dirty:/ { print $2 }' "/proc/${PIDS[0]}/smaps_rollup")
+
+    kill "${PIDS[@]}" 2>/dev/null
+    wait "${PIDS[@]}" 2>/dev/null || true
+    rm -f "$WORK_DIR"/out.*
+
+    awk -v v="$variant:" -v pss="$pss" -v dirty="$dirty" \
+        'BEGIN { printf "  %-7s %8.1f MB total PSS  %8d KB private dirty/process\n", v, pss / 1024, dirty }'
+done
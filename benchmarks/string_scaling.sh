@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Measures StringEncryption compile time and peak RSS on modules carrying
+# 1 MB, 10 MB and 100 MB of embedded string data (512 KiB i8 arrays, like
+# resource TUs with certificates and schemas). Each size is run through
+#   opt          — plain `opt` without the pass, the cost of reading the module
+#   encrypt      — the pass with its defaults
+#   skip-large   — HIDEIR_STRING_MAX_SIZE=65536 HIDEIR_STRING_LARGE_POLICY=skip
+#
+# Usage: benchmarks/string_scaling.sh [build dir]
+# Set LLVM_BIN to pick the opt/llvm-as binaries (default: from PATH).
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+PLUGIN="$BUILD_DIR/plugins/libStringEncryptionPass.so"
+OPT="${LLVM_BIN:+$LLVM_BIN/}opt"
+LLVM_AS="${LLVM_BIN:+$LLVM_BIN/}llvm-as"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+# Emit a module with <MB> megabytes of string data split into 512 KiB blobs.
+generate() {
+    python3 - "$1" <<'PY'
+import sys
+total = int(sys.argv[1]) * 1000 * 1000
+blob = 512 * 1024
+count = (total + blob - 1) // blob
+for b in range(count):
+    data = bytes((i * 31 + b) & 0xFF for i in range(blob))
+    print('@blob%d = private unnamed_addr constant [%d x i8] c"%s", align 1'
+          % (b, blob, ''.join('\\%02X' % c for c in data)))
+print('declare void @consume(ptr)')
+print('define void @use_all() {')
+for b in range(count):
+    print('  call void @consume(ptr @blob%d)' % b)
+print('  ret void\n}')
+PY
+}
+
+# Run a command and print its wall time and peak RSS.
+measure() {
+    python3 - "$@" <<'PY'
+import resource, subprocess, sys, time
+start = time.time()
+subprocess.run(sys.argv[1:], check=True)
+rss = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss // 1024
+print("%8.2f s %8d MB" % (time.time() - start, rss))
+PY
+}
+
+echo "=== Results (wall time, peak RSS) ==="
+for MB in 1 10 100; do
+    generate "$MB" | "$LLVM_AS" -o "$WORK_DIR/blobs.bc"
+    echo "  ${MB} MB of string data:"
+    printf "    %-11s" "opt:"
+    measure "$OPT" "$WORK_DIR/blobs.bc" -o /dev/null
+    printf "    %-11s" "encrypt:"
+    measure "$OPT" -load-pass-plugin="$PLUGIN" -passes=EnterpriseStringEncryption \
+        "$WORK_DIR/blobs.bc" -o /dev/null
+    printf "    %-11s" "skip-large:"
+    HIDEIR_STRING_MAX_SIZE=65536 HIDEIR_STRING_LARGE_POLICY=skip measure "$OPT" \
+        -load-pass-plugin="$PLUGIN" -passes=EnterpriseStringEncryption \
+        "$WORK_DIR/blobs.bc" -o /dev/null
+done
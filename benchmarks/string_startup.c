@@ -0,0 +1,35 @@
+/*
+ * Startup-latency benchmark for StringEncryption.
+ *
+ * The binary embeds 10,000 distinct string literals, the way a large CLI tool
+ * carries its help texts, messages and option names, but each run reads only
+ * the few selected on the command line. Eager mode decrypts all of them in a
+ * constructor before main; lazy mode decrypts only the strings that are used.
+ *
+ * Usage: string_startup [index...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define S(n) case n: return "hideir startup benchmark message #" #n " with some typical padding";
+#define D1(p) S(p##0) S(p##1) S(p##2) S(p##3) S(p##4) S(p##5) S(p##6) S(p##7) S(p##8) S(p##9)
+#define D2(p) D1(p##0) D1(p##1) D1(p##2) D1(p##3) D1(p##4) D1(p##5) D1(p##6) D1(p##7) D1(p##8) D1(p##9)
+#define D3(p) D2(p##0) D2(p##1) D2(p##2) D2(p##3) D2(p##4) D2(p##5) D2(p##6) D2(p##7) D2(p##8) D2(p##9)
+#define D4(p) D3(p##0) D3(p##1) D3(p##2) D3(p##3) D3(p##4) D3(p##5) D3(p##6) D3(p##7) D3(p##8) D3(p##9)
+
+/* Message IDs run from 10000 to 19999. */
+static const char *message(int id) {
+    switch (id) {
+        D4(1)
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t total = 0;
+    for (int i = 1; i < argc; ++i) total += strlen(message(10000 + atoi(argv[i])));
+    printf("%zu\n", total);
+    return 0;
+}
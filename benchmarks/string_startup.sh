@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# Measures process startup latency with StringEncryption:
+#   plain — no string encryption
+#   eager — every string decrypted by a constructor before main (default)
+#   lazy  — each string decrypted on first use (HIDEIR_STRING_MODE=lazy)
+#
+# Each variant embeds 10,000 strings and runs RUNS times while reading only
+# three of them; the table shows the mean wall time per run.
+#
+# Usage: benchmarks/string_startup.sh [build dir] [runs]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+RUNS="${2:-200}"
+PLUGIN="$BUILD_DIR/plugins/libStringEncryptionPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+clang -O2 "$SCRIPT_DIR/string_startup.c" -o "$WORK_DIR/plain"
+HIDEIR_STRING_MODE=eager clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/string_startup.c" -o "$WORK_DIR/eager"
+HIDEIR_STRING_MODE=lazy clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/string_startup.c" -o "$WORK_DIR/lazy"
+echo ""
+
+echo "=== Results (mean of $RUNS runs) ==="
+for variant in plain eager lazy; do
+    start=$(date +%s%N)
+    for ((i = 0; i < RUNS; i++)); do
+        "$WORK_DIR/$variant" 1 500 9999 >/dev/null
+    done
+    end=$(date +%s%N)
+    awk -v v="$variant:" -v ns=$((end - start)) -v n="$RUNS" \
+        'BEGIN { printf "  %-7s %8.1f us/run\n", v, ns / 1000 / n }'
+done
@@ -0,0 +1,55 @@
+/*
+ * Decryption-throughput benchmark for StringEncryption.
+ *
+ * The binary embeds 64 distinct 256 KiB strings (16 MiB in total) that the
+ * startup constructor decrypts before main. main reports the CPU time the
+ * process has used so far, so the difference to a plain build is the cost of
+ * the decryption kernel. The plain build writes to every page of the strings
+ * in a constructor (TOUCH_PAGES), so copy-on-write faults cancel out.
+ *
+ * Usage: string_throughput
+ * Prints "<cpu ns before main> <checksum of all strings>".
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define B16 "0123456789abcdef"
+#define B256 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16 B16
+#define B4K B256 B256 B256 B256 B256 B256 B256 B256 B256 B256 B256 B256 B256 B256 B256 B256
+#define B64K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K B4K
+#define B256K B64K B64K B64K B64K
+
+#define R8(p) X(p##0) X(p##1) X(p##2) X(p##3) X(p##4) X(p##5) X(p##6) X(p##7)
+#define R64 R8(1) R8(2) R8(3) R8(4) R8(5) R8(6) R8(7) R8(8)
+
+#define X(n) static char blob##n[] = B256K #n;
+R64
+#undef X
+
+#define X(n) blob##n,
+static char *const blobs[] = { R64 };
+#undef X
+
+#define BLOB_COUNT (sizeof(blobs) / sizeof(blobs[0]))
+
+#ifdef TOUCH_PAGES
+__attribute__((constructor)) static void touch_pages(void) {
+    for (size_t b = 0; b < BLOB_COUNT; ++b) {
+        size_t len = strlen(blobs[b]);
+        for (size_t i = 0; i < len; i += 4096) ((volatile char *)blobs[b])[i] ^= 0;
+    }
+}
+#endif
+
+int main(void) {
+    struct timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+    unsigned long checksum = 0;
+    for (size_t b = 0; b < BLOB_COUNT; ++b) {
+        for (const char *p = blobs[b]; *p; ++p) checksum = checksum * 31 + (unsigned char)*p;
+    }
+    printf("%lld %lu\n", (long long)cpu.tv_sec * 1000000000LL + cpu.tv_nsec, checksum);
+    return 0;
+}
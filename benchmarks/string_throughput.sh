@@ -0,0 +1,58 @@
+#!/bin/bash
+#
+# Measures the runtime decryption throughput of the StringEncryption ciphers:
+#   plain    — no string encryption (pages touched to match the others)
+#   xor      — 8-byte rolling XOR (HIDEIR_STRING_CIPHER=xor, default)
+#   chacha20 — ChaCha20 kernel (HIDEIR_STRING_CIPHER=chacha20)
+#
+# Each variant embeds 16 MiB of strings decrypted eagerly before main. The
+# table shows the fastest of RUNS runs and the throughput derived from the
+# difference to the plain build. Pass extra clang flags (e.g. -mavx2) after
+# the run count to compare SIMD levels.
+#
+# Usage: benchmarks/string_throughput.sh [build dir] [runs] [clang flags...]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+RUNS="${2:-20}"
+shift 2 2>/dev/null || shift $#
+CFLAGS=("$@")
+PLUGIN="$BUILD_DIR/plugins/libStringEncryptionPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+clang -O2 "${CFLAGS[@]}" -DTOUCH_PAGES "$SCRIPT_DIR/string_throughput.c" -o "$WORK_DIR/plain"
+for cipher in xor chacha20; do
+    HIDEIR_STRING_CIPHER=$cipher clang -O2 "${CFLAGS[@]}" -fpass-plugin="$PLUGIN" \
+        "$SCRIPT_DIR/string_throughput.c" -o "$WORK_DIR/$cipher"
+done
+echo ""
+
+echo "=== Results (best of $RUNS runs, 16 MiB of strings) ==="
+expected=""
+for variant in plain xor chacha20; do
+    best=""
+    for ((i = 0; i < RUNS; i++)); do
+        read -r ns checksum < <("$WORK_DIR/$variant")
+        if [ -z "$expected" ]; then expected="$checksum"; fi
+        if [ "$checksum" != "$expected" ]; then
+            echo "[-] $variant: checksum mismatch, strings were not decrypted correctly"
+            exit 1
+        fi
+        if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then best="$ns"; fi
+    done
+    if [ "$variant" = plain ]; then base="$best"; fi
+    awk -v v="$variant:" -v ns="$best" -v base="$base" 'BEGIN {
+        printf "  %-10s %8.2f ms before main", v, ns / 1e6
+        if (ns > base) printf "  %8.0f MB/s", 16 * 1048576 / ((ns - base) / 1e9) / 1e6
+        printf "\n"
+    }'
+done
@@ -0,0 +1,36 @@
+/*
+ * Call-overhead benchmark for AntiTampering.
+ *
+ * A tight loop calls a tiny non-inlined getter. With AntiTampering the getter
+ * carries an integrity check at its entry; the difference to the plain build
+ * is the per-call cost of the check in the selected mode.
+ *
+ * Usage: tamper_call_overhead [iterations]
+ * Prints "<ns per call> <checksum>".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int counter_value;
+
+__attribute__((noinline)) int get_counter(int delta) {
+    return counter_value + delta;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 100000000;
+    counter_value = argc;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long checksum = 0;
+    for (long i = 0; i < iterations; ++i) {
+        checksum += get_counter((int)(i & 7));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%.2f %ld\n", ns / iterations, checksum);
+    return 0;
+}
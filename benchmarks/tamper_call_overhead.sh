@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# Measures the per-call cost of AntiTampering on a tiny hot getter:
+#   plain   — no integrity checks
+#   entry   — full hash check on every call (HIDEIR_TAMPER_MODE=entry)
+#   sampled — check every 64th call per thread, jittered (HIDEIR_TAMPER_MODE=sampled)
+#   window  — check once per cycle-counter window per thread (HIDEIR_TAMPER_MODE=window)
+#   watchdog — no inline checks; a background thread re-verifies (HIDEIR_TAMPER_MODE=watchdog)
+#   page    — test the code page's verified flag, re-hash once per epoch (HIDEIR_TAMPER_MODE=page)
+#
+# Usage: benchmarks/tamper_call_overhead.sh [build dir] [iterations]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+ITERATIONS="${2:-100000000}"
+PLUGIN="$BUILD_DIR/plugins/libAntiTamperingPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+clang -O2 "$SCRIPT_DIR/tamper_call_overhead.c" -o "$WORK_DIR/plain"
+HIDEIR_TAMPER_MODE=entry clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_call_overhead.c" -o "$WORK_DIR/entry"
+HIDEIR_TAMPER_MODE=sampled HIDEIR_TAMPER_SAMPLE_RATE=64 HIDEIR_TAMPER_JITTER=1 clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_call_overhead.c" -o "$WORK_DIR/sampled"
+HIDEIR_TAMPER_MODE=window clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_call_overhead.c" -o "$WORK_DIR/window"
+HIDEIR_TAMPER_MODE=watchdog clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_call_overhead.c" -o "$WORK_DIR/watchdog" -pthread
+HIDEIR_TAMPER_MODE=page clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_call_overhead.c" -o "$WORK_DIR/page" -pthread
+echo ""
+
+echo "=== Results ($ITERATIONS calls) ==="
+for variant in plain entry sampled window watchdog page; do
+    read -r ns checksum < <("$WORK_DIR/$variant" "$ITERATIONS")
+    printf "  %-10s %8s ns/call\n" "$variant:" "$ns"
+done
@@ -0,0 +1,42 @@
+/*
+ * Hash-kernel benchmark for AntiTampering.
+ *
+ * scan() is a few kilobytes of machine code, almost all of it in a cold
+ * branch, so a call costs next to nothing beyond its integrity check. With
+ * post-link baselines patched by `hideir-tamper-patch --full-length`, the
+ * check hashes the whole function; the cycle-counter ticks per call above
+ * the plain build, divided by the function size, are the kernel's cost per
+ * byte.
+ *
+ * Usage: tamper_hash [iterations]
+ * Prints "<ticks per call> <checksum>".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+static volatile int sink;
+
+#define S(n) sink = sink * (n) + x;
+#define S8(n) S(n##1) S(n##3) S(n##5) S(n##7) S(n##9) S(n##11) S(n##13) S(n##15)
+#define S64(n) S8(n##1) S8(n##2) S8(n##3) S8(n##4) S8(n##5) S8(n##6) S8(n##7) S8(n##8)
+
+__attribute__((noinline)) int scan(int x) {
+    if (__builtin_expect(x < 0, 0)) {
+        S64(1) S64(2) S64(3) S64(4)
+    }
+    return x + 1;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+
+    long checksum = 0;
+    unsigned long long start = __builtin_readcyclecounter();
+    for (long i = 0; i < iterations; ++i) {
+        checksum += scan((int)(i & 7));
+    }
+    unsigned long long end = __builtin_readcyclecounter();
+
+    printf("%.1f %ld\n", (double)(end - start) / iterations, checksum);
+    return 0;
+}
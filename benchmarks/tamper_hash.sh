@@ -0,0 +1,61 @@
+#!/bin/bash
+#
+# Measures the cost per hashed byte of the AntiTampering hash kernels
+# (HIDEIR_TAMPER_HASH) on a function of a few kilobytes:
+#   fnv1a  — FNV-1a, one byte per iteration
+#   wide   — four 64-bit multiply-add lanes, 32 bytes per iteration
+#   crc32c — four SSE4.2 / ARMv8 CRC32C lanes, 32 bytes per iteration
+#
+# Every kernel is built twice with post-link baselines: "-64" variants check
+# the default 64-byte window, the others the whole function (patched with
+# --full-length). Ticks are cycle-counter ticks (TSC on x86, the generic
+# timer on AArch64) per call, minus the plain build.
+#
+# Usage: benchmarks/tamper_hash.sh [build dir] [iterations]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+ITERATIONS="${2:-1000000}"
+PLUGIN="$BUILD_DIR/plugins/libAntiTamperingPass.so"
+PATCHER="$BUILD_DIR/bin/hideir-tamper-patch"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ] || [ ! -x "$PATCHER" ]; then
+    echo "[-] $PLUGIN or $PATCHER not found. Run ./build.sh first."
+    exit 1
+fi
+
+# The CRC32C instructions need SSE4.2 on x86-64 and the CRC extension on AArch64
+case "$(uname -m)" in
+    x86_64) CFLAGS="-O2 -msse4.2" ;;
+    aarch64) CFLAGS="-O2 -march=armv8-a+crc" ;;
+    *) CFLAGS="-O2" ;;
+esac
+
+echo "=== Building benchmark variants ==="
+clang $CFLAGS "$SCRIPT_DIR/tamper_hash.c" -o "$WORK_DIR/plain"
+for kernel in fnv1a wide crc32c; do
+    HIDEIR_TAMPER_BASELINE=postlink HIDEIR_TAMPER_HASH=$kernel clang $CFLAGS -fpass-plugin="$PLUGIN" \
+        "$SCRIPT_DIR/tamper_hash.c" -o "$WORK_DIR/$kernel"
+    cp "$WORK_DIR/$kernel" "$WORK_DIR/$kernel-64"
+    "$PATCHER" "$WORK_DIR/$kernel-64"
+    "$PATCHER" --full-length "$WORK_DIR/$kernel"
+done
+echo ""
+
+read -r base checksum < <("$WORK_DIR/plain" "$ITERATIONS")
+
+echo "=== Results ($ITERATIONS calls) ==="
+printf "  %-10s %12s %8s %12s\n" "variant" "ticks/call" "bytes" "ticks/byte"
+for variant in fnv1a-64 wide-64 crc32c-64 fnv1a wide crc32c; do
+    read -r ticks checksum < <("$WORK_DIR/$variant" "$ITERATIONS")
+    case "$variant" in
+        *-64) bytes=64 ;;
+        *) bytes=$((16#$(nm -S "$WORK_DIR/$variant" | awk '$4 == "scan" { print $2 }'))) ;;
+    esac
+    awk -v v="$variant" -v t="$ticks" -v b="$base" -v n="$bytes" \
+        'BEGIN { printf "  %-10s %12.1f %8d %12.3f\n", v, t - b, n, (t - b) / n }'
+done
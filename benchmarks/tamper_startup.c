@@ -0,0 +1,30 @@
+/*
+ * Startup-latency benchmark for AntiTampering baselines.
+ *
+ * The binary defines 2,000 small protected functions but each run calls only
+ * the one selected on the command line. With startup baselines a constructor
+ * hashes every function (and faults in all of .text) before main; with
+ * post-link baselines the hashes are already in the file.
+ *
+ * Usage: tamper_startup [index]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define F(n) __attribute__((noinline)) int f##n(int x) { return x * n + (x >> (n % 7)); }
+#define D1(p) F(p##0) F(p##1) F(p##2) F(p##3) F(p##4) F(p##5) F(p##6) F(p##7) F(p##8) F(p##9)
+#define D2(p) D1(p##0) D1(p##1) D1(p##2) D1(p##3) D1(p##4) D1(p##5) D1(p##6) D1(p##7) D1(p##8) D1(p##9)
+#define D3(p) D2(p##0) D2(p##1) D2(p##2) D2(p##3) D2(p##4) D2(p##5) D2(p##6) D2(p##7) D2(p##8) D2(p##9)
+
+/* Function IDs run from 1000 to 2999. */
+D3(1) D3(2)
+
+#undef F
+#define F(n) f##n,
+static int (*const functions[])(int) = { D3(1) D3(2) };
+
+int main(int argc, char **argv) {
+    int index = argc > 1 ? atoi(argv[1]) % 2000 : 0;
+    printf("%d\n", functions[index](argc));
+    return 0;
+}
@@ -0,0 +1,46 @@
+#!/bin/bash
+#
+# Measures process startup latency with AntiTampering baselines:
+#   plain    — no integrity checks
+#   startup  — a constructor hashes every function before main (HIDEIR_TAMPER_BASELINE=startup)
+#   postlink — hideir-tamper-patch writes the hashes after linking (HIDEIR_TAMPER_BASELINE=postlink)
+#
+# Each variant protects 2,000 functions and runs RUNS times calling one of
+# them; the table shows the mean wall time per run.
+#
+# Usage: benchmarks/tamper_startup.sh [build dir] [runs]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+RUNS="${2:-200}"
+PLUGIN="$BUILD_DIR/plugins/libAntiTamperingPass.so"
+PATCHER="$BUILD_DIR/bin/hideir-tamper-patch"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ] || [ ! -x "$PATCHER" ]; then
+    echo "[-] $PLUGIN or $PATCHER not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+clang -O2 "$SCRIPT_DIR/tamper_startup.c" -o "$WORK_DIR/plain"
+HIDEIR_TAMPER_BASELINE=startup clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_startup.c" -o "$WORK_DIR/startup"
+HIDEIR_TAMPER_BASELINE=postlink clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/tamper_startup.c" -o "$WORK_DIR/postlink"
+"$PATCHER" "$WORK_DIR/postlink"
+echo ""
+
+echo "=== Results (mean of $RUNS runs) ==="
+for variant in plain startup postlink; do
+    start=$(date +%s%N)
+    for ((i = 0; i < RUNS; i++)); do
+        "$WORK_DIR/$variant" 4242 >/dev/null
+    done
+    end=$(date +%s%N)
+    awk -v v="$variant:" -v ns=$((end - start)) -v n="$RUNS" \
+        'BEGIN { printf "  %-10s %8.1f us/run\n", v, ns / 1000 / n }'
+done
@@ -0,0 +1,44 @@
+/*
+ * False-trap benchmark for the AntiDebugging timing checks.
+ *
+ * A loop calls a non-inlined function whose body is one long straight-line
+ * block, so most of the run is spent inside a timed block. Any preemption
+ * or stop that lands in that block counts against the timing threshold.
+ * The process runs for the given number of seconds and exits 0. A timing
+ * check that trips kills it with SIGILL or SIGTRAP instead.
+ *
+ * Usage: timing_stress [seconds]
+ * Prints "<calls> <checksum>".
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* The stores keep the work between the two counter reads of the check */
+static volatile uint64_t sink;
+
+#define STEP(i) x = (x ^ (x >> 29)) * 0xbf58476d1ce4e5b9ULL + (i); sink = x;
+#define STEP8(i) STEP(i) STEP(i + 1) STEP(i + 2) STEP(i + 3) STEP(i + 4) STEP(i + 5) STEP(i + 6) STEP(i + 7)
+
+__attribute__((noinline)) uint64_t mix(uint64_t x) {
+    STEP8(0) STEP8(8) STEP8(16) STEP8(24) STEP8(32) STEP8(40) STEP8(48) STEP8(56)
+    return x;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t checksum = (uint64_t)argc;
+    long calls = 0;
+    do {
+        for (int i = 0; i < 4096; ++i) checksum = mix(checksum);
+        calls += 4096;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 < seconds);
+
+    printf("%ld %llu\n", calls, (unsigned long long)checksum);
+    return 0;
+}
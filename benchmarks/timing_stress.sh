@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+# Counts false traps of the AntiDebugging timing checks on an overloaded
+# machine:
+#   fixed      — the fixed 0xFFFFFFF-tick threshold (HIDEIR_TIMING_LIMIT_MS=0)
+#   calibrated — 250 ms worth of ticks, measured at startup (the default)
+#   confirm    — calibrated, trapping only on a block's second slow run in a row (HIDEIR_TIMING_CONFIRM=1)
+#
+# Each variant runs LOAD processes per CPU for SECONDS seconds. With the CPUs
+# that overcommitted, a process that is preempted inside its timed block
+# waits for all the others before it runs again, often longer than the
+# fixed threshold (about 90 ms at 3 GHz). No debugger is attached, so every
+# process a timing check kills is a false positive.
+#
+# The processes are not stopped with SIGSTOP to emulate steal time: the
+# PTRACE_TRACEME startup check makes the script their tracer, so a stopped
+# process would stay stopped.
+#
+# Usage: benchmarks/timing_stress.sh [build dir] [seconds] [load]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_DIR="${1:-$SCRIPT_DIR/../build}"
+SECONDS_PER_RUN="${2:-20}"
+LOAD="${3:-32}"
+PLUGIN="$BUILD_DIR/plugins/libAntiDebuggingPass.so"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "[-] $PLUGIN not found. Run ./build.sh first."
+    exit 1
+fi
+
+echo "=== Building benchmark variants ==="
+HIDEIR_TIMING_PROB=1.0 HIDEIR_TIMING_LIMIT_MS=0 clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/timing_stress.c" -o "$WORK_DIR/fixed"
+HIDEIR_TIMING_PROB=1.0 clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/timing_stress.c" -o "$WORK_DIR/calibrated"
+HIDEIR_TIMING_PROB=1.0 HIDEIR_TIMING_CONFIRM=1 clang -O2 -fpass-plugin="$PLUGIN" \
+    "$SCRIPT_DIR/timing_stress.c" -o "$WORK_DIR/confirm"
+echo ""
+
+PROCESSES=$(( $(nproc) * LOAD ))
+
+echo "=== Results ($PROCESSES processes, ${SECONDS_PER_RUN}s each) ==="
+for variant in fixed calibrated confirm; do
+    pids=()
+    for ((i = 0; i < PROCESSES; i++)); do
+        "$WORK_DIR/$variant" "$SECONDS_PER_RUN" >/dev/null 2>&1 &
+        pids+=($!)
+    done
+
+    trapped=0
+    for pid in "${pids[@]}"; do
+        status=0
+        wait "$pid" || status=$?
+        if [ "$status" -eq 132 ] || [ "$status" -eq 133 ]; then
+            trapped=$((trapped + 1))
+        fi
+    done
+
+    printf "  %-12s %4d / %d processes trapped\n" "$variant:" "$trapped" "$PROCESSES"
+done
@@ -42,6 +42,29 @@ func main() {
 
 	logger.InfoLogger.Printf("Delegating execution to: %s %v", compilerPath, modifiedArgs[1:])
 
+	// Post-link steps (e.g. patching tamper baselines) need the linked
+	// output, so the compiler runs as a child process in that case.
+	postLink := interceptor.PostLink(originalArgs, configPath)
+	if len(postLink) > 0 {
+		cmd := exec.Command(compilerPath, modifiedArgs[1:]...)
+		cmd.Stdin, cmd.Stdout, cmd.Stderr = os.Stdin, os.Stdout, os.Stderr
+		if err := cmd.Run(); err != nil {
+			if exitErr, ok := err.(*exec.ExitError); ok {
+				os.Exit(exitErr.ExitCode())
+			}
+			logger.ErrorLogger.Fatalf("Failed to execute compiler process: %v", err)
+		}
+		for _, step := range postLink {
+			logger.InfoLogger.Printf("Running post-link step: %v", step)
+			stepCmd := exec.Command(step[0], step[1:]...)
+			stepCmd.Stdout, stepCmd.Stderr = os.Stdout, os.Stderr
+			if err := stepCmd.Run(); err != nil {
+				logger.ErrorLogger.Fatalf("Post-link step %v failed: %v", step, err)
+			}
+		}
+		return
+	}
+
 	// Replace the current Go orchestrator process with the actual compiler process
 	// This ensures exit codes, stdout, and stderr map seamlessly to the build system (Make/CMake)
 	env := os.Environ()
@@ -15,6 +15,7 @@ type Config struct {
 	Global struct {
 		Enabled      bool   `yaml:"enabled"`
 		PluginDir    string `yaml:"plugin_dir"`
+		ToolsDir     string `yaml:"tools_dir"`
 		StripSymbols bool   `yaml:"strip_symbols"`
 	} `yaml:"global"`
 	Passes struct {
@@ -23,41 +24,196 @@ type Config struct {
 			Threshold int  `yaml:"threshold"`
 		} `yaml:"split_basic_block"`
 		Flattening struct {
-			Enabled     bool    `yaml:"enabled"`
-			Probability float64 `yaml:"probability"`
+			Enabled       bool    `yaml:"enabled"`
+			Probability   float64 `yaml:"probability"`
+			Dispatch      string  `yaml:"dispatch"`
+			RegisterState bool    `yaml:"register_state"`
+			KeepHotLoops  bool    `yaml:"keep_hot_loops"`
+			HotLoopRatio  float64 `yaml:"hot_loop_ratio"`
+			Threaded      float64 `yaml:"threaded"`
+			Fanout        int     `yaml:"fanout"`
 		} `yaml:"flattening"`
 		OpaquePredicate struct {
 			Enabled     bool    `yaml:"enabled"`
 			Probability float64 `yaml:"probability"`
 		} `yaml:"opaque_predicate"`
 		StringEncryption struct {
-			Enabled bool `yaml:"enabled"`
+			Enabled         bool   `yaml:"enabled"`
+			Mode            string `yaml:"mode"`
+			MaxSize         int    `yaml:"max_size"`
+			LargePolicy     string `yaml:"large_policy"`
+			Cipher          string `yaml:"cipher"`
+			Prefold         string `yaml:"prefold"`
+			TransientBudget uint64 `yaml:"transient_budget"`
 		} `yaml:"string_encryption"`
 		FunctionOutlining struct {
 			Enabled bool `yaml:"enabled"`
 		} `yaml:"function_outlining"`
 		AntiDebugging struct {
-			Enabled bool `yaml:"enabled"`
+			Enabled           bool    `yaml:"enabled"`
+			TimingProbability float64 `yaml:"timing_probability"`
+			TimingBudget      float64 `yaml:"timing_budget"`
+			TimingLimitMs     *uint64 `yaml:"timing_limit_ms"`
+			TimingConfirm     bool    `yaml:"timing_confirm"`
 		} `yaml:"anti_debugging"`
 		APIHiding struct {
-			Enabled bool `yaml:"enabled"`
+			Enabled      bool    `yaml:"enabled"`
+			Resolver     string  `yaml:"resolver"`
+			HotCallRatio float64 `yaml:"hot_call_ratio"`
+			Libcalls     string  `yaml:"libcalls"`
+			Report       string  `yaml:"report"`
 		} `yaml:"api_hiding"`
 		AntiTampering struct {
-			Enabled bool `yaml:"enabled"`
+			Enabled        bool    `yaml:"enabled"`
+			Mode           string  `yaml:"mode"`
+			SampleRate     int     `yaml:"sample_rate"`
+			Window         uint64  `yaml:"window"`
+			Jitter         bool    `yaml:"jitter"`
+			WatchdogPeriod uint64  `yaml:"watchdog_period"`
+			WatchdogBudget uint64  `yaml:"watchdog_budget"`
+			Epoch          uint64  `yaml:"epoch"`
+			Baseline       string  `yaml:"baseline"`
+			FullLength     bool    `yaml:"full_length"`
+			Hash           string  `yaml:"hash"`
+			Select         string  `yaml:"select"`
+			MinSize        int     `yaml:"min_size"`
+			HotRatio       float64 `yaml:"hot_ratio"`
+			Vouch          bool    `yaml:"vouch"`
+			Report         string  `yaml:"report"`
 		} `yaml:"anti_tampering"`
 	} `yaml:"passes"`
 }
 
+func loadConfig(configPath string) (Config, error) {
+	var cfg Config
+	data, err := os.ReadFile(configPath)
+	if err == nil {
+		yaml.Unmarshal(data, &cfg)
+	}
+	return cfg, err
+}
+
+// invocation describes a compiler command line: which languages it compiles,
+// whether it links, where the linked output goes and which OS it targets.
+type invocation struct {
+	isCxx       bool
+	isCompiling bool
+	isLinking   bool
+	output      string
+	targetOS    string
+}
+
+// scanInvocation classifies a compiler command line. Linking happens when
+// there are input files and no compile-only flag; this prevents injecting
+// -s/-ldl on invocations like "gcc --version". The target OS comes from
+// --target/-target, or is the host's when the compiler is not cross-compiling.
+func scanInvocation(args []string) invocation {
+	inv := invocation{output: "a.out", targetOS: runtime.GOOS}
+	hasInputFiles := false
+	compileOnly := false
+	for i := 1; i < len(args); i++ {
+		arg := args[i]
+		base := filepath.Base(arg)
+		switch {
+		case arg == "-c":
+			inv.isCompiling = true
+			compileOnly = true
+		case arg == "-S" || arg == "-E":
+			compileOnly = true
+		case arg == "-o" && i+1 < len(args):
+			inv.output = args[i+1]
+			i++
+		case strings.HasPrefix(arg, "-o") && len(arg) > 2:
+			inv.output = arg[2:]
+		case arg == "-target" && i+1 < len(args):
+			inv.targetOS = tripleOS(args[i+1])
+			i++
+		case strings.HasPrefix(arg, "--target="):
+			inv.targetOS = tripleOS(strings.TrimPrefix(arg, "--target="))
+		case strings.HasPrefix(arg, "-"):
+			// Other flags name no input files
+		case strings.HasSuffix(arg, ".cpp") || strings.HasSuffix(arg, ".cc") || strings.HasSuffix(arg, ".cxx") ||
+			strings.HasSuffix(arg, ".C") || strings.HasSuffix(arg, ".c++"):
+			inv.isCxx = true
+			inv.isCompiling = true
+			hasInputFiles = true
+		case strings.HasSuffix(arg, ".c"):
+			inv.isCompiling = true
+			hasInputFiles = true
+		case strings.HasSuffix(arg, ".o") || strings.HasSuffix(arg, ".lo") || strings.HasSuffix(arg, ".a") ||
+			strings.HasSuffix(arg, ".so") || strings.Contains(base, ".so.") || strings.HasSuffix(arg, ".dylib"):
+			hasInputFiles = true
+		}
+	}
+	inv.isLinking = hasInputFiles && !compileOnly
+	return inv
+}
+
+// tripleOS maps a target triple to the GOOS name of its operating system
+// family, as far as linking is concerned.
+func tripleOS(triple string) string {
+	switch {
+	case strings.Contains(triple, "windows") || strings.Contains(triple, "mingw") ||
+		strings.Contains(triple, "cygwin") || strings.Contains(triple, "msvc"):
+		return "windows"
+	case strings.Contains(triple, "darwin") || strings.Contains(triple, "apple") ||
+		strings.Contains(triple, "macos") || strings.Contains(triple, "ios"):
+		return "darwin"
+	}
+	return "linux"
+}
+
+// postLinkBaselines reports whether outputs linked for targetOS carry
+// AntiTampering baselines for hideir-tamper-patch to fill in. The pass only
+// emits them for ELF targets.
+func postLinkBaselines(cfg *Config, targetOS string) bool {
+	return cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Baseline == "postlink" &&
+		targetOS != "windows" && targetOS != "darwin"
+}
+
+// PostLink returns the commands to run on the linked output after the
+// compiler has succeeded, or nil when there are none. With post-link tamper
+// baselines, hideir-tamper-patch fills them in; with full-length baselines,
+// stripping is deferred until the patcher has read the symbol sizes.
+func PostLink(originalArgs []string, configPath string) [][]string {
+	cfg, err := loadConfig(configPath)
+	if err != nil || !cfg.Global.Enabled {
+		return nil
+	}
+	inv := scanInvocation(originalArgs)
+	if !inv.isLinking || !postLinkBaselines(&cfg, inv.targetOS) {
+		return nil
+	}
+	output := inv.output
+
+	// If tools_dir is empty or not set, default to a "bin" directory next to
+	// the wrapper binary itself, where CMake builds the tools.
+	if cfg.Global.ToolsDir == "" {
+		execDir, _ := filepath.Abs(filepath.Dir(os.Args[0]))
+		cfg.Global.ToolsDir = filepath.Join(execDir, "bin")
+	}
+
+	patch := []string{filepath.Join(cfg.Global.ToolsDir, "hideir-tamper-patch")}
+	if cfg.Passes.AntiTampering.FullLength {
+		patch = append(patch, "--full-length")
+	}
+	if cfg.Passes.AntiTampering.Report != "" {
+		patch = append(patch, "--report="+cfg.Passes.AntiTampering.Report)
+	}
+	commands := [][]string{append(patch, output)}
+	if cfg.Global.StripSymbols && cfg.Passes.AntiTampering.FullLength {
+		commands = append(commands, []string{"strip", "--strip-all", output})
+	}
+	return commands
+}
+
 func Intercept(originalArgs []string, configPath string) []string {
 	if len(originalArgs) < 2 {
 		return originalArgs
 	}
 
-	var cfg Config
-	data, err := os.ReadFile(configPath)
-	if err == nil {
-		yaml.Unmarshal(data, &cfg)
-	} else {
+	cfg, err := loadConfig(configPath)
+	if err != nil {
 		logger.ErrorLogger.Printf("Failed to load config at %s, bypassing obfuscation", configPath)
 		return originalArgs
 	}
@@ -73,35 +229,8 @@ func Intercept(originalArgs []string, configPath string) []string {
 		cfg.Global.PluginDir = filepath.Join(execDir, "plugins")
 	}
 
-	isCxx := false
-	isCompiling := false
-	hasInputFiles := false
-	compileOnly := false
-
-	for _, arg := range originalArgs[1:] {
-		if strings.HasSuffix(arg, ".cpp") || strings.HasSuffix(arg, ".cc") {
-			isCxx = true
-			isCompiling = true
-			hasInputFiles = true
-		} else if strings.HasSuffix(arg, ".c") {
-			isCompiling = true
-			hasInputFiles = true
-		} else if strings.HasSuffix(arg, ".o") || strings.HasSuffix(arg, ".a") ||
-			strings.HasSuffix(arg, ".so") || strings.HasSuffix(arg, ".dylib") {
-			hasInputFiles = true
-		}
-		
-		if arg == "-c" {
-			isCompiling = true
-			compileOnly = true
-		} else if arg == "-S" || arg == "-E" {
-			compileOnly = true
-		}
-	}
-
-	// Linking only happens when we have input files and are not in compile-only mode.
-	// This prevents injecting -s/-ldl on invocations like "gcc --version".
-	isLinking := hasInputFiles && !compileOnly
+	inv := scanInvocation(originalArgs)
+	isCxx, isCompiling, isLinking := inv.isCxx, inv.isCompiling, inv.isLinking
 
 	var newArgs []string
 	compilerName := filepath.Base(originalArgs[0])
@@ -157,11 +286,120 @@ func Intercept(originalArgs []string, configPath string) []string {
 	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.Probability > 0 {
 		os.Setenv("HIDEIR_FLATTEN_PROB", fmt.Sprintf("%f", cfg.Passes.Flattening.Probability))
 	}
+	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.Dispatch != "" {
+		os.Setenv("HIDEIR_FLATTEN_DISPATCH", cfg.Passes.Flattening.Dispatch)
+	}
+	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.RegisterState {
+		os.Setenv("HIDEIR_FLATTEN_REGISTER_STATE", "1")
+	}
+	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.KeepHotLoops {
+		os.Setenv("HIDEIR_FLATTEN_KEEP_HOT_LOOPS", "1")
+	}
+	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.HotLoopRatio > 0 {
+		os.Setenv("HIDEIR_FLATTEN_HOT_LOOP_RATIO", fmt.Sprintf("%f", cfg.Passes.Flattening.HotLoopRatio))
+	}
+	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.Threaded > 0 {
+		os.Setenv("HIDEIR_FLATTEN_THREADED", fmt.Sprintf("%f", cfg.Passes.Flattening.Threaded))
+	}
+	if cfg.Passes.Flattening.Enabled && cfg.Passes.Flattening.Fanout > 0 {
+		os.Setenv("HIDEIR_FLATTEN_FANOUT", fmt.Sprintf("%d", cfg.Passes.Flattening.Fanout))
+	}
+	if cfg.Passes.StringEncryption.Enabled && cfg.Passes.StringEncryption.Mode != "" {
+		os.Setenv("HIDEIR_STRING_MODE", cfg.Passes.StringEncryption.Mode)
+	}
+	if cfg.Passes.StringEncryption.Enabled && cfg.Passes.StringEncryption.MaxSize > 0 {
+		os.Setenv("HIDEIR_STRING_MAX_SIZE", fmt.Sprintf("%d", cfg.Passes.StringEncryption.MaxSize))
+	}
+	if cfg.Passes.StringEncryption.Enabled && cfg.Passes.StringEncryption.LargePolicy != "" {
+		os.Setenv("HIDEIR_STRING_LARGE_POLICY", cfg.Passes.StringEncryption.LargePolicy)
+	}
+	if cfg.Passes.StringEncryption.Enabled && cfg.Passes.StringEncryption.Cipher != "" {
+		os.Setenv("HIDEIR_STRING_CIPHER", cfg.Passes.StringEncryption.Cipher)
+	}
+	if cfg.Passes.StringEncryption.Enabled && cfg.Passes.StringEncryption.Prefold != "" {
+		os.Setenv("HIDEIR_STRING_PREFOLD", cfg.Passes.StringEncryption.Prefold)
+	}
+	if cfg.Passes.StringEncryption.Enabled && cfg.Passes.StringEncryption.TransientBudget > 0 {
+		os.Setenv("HIDEIR_STRING_TRANSIENT_BUDGET", fmt.Sprintf("%d", cfg.Passes.StringEncryption.TransientBudget))
+	}
+	if cfg.Passes.AntiDebugging.Enabled && cfg.Passes.AntiDebugging.TimingProbability > 0 {
+		os.Setenv("HIDEIR_TIMING_PROB", fmt.Sprintf("%f", cfg.Passes.AntiDebugging.TimingProbability))
+	}
+	if cfg.Passes.AntiDebugging.Enabled && cfg.Passes.AntiDebugging.TimingBudget > 0 {
+		os.Setenv("HIDEIR_TIMING_BUDGET", fmt.Sprintf("%f", cfg.Passes.AntiDebugging.TimingBudget))
+	}
+	// timing_limit_ms: 0 is meaningful (keep the fixed threshold), so only an absent key is skipped
+	if cfg.Passes.AntiDebugging.Enabled && cfg.Passes.AntiDebugging.TimingLimitMs != nil {
+		os.Setenv("HIDEIR_TIMING_LIMIT_MS", fmt.Sprintf("%d", *cfg.Passes.AntiDebugging.TimingLimitMs))
+	}
+	if cfg.Passes.AntiDebugging.Enabled && cfg.Passes.AntiDebugging.TimingConfirm {
+		os.Setenv("HIDEIR_TIMING_CONFIRM", "1")
+	}
+	if cfg.Passes.APIHiding.Enabled && cfg.Passes.APIHiding.Resolver != "" {
+		os.Setenv("HIDEIR_API_RESOLVER", cfg.Passes.APIHiding.Resolver)
+	}
+	if cfg.Passes.APIHiding.Enabled && cfg.Passes.APIHiding.HotCallRatio > 0 {
+		os.Setenv("HIDEIR_API_HOT_CALL_RATIO", fmt.Sprintf("%f", cfg.Passes.APIHiding.HotCallRatio))
+	}
+	if cfg.Passes.APIHiding.Enabled && cfg.Passes.APIHiding.Libcalls != "" {
+		os.Setenv("HIDEIR_API_LIBCALLS", cfg.Passes.APIHiding.Libcalls)
+	}
+	if cfg.Passes.APIHiding.Enabled && cfg.Passes.APIHiding.Report != "" {
+		os.Setenv("HIDEIR_API_REPORT", cfg.Passes.APIHiding.Report)
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Mode != "" {
+		os.Setenv("HIDEIR_TAMPER_MODE", cfg.Passes.AntiTampering.Mode)
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.SampleRate > 0 {
+		os.Setenv("HIDEIR_TAMPER_SAMPLE_RATE", fmt.Sprintf("%d", cfg.Passes.AntiTampering.SampleRate))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Window > 0 {
+		os.Setenv("HIDEIR_TAMPER_WINDOW", fmt.Sprintf("%d", cfg.Passes.AntiTampering.Window))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Jitter {
+		os.Setenv("HIDEIR_TAMPER_JITTER", "1")
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.WatchdogPeriod > 0 {
+		os.Setenv("HIDEIR_TAMPER_WATCHDOG_PERIOD", fmt.Sprintf("%d", cfg.Passes.AntiTampering.WatchdogPeriod))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.WatchdogBudget > 0 {
+		os.Setenv("HIDEIR_TAMPER_WATCHDOG_BUDGET", fmt.Sprintf("%d", cfg.Passes.AntiTampering.WatchdogBudget))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Epoch > 0 {
+		os.Setenv("HIDEIR_TAMPER_EPOCH", fmt.Sprintf("%d", cfg.Passes.AntiTampering.Epoch))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Baseline != "" {
+		os.Setenv("HIDEIR_TAMPER_BASELINE", cfg.Passes.AntiTampering.Baseline)
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.FullLength {
+		os.Setenv("HIDEIR_TAMPER_FULL_LENGTH", "1")
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Hash != "" {
+		os.Setenv("HIDEIR_TAMPER_HASH", cfg.Passes.AntiTampering.Hash)
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Select != "" {
+		os.Setenv("HIDEIR_TAMPER_SELECT", cfg.Passes.AntiTampering.Select)
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.MinSize > 0 {
+		os.Setenv("HIDEIR_TAMPER_MIN_SIZE", fmt.Sprintf("%d", cfg.Passes.AntiTampering.MinSize))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.HotRatio > 0 {
+		os.Setenv("HIDEIR_TAMPER_HOT_RATIO", fmt.Sprintf("%f", cfg.Passes.AntiTampering.HotRatio))
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Vouch {
+		os.Setenv("HIDEIR_TAMPER_VOUCH", "1")
+	}
+	if cfg.Passes.AntiTampering.Enabled && cfg.Passes.AntiTampering.Report != "" {
+		os.Setenv("HIDEIR_TAMPER_REPORT", cfg.Passes.AntiTampering.Report)
+	}
 	if cfg.Passes.OpaquePredicate.Enabled && cfg.Passes.OpaquePredicate.Probability > 0 {
 		os.Setenv("HIDEIR_OPAQUE_PROB", fmt.Sprintf("%f", cfg.Passes.OpaquePredicate.Probability))
 	}
 
-	if cfg.Global.StripSymbols && isLinking {
+	// Full-length tamper baselines need the symbol table after linking;
+	// PostLink strips the output once the patcher has run.
+	deferStrip := postLinkBaselines(&cfg, inv.targetOS) && cfg.Passes.AntiTampering.FullLength
+	if cfg.Global.StripSymbols && isLinking && !deferStrip {
 		stripArg := "-s"
 		alreadyStripped := false
 		for _, arg := range newArgs {
@@ -177,9 +415,15 @@ func Intercept(originalArgs []string, configPath string) []string {
 	}
 
 	// We must pass -ldl to the linker on Unix so dlsym resolves correctly for API Hiding
-	if isLinking && runtime.GOOS != "windows" && cfg.Passes.APIHiding.Enabled {
+	if isLinking && inv.targetOS != "windows" && cfg.Passes.APIHiding.Enabled {
 		newArgs = append(newArgs, "-ldl")
 	}
 
+	// The anti-tampering watchdog and page epoch run on their own thread
+	if isLinking && inv.targetOS != "windows" && cfg.Passes.AntiTampering.Enabled &&
+		(cfg.Passes.AntiTampering.Mode == "watchdog" || cfg.Passes.AntiTampering.Mode == "page") {
+		newArgs = append(newArgs, "-pthread")
+	}
+
 	return newArgs
 }
@@ -1,6 +1,7 @@
 package interceptor
 
 import (
+	"fmt"
 	"os"
 	"path/filepath"
 	"testing"
@@ -87,3 +88,117 @@ global:
 		})
 	}
 }
+
+func TestPostLinkDetection(t *testing.T) {
+	tempDir := t.TempDir()
+	configPath := filepath.Join(tempDir, "config_postlink.yaml")
+	os.WriteFile(configPath, []byte(`
+global:
+  enabled: true
+  tools_dir: "/tmp/tools"
+passes:
+  anti_tampering:
+    enabled: true
+    baseline: postlink
+`), 0644)
+
+	tests := []struct {
+		name       string
+		args       []string
+		wantOutput string // empty when no post-link step should run
+	}{
+		{
+			name:       "C++ source with .cxx suffix",
+			args:       []string{"g++", "main.cxx", "-o", "app"},
+			wantOutput: "app",
+		},
+		{
+			name:       "C++ source with .C suffix",
+			args:       []string{"g++", "main.C", "-oapp"},
+			wantOutput: "app",
+		},
+		{
+			name:       "Libtool objects and versioned shared library",
+			args:       []string{"gcc", "main.lo", "libdep.so.1", "-o", "app"},
+			wantOutput: "app",
+		},
+		{
+			name:       "Dylib input defaults to a.out",
+			args:       []string{"gcc", "main.o", "libdep.dylib"},
+			wantOutput: "a.out",
+		},
+		{
+			name:       "Compile-only",
+			args:       []string{"gcc", "-c", "main.c", "-o", "main.o"},
+			wantOutput: "",
+		},
+		{
+			name:       "Cross-compiling for Windows",
+			args:       []string{"clang", "--target=x86_64-pc-windows-msvc", "main.c", "-o", "app.exe"},
+			wantOutput: "",
+		},
+		{
+			name:       "Cross-compiling for macOS",
+			args:       []string{"clang", "-target", "arm64-apple-macos13", "main.c", "-o", "app"},
+			wantOutput: "",
+		},
+		{
+			name:       "Cross-compiling for Linux",
+			args:       []string{"clang", "--target=aarch64-linux-gnu", "main.c", "-o", "app"},
+			wantOutput: "app",
+		},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			steps := PostLink(tt.args, configPath)
+			if tt.wantOutput == "" {
+				if len(steps) != 0 {
+					t.Errorf("PostLink() expected no steps, got %v", steps)
+				}
+				return
+			}
+			if len(steps) != 1 || steps[0][len(steps[0])-1] != tt.wantOutput {
+				t.Errorf("PostLink() expected one step patching %q, got %v", tt.wantOutput, steps)
+			}
+		})
+	}
+}
+
+func TestTimingLimitExport(t *testing.T) {
+	tempDir := t.TempDir()
+
+	tests := []struct {
+		name      string
+		limit     string
+		wantSet   bool
+		wantValue string
+	}{
+		{name: "Explicit zero keeps the fixed threshold", limit: "\n    timing_limit_ms: 0", wantSet: true, wantValue: "0"},
+		{name: "Explicit limit", limit: "\n    timing_limit_ms: 100", wantSet: true, wantValue: "100"},
+		{name: "Absent limit leaves the pass default", limit: "", wantSet: false},
+	}
+
+	for i, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			configPath := filepath.Join(tempDir, fmt.Sprintf("config_%d.yaml", i))
+			os.WriteFile(configPath, []byte(`
+global:
+  enabled: true
+  plugin_dir: "/tmp/plugins"
+passes:
+  anti_debugging:
+    enabled: true`+tt.limit+`
+`), 0644)
+
+			t.Setenv("HIDEIR_TIMING_LIMIT_MS", "")
+			os.Unsetenv("HIDEIR_TIMING_LIMIT_MS")
+			Intercept([]string{"gcc", "-c", "main.c", "-o", "main.o"}, configPath)
+
+			got, set := os.LookupEnv("HIDEIR_TIMING_LIMIT_MS")
+			if set != tt.wantSet || got != tt.wantValue {
+				t.Errorf("HIDEIR_TIMING_LIMIT_MS = %q (set %v), want %q (set %v)", got, set, tt.wantValue, tt.wantSet)
+			}
+		})
+	}
+}
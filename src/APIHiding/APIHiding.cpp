@@ -1,23 +1,517 @@
 #include "APIHiding.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 #include "llvm/TargetParser/Triple.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <cstdlib>
+#include <map>
+#include <tuple>
 #include <vector>
 
 using namespace llvm;
 
+// Build the shared slow path of every import slot:
+//   ptr obf.api_resolve(ptr slot, ptr name)
+// It looks the symbol up with the platform resolver and caches the address in
+// the slot. Racing threads may both resolve a symbol; they store the same
+// address, so the slot never holds anything but null or the final target.
+static Function *createImportResolver(Module &M, const Triple &targetTriple, FunctionCallee resolveFunc) {
+    LLVMContext &ctx = M.getContext();
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    FunctionType *fnTy = FunctionType::get(ptrTy, {ptrTy, ptrTy}, false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.api_resolve", &M);
+    fn->addFnAttr(Attribute::NoInline);
+    fn->addFnAttr(Attribute::Cold);
+
+    Value *slot = fn->getArg(0);
+    Value *name = fn->getArg(1);
+    IRBuilder<> builder(BasicBlock::Create(ctx, "entry", fn));
+
+    Value *resolvedPtr = nullptr;
+    if (targetTriple.isOSWindows()) {
+        // GetProcAddress(GetModuleHandleA(NULL), "funcName")
+        FunctionType *getModTy = FunctionType::get(ptrTy, {ptrTy}, false);
+        FunctionCallee getMod = M.getOrInsertFunction("GetModuleHandleA", getModTy);
+        Value *hModule = builder.CreateCall(getMod, {ConstantPointerNull::get(cast<PointerType>(ptrTy))});
+        resolvedPtr = builder.CreateCall(resolveFunc, {hModule, name});
+    } else {
+        // dlsym(RTLD_DEFAULT, "funcName")
+        // RTLD_DEFAULT is usually 0 on Linux/Solaris, and -2 on macOS
+        intptr_t rtld_default_val = targetTriple.isMacOSX() ? -2 : 0;
+        Value *handle = builder.CreateIntToPtr(builder.getInt64(rtld_default_val), ptrTy);
+        resolvedPtr = builder.CreateCall(resolveFunc, {handle, name});
+    }
+
+    builder.CreateAlignedStore(resolvedPtr, slot, M.getDataLayout().getPointerABIAlignment(0))
+        ->setAtomic(AtomicOrdering::Release);
+    builder.CreateRet(resolvedPtr);
+    return fn;
+}
+
+enum class ApiResolver { Dlsym, GnuHash };
+
+// Read HIDEIR_API_RESOLVER. "dlsym" (default) resolves each import by name
+// through dlsym/GetProcAddress; "gnuhash" resolves the whole import set in
+// one pass over the loaded ELF objects' DT_GNU_HASH tables, keyed by
+// precomputed hashes, so no symbol names are left in the binary. Only 64-bit
+// Linux targets support "gnuhash"; others keep dlsym.
+static ApiResolver getApiResolver() {
+    if (const char *env = std::getenv("HIDEIR_API_RESOLVER")) {
+        if (StringRef(env) == "gnuhash") return ApiResolver::GnuHash;
+    }
+    return ApiResolver::Dlsym;
+}
+
+// Read HIDEIR_API_HOT_CALL_RATIO: call sites whose block runs at least this
+// many times per function invocation (estimated by BlockFrequencyInfo, or the
+// hot-block test of the PGO profile when one is present) are left as direct
+// calls, so the optimizer can still inline and infer attributes through them.
+// A symbol with any direct call stays visible in the import table. Defaults
+// to 0, which hides every call.
+static double getHotCallRatio() {
+    if (const char *env = std::getenv("HIDEIR_API_HOT_CALL_RATIO")) {
+        double val = std::atof(env);
+        if (val > 0.0) return val;
+    }
+    return 0.0;
+}
+
+enum class LibcallPolicy { Keep, Hide, Late };
+
+// Read HIDEIR_API_LIBCALLS: how calls that TargetLibraryInfo recognizes as
+// lowerable builtins (memcpy/memset, sqrt/fabs and friends, string functions
+// on constant strings) are treated. "keep" (default) leaves them direct so the
+// optimizer can still turn them into intrinsics, instructions or constants;
+// "hide" hides them like any other import; "late" runs the whole pass at the
+// end of the optimization pipeline instead of its start, hiding whatever calls
+// are left once instcombine has lowered the rest.
+static LibcallPolicy getLibcallPolicy() {
+    if (const char *env = std::getenv("HIDEIR_API_LIBCALLS")) {
+        if (StringRef(env) == "hide") return LibcallPolicy::Hide;
+        if (StringRef(env) == "late") return LibcallPolicy::Late;
+    }
+    return LibcallPolicy::Keep;
+}
+
+// Return why a call to a recognized library function should stay direct, or
+// nullptr if hiding it costs no optimization. Calls in functions built with
+// -fno-builtin are never recognized.
+static const char *getBuiltinExemption(CallInst *CI, const TargetLibraryInfo &TLI) {
+    LibFunc func;
+    if (!TLI.getLibFunc(*CI, func)) return nullptr;
+
+    switch (func) {
+    case LibFunc_memcpy:
+    case LibFunc_memmove:
+    case LibFunc_memset:
+    case LibFunc_mempcpy:
+        return "memory builtin";
+    case LibFunc_memcmp:
+    case LibFunc_bcmp:
+    case LibFunc_memchr:
+        // Expanded inline when the length is a constant.
+        if (isa<ConstantInt>(CI->getArgOperand(2))) return "memory builtin";
+        break;
+    case LibFunc_sqrt: case LibFunc_sqrtf: case LibFunc_sqrtl:
+    case LibFunc_fabs: case LibFunc_fabsf: case LibFunc_fabsl:
+    case LibFunc_floor: case LibFunc_floorf: case LibFunc_floorl:
+    case LibFunc_ceil: case LibFunc_ceilf: case LibFunc_ceill:
+    case LibFunc_trunc: case LibFunc_truncf: case LibFunc_truncl:
+    case LibFunc_round: case LibFunc_roundf: case LibFunc_roundl:
+    case LibFunc_roundeven: case LibFunc_roundevenf: case LibFunc_roundevenl:
+    case LibFunc_rint: case LibFunc_rintf: case LibFunc_rintl:
+    case LibFunc_nearbyint: case LibFunc_nearbyintf: case LibFunc_nearbyintl:
+    case LibFunc_fmin: case LibFunc_fminf: case LibFunc_fminl:
+    case LibFunc_fmax: case LibFunc_fmaxf: case LibFunc_fmaxl:
+    case LibFunc_copysign: case LibFunc_copysignf: case LibFunc_copysignl:
+        return "math builtin";
+    case LibFunc_strlen:
+    case LibFunc_strnlen:
+    case LibFunc_strcmp:
+    case LibFunc_strncmp:
+    case LibFunc_strchr:
+    case LibFunc_strrchr:
+    case LibFunc_strstr:
+    case LibFunc_strpbrk:
+    case LibFunc_strspn:
+    case LibFunc_strcspn:
+    case LibFunc_strcpy:
+    case LibFunc_stpcpy:
+    case LibFunc_strncpy:
+        // Folded or simplified when an argument is a constant string.
+        for (Value *arg : CI->args()) {
+            StringRef str;
+            if (arg->getType()->isPointerTy() && getConstantStringInfo(arg, str)) return "constant string argument";
+        }
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+// Append the per-symbol outcome of the pass to HIDEIR_API_REPORT, if set: one
+// "<status>\t<symbol>\t<call sites>\t<reason>" line per symbol and outcome,
+// under a "# <module>" header. Each module appends, so one file can collect a
+// whole build.
+using ApiReport = std::map<std::tuple<std::string, std::string, std::string>, unsigned>;
+
+static void writeApiReport(const Module &M, const ApiReport &report) {
+    const char *path = std::getenv("HIDEIR_API_REPORT");
+    if (!path || !*path || report.empty()) return;
+
+    std::error_code EC;
+    raw_fd_ostream out(path, EC, sys::fs::OF_Append | sys::fs::OF_Text);
+    if (EC) return;
+    out << "# " << M.getModuleIdentifier() << "\n";
+    for (const auto &entry : report) {
+        const auto &[status, symbol, reason] = entry.first;
+        out << status << "\t" << symbol << "\t" << entry.second << "\t" << reason << "\n";
+    }
+}
+
+// Symbol hash used by DT_GNU_HASH tables (h * 33 + c, seeded with 5381).
+static uint32_t gnuHash(StringRef name) {
+    uint32_t h = 5381;
+    for (unsigned char c : name) h = h * 33 + c;
+    return h;
+}
+
+// FNV-1a of a symbol name. It is stored next to the GNU hash so the runtime
+// lookup can reject a 32-bit hash collision without keeping the name around.
+static uint32_t nameCheckHash(StringRef name) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Build the batched ELF resolver used by HIDEIR_API_RESOLVER=gnuhash:
+//   i32 obf.api_scan_object(ptr info, i64 size, ptr data)
+//   ptr obf.api_resolve_all(ptr slot)
+// obf.api_resolve_all runs dl_iterate_phdr once and returns the value of the
+// requested slot. For each loaded object, the callback finds PT_DYNAMIC and
+// reads DT_GNU_HASH, DT_SYMTAB, DT_STRTAB and DT_VERSYM. It then looks up
+// every still-empty slot by its precomputed hash: bloom filter, bucket, then
+// the hash chain. A match must be a defined function or IFUNC (whose resolver
+// is called) in a default symbol version, and its name must match the stored
+// FNV-1a check. Objects are visited in load order and the first definition
+// wins, which is the order dlsym(RTLD_DEFAULT) searches. The walk stops once
+// every slot is filled. Offsets follow the ELF64 structure layouts.
+static Function *createGnuHashResolver(Module &M, GlobalVariable *hashes, GlobalVariable *checks,
+                                       GlobalVariable *slots, uint64_t count) {
+    LLVMContext &ctx = M.getContext();
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    Type *i8Ty = Type::getInt8Ty(ctx);
+    Type *i16Ty = Type::getInt16Ty(ctx);
+    Type *i32Ty = Type::getInt32Ty(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    Align slotAlign = M.getDataLayout().getPointerABIAlignment(0);
+
+    FunctionType *scanTy = FunctionType::get(i32Ty, {ptrTy, i64Ty, ptrTy}, false);
+    Function *scan = Function::Create(scanTy, GlobalValue::InternalLinkage, "obf.api_scan_object", &M);
+    scan->addFnAttr(Attribute::NoInline);
+    scan->addFnAttr(Attribute::Cold);
+
+    auto block = [&](const char *name) { return BasicBlock::Create(ctx, name, scan); };
+    BasicBlock *entry = block("entry");
+    BasicBlock *phdrHead = block("phdr_head");
+    BasicBlock *phdrBody = block("phdr_body");
+    BasicBlock *phdrNext = block("phdr_next");
+    BasicBlock *dynFound = block("dyn_found");
+    BasicBlock *dynHead = block("dyn_head");
+    BasicBlock *dynBody = block("dyn_body");
+    BasicBlock *dynDone = block("dyn_done");
+    BasicBlock *tablesReady = block("tables_ready");
+    BasicBlock *impHead = block("import_head");
+    BasicBlock *impBody = block("import_body");
+    BasicBlock *impLookup = block("import_lookup");
+    BasicBlock *bucket = block("bucket");
+    BasicBlock *chainHead = block("chain_head");
+    BasicBlock *candidate = block("candidate");
+    BasicBlock *verCheck = block("version_check");
+    BasicBlock *verLoad = block("version_load");
+    BasicBlock *nameCheck = block("name_check");
+    BasicBlock *nameHead = block("name_head");
+    BasicBlock *nameBody = block("name_body");
+    BasicBlock *nameDone = block("name_done");
+    BasicBlock *found = block("found");
+    BasicBlock *ifunc = block("ifunc");
+    BasicBlock *publish = block("publish");
+    BasicBlock *chainStep = block("chain_step");
+    BasicBlock *chainNext = block("chain_next");
+    BasicBlock *impMiss = block("import_miss");
+    BasicBlock *impNext = block("import_next");
+    BasicBlock *finish = block("finish");
+    BasicBlock *skip = block("skip");
+
+    IRBuilder<> builder(entry);
+    // ELF structures are addressed as integers; load a T from such an address.
+    auto loadAt = [&](Type *T, Value *addr) { return builder.CreateLoad(T, builder.CreateIntToPtr(addr, ptrTy)); };
+
+    // struct dl_phdr_info { Elf64_Addr dlpi_addr; const char *dlpi_name;
+    //                       const Elf64_Phdr *dlpi_phdr; Elf64_Half dlpi_phnum; }
+    Value *info = scan->getArg(0);
+    Value *base = builder.CreateLoad(i64Ty, info, "base");
+    Value *phdr = builder.CreatePtrToInt(
+        builder.CreateLoad(ptrTy, builder.CreateConstGEP1_64(i8Ty, info, 16)), i64Ty, "phdr");
+    Value *phnum = builder.CreateZExt(
+        builder.CreateLoad(i16Ty, builder.CreateConstGEP1_64(i8Ty, info, 24)), i64Ty, "phnum");
+    builder.CreateBr(phdrHead);
+
+    // Find PT_DYNAMIC among the 56-byte program headers.
+    builder.SetInsertPoint(phdrHead);
+    PHINode *phIdx = builder.CreatePHI(i64Ty, 2, "phdr_idx");
+    phIdx->addIncoming(builder.getInt64(0), entry);
+    Value *ph = builder.CreateAdd(phdr, builder.CreateMul(phIdx, builder.getInt64(56)));
+    builder.CreateCondBr(builder.CreateICmpULT(phIdx, phnum), phdrBody, skip);
+
+    builder.SetInsertPoint(phdrBody);
+    Value *isDynamic = builder.CreateICmpEQ(loadAt(i32Ty, ph), builder.getInt32(2 /* PT_DYNAMIC */));
+    builder.CreateCondBr(isDynamic, dynFound, phdrNext);
+
+    builder.SetInsertPoint(phdrNext);
+    phIdx->addIncoming(builder.CreateAdd(phIdx, builder.getInt64(1)), phdrNext);
+    builder.CreateBr(phdrHead);
+
+    builder.SetInsertPoint(dynFound);
+    Value *dynStart = builder.CreateAdd(base, loadAt(i64Ty, builder.CreateAdd(ph, builder.getInt64(16))));
+    builder.CreateBr(dynHead);
+
+    // Walk the Elf64_Dyn entries up to DT_NULL, keeping the tables we need.
+    const uint64_t dynTags[] = {0x6ffffef5 /* DT_GNU_HASH */, 6 /* DT_SYMTAB */, 5 /* DT_STRTAB */,
+                                0x6ffffff0 /* DT_VERSYM */};
+    builder.SetInsertPoint(dynHead);
+    PHINode *dyn = builder.CreatePHI(i64Ty, 2, "dyn");
+    dyn->addIncoming(dynStart, dynFound);
+    PHINode *tables[4];
+    for (PHINode *&table : tables) {
+        table = builder.CreatePHI(i64Ty, 2);
+        table->addIncoming(builder.getInt64(0), dynFound);
+    }
+    Value *tag = loadAt(i64Ty, dyn);
+    builder.CreateCondBr(builder.CreateICmpEQ(tag, builder.getInt64(0)), dynDone, dynBody);
+
+    builder.SetInsertPoint(dynBody);
+    Value *dynVal = loadAt(i64Ty, builder.CreateAdd(dyn, builder.getInt64(8)));
+    for (unsigned k = 0; k < 4; ++k) {
+        Value *isTag = builder.CreateICmpEQ(tag, builder.getInt64(dynTags[k]));
+        tables[k]->addIncoming(builder.CreateSelect(isTag, dynVal, tables[k]), dynBody);
+    }
+    dyn->addIncoming(builder.CreateAdd(dyn, builder.getInt64(16)), dynBody);
+    builder.CreateBr(dynHead);
+
+    builder.SetInsertPoint(dynDone);
+    Value *missing = builder.CreateOr(builder.CreateICmpEQ(tables[0], builder.getInt64(0)),
+        builder.CreateOr(builder.CreateICmpEQ(tables[1], builder.getInt64(0)),
+                         builder.CreateICmpEQ(tables[2], builder.getInt64(0))));
+    builder.CreateCondBr(missing, skip, tablesReady);
+
+    // glibc relocates d_ptr entries in place; the vDSO and some other loaders
+    // leave them relative to the load base.
+    builder.SetInsertPoint(tablesReady);
+    auto relocate = [&](Value *v, const char *name) {
+        Value *relative = builder.CreateAnd(builder.CreateICmpNE(v, builder.getInt64(0)),
+                                            builder.CreateICmpULT(v, base));
+        return builder.CreateSelect(relative, builder.CreateAdd(v, base), v, name);
+    };
+    Value *gnuHashTab = relocate(tables[0], "gnu_hash");
+    Value *symtab = relocate(tables[1], "symtab");
+    Value *strtab = relocate(tables[2], "strtab");
+    Value *versym = relocate(tables[3], "versym");
+    auto loadWord = [&](uint64_t offset) {
+        return builder.CreateZExt(loadAt(i32Ty, builder.CreateAdd(gnuHashTab, builder.getInt64(offset))), i64Ty);
+    };
+    Value *nbuckets = loadWord(0);
+    Value *symoffset = loadWord(4);
+    Value *bloomSize = loadWord(8);
+    Value *bloomShift = loadWord(12);
+    Value *bloom = builder.CreateAdd(gnuHashTab, builder.getInt64(16));
+    Value *buckets = builder.CreateAdd(bloom, builder.CreateMul(bloomSize, builder.getInt64(8)));
+    Value *chain = builder.CreateAdd(buckets, builder.CreateMul(nbuckets, builder.getInt64(4)));
+    Value *emptyTable = builder.CreateOr(builder.CreateICmpEQ(nbuckets, builder.getInt64(0)),
+                                         builder.CreateICmpEQ(bloomSize, builder.getInt64(0)));
+    builder.CreateCondBr(emptyTable, skip, impHead);
+
+    builder.SetInsertPoint(impHead);
+    PHINode *idx = builder.CreatePHI(i64Ty, 2, "import_idx");
+    idx->addIncoming(builder.getInt64(0), tablesReady);
+    PHINode *pending = builder.CreatePHI(i32Ty, 2, "pending");
+    pending->addIncoming(builder.getInt32(0), tablesReady);
+    builder.CreateCondBr(builder.CreateICmpULT(idx, builder.getInt64(count)), impBody, finish);
+
+    builder.SetInsertPoint(impBody);
+    Value *slot = builder.CreateInBoundsGEP(slots->getValueType(), slots, {builder.getInt64(0), idx});
+    LoadInst *current = builder.CreateAlignedLoad(ptrTy, slot, slotAlign);
+    current->setAtomic(AtomicOrdering::Monotonic);
+    builder.CreateCondBr(builder.CreateIsNull(current), impLookup, impNext);
+
+    // Bloom filter: both bits selected by the hash must be set (64-bit words).
+    builder.SetInsertPoint(impLookup);
+    Value *hash = builder.CreateZExt(builder.CreateLoad(i32Ty,
+        builder.CreateInBoundsGEP(hashes->getValueType(), hashes, {builder.getInt64(0), idx})), i64Ty, "hash");
+    Value *wordIdx = builder.CreateURem(builder.CreateLShr(hash, builder.getInt64(6)), bloomSize);
+    Value *word = loadAt(i64Ty, builder.CreateAdd(bloom, builder.CreateMul(wordIdx, builder.getInt64(8))));
+    Value *mask = builder.CreateOr(
+        builder.CreateShl(builder.getInt64(1), builder.CreateAnd(hash, builder.getInt64(63))),
+        builder.CreateShl(builder.getInt64(1),
+                          builder.CreateAnd(builder.CreateLShr(hash, bloomShift), builder.getInt64(63))));
+    builder.CreateCondBr(builder.CreateICmpEQ(builder.CreateAnd(word, mask), mask), bucket, impMiss);
+
+    builder.SetInsertPoint(bucket);
+    Value *bucketIdx = builder.CreateURem(hash, nbuckets);
+    Value *first = builder.CreateZExt(
+        loadAt(i32Ty, builder.CreateAdd(buckets, builder.CreateMul(bucketIdx, builder.getInt64(4)))), i64Ty);
+    builder.CreateCondBr(builder.CreateICmpULT(first, symoffset), impMiss, chainHead);
+
+    // Chain entries carry the symbol hash with the low bit marking the end.
+    builder.SetInsertPoint(chainHead);
+    PHINode *symIdx = builder.CreatePHI(i64Ty, 2, "sym_idx");
+    symIdx->addIncoming(first, bucket);
+    Value *chainAddr = builder.CreateAdd(chain,
+        builder.CreateMul(builder.CreateSub(symIdx, symoffset), builder.getInt64(4)));
+    Value *chainHash = builder.CreateZExt(loadAt(i32Ty, chainAddr), i64Ty);
+    Value *sameHash = builder.CreateICmpEQ(builder.CreateOr(chainHash, builder.getInt64(1)),
+                                           builder.CreateOr(hash, builder.getInt64(1)));
+    builder.CreateCondBr(sameHash, candidate, chainStep);
+
+    // Elf64_Sym { u32 st_name; u8 st_info; u8 st_other; u16 st_shndx; u64 st_value; u64 st_size; }
+    builder.SetInsertPoint(candidate);
+    Value *sym = builder.CreateAdd(symtab, builder.CreateMul(symIdx, builder.getInt64(24)), "sym");
+    Value *symType = builder.CreateAnd(loadAt(i8Ty, builder.CreateAdd(sym, builder.getInt64(4))), 15);
+    Value *shndx = loadAt(i16Ty, builder.CreateAdd(sym, builder.getInt64(6)));
+    Value *value = loadAt(i64Ty, builder.CreateAdd(sym, builder.getInt64(8)));
+    Value *isIfunc = builder.CreateICmpEQ(symType, builder.getInt8(10 /* STT_GNU_IFUNC */));
+    Value *isFunc = builder.CreateOr(builder.CreateICmpEQ(symType, builder.getInt8(2 /* STT_FUNC */)), isIfunc);
+    Value *defined = builder.CreateAnd(builder.CreateICmpNE(shndx, builder.getInt16(0)),
+                                       builder.CreateICmpNE(value, builder.getInt64(0)));
+    builder.CreateCondBr(builder.CreateAnd(isFunc, defined), verCheck, chainStep);
+
+    // Skip hidden (non-default) versions such as memcpy@GLIBC_2.2.5.
+    builder.SetInsertPoint(verCheck);
+    builder.CreateCondBr(builder.CreateICmpEQ(versym, builder.getInt64(0)), nameCheck, verLoad);
+
+    builder.SetInsertPoint(verLoad);
+    Value *version = loadAt(i16Ty, builder.CreateAdd(versym, builder.CreateMul(symIdx, builder.getInt64(2))));
+    Value *hidden = builder.CreateICmpNE(builder.CreateAnd(version, builder.getInt16(0x8000)), builder.getInt16(0));
+    builder.CreateCondBr(hidden, chainStep, nameCheck);
+
+    builder.SetInsertPoint(nameCheck);
+    Value *name = builder.CreateAdd(strtab, builder.CreateZExt(loadAt(i32Ty, sym), i64Ty), "name");
+    builder.CreateBr(nameHead);
+
+    builder.SetInsertPoint(nameHead);
+    PHINode *cursor = builder.CreatePHI(i64Ty, 2, "cursor");
+    cursor->addIncoming(name, nameCheck);
+    PHINode *fnv = builder.CreatePHI(i32Ty, 2, "fnv");
+    fnv->addIncoming(builder.getInt32(2166136261u), nameCheck);
+    Value *ch = loadAt(i8Ty, cursor);
+    builder.CreateCondBr(builder.CreateICmpEQ(ch, builder.getInt8(0)), nameDone, nameBody);
+
+    builder.SetInsertPoint(nameBody);
+    Value *mixed = builder.CreateMul(builder.CreateXor(fnv, builder.CreateZExt(ch, i32Ty)),
+                                     builder.getInt32(16777619u));
+    fnv->addIncoming(mixed, nameBody);
+    cursor->addIncoming(builder.CreateAdd(cursor, builder.getInt64(1)), nameBody);
+    builder.CreateBr(nameHead);
+
+    builder.SetInsertPoint(nameDone);
+    Value *expected = builder.CreateLoad(i32Ty,
+        builder.CreateInBoundsGEP(checks->getValueType(), checks, {builder.getInt64(0), idx}));
+    builder.CreateCondBr(builder.CreateICmpEQ(fnv, expected), found, chainStep);
+
+    builder.SetInsertPoint(found);
+    Value *addr = builder.CreateIntToPtr(builder.CreateAdd(base, value), ptrTy, "addr");
+    builder.CreateCondBr(isIfunc, ifunc, publish);
+
+    // IFUNC resolvers get AT_HWCAP as their first argument (used on AArch64,
+    // ignored on x86-64).
+    builder.SetInsertPoint(ifunc);
+    FunctionCallee getauxval = M.getOrInsertFunction("getauxval", FunctionType::get(i64Ty, {i64Ty}, false));
+    Value *hwcap = builder.CreateCall(getauxval, {builder.getInt64(16 /* AT_HWCAP */)});
+    Value *selected = builder.CreateCall(FunctionType::get(ptrTy, {i64Ty}, false),
+                                         addr, {hwcap});
+    builder.CreateBr(publish);
+
+    builder.SetInsertPoint(publish);
+    PHINode *target = builder.CreatePHI(ptrTy, 2, "target");
+    target->addIncoming(addr, found);
+    target->addIncoming(selected, ifunc);
+    builder.CreateAlignedStore(target, slot, slotAlign)->setAtomic(AtomicOrdering::Release);
+    builder.CreateBr(impNext);
+
+    builder.SetInsertPoint(chainStep);
+    Value *chainEnd = builder.CreateICmpNE(builder.CreateAnd(chainHash, builder.getInt64(1)), builder.getInt64(0));
+    builder.CreateCondBr(chainEnd, impMiss, chainNext);
+
+    builder.SetInsertPoint(chainNext);
+    symIdx->addIncoming(builder.CreateAdd(symIdx, builder.getInt64(1)), chainNext);
+    builder.CreateBr(chainHead);
+
+    builder.SetInsertPoint(impMiss);
+    Value *stillPending = builder.CreateAdd(pending, builder.getInt32(1));
+    builder.CreateBr(impNext);
+
+    builder.SetInsertPoint(impNext);
+    PHINode *pendingNext = builder.CreatePHI(i32Ty, 3);
+    pendingNext->addIncoming(pending, impBody);
+    pendingNext->addIncoming(pending, publish);
+    pendingNext->addIncoming(stillPending, impMiss);
+    idx->addIncoming(builder.CreateAdd(idx, builder.getInt64(1)), impNext);
+    pending->addIncoming(pendingNext, impNext);
+    builder.CreateBr(impHead);
+
+    // A non-zero return stops dl_iterate_phdr once every import is resolved.
+    builder.SetInsertPoint(finish);
+    builder.CreateRet(builder.CreateZExt(builder.CreateICmpEQ(pending, builder.getInt32(0)), i32Ty));
+
+    builder.SetInsertPoint(skip);
+    builder.CreateRet(builder.getInt32(0));
+
+    FunctionType *fnTy = FunctionType::get(ptrTy, {ptrTy}, false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.api_resolve_all", &M);
+    fn->addFnAttr(Attribute::NoInline);
+    fn->addFnAttr(Attribute::Cold);
+
+    builder.SetInsertPoint(BasicBlock::Create(ctx, "entry", fn));
+    FunctionCallee iterate = M.getOrInsertFunction("dl_iterate_phdr",
+        FunctionType::get(i32Ty, {ptrTy, ptrTy}, false));
+    builder.CreateCall(iterate, {scan, ConstantPointerNull::get(cast<PointerType>(ptrTy))});
+    LoadInst *resolved = builder.CreateAlignedLoad(ptrTy, fn->getArg(0), slotAlign);
+    resolved->setAtomic(AtomicOrdering::Acquire);
+    builder.CreateRet(resolved);
+    return fn;
+}
+
 PreservedAnalyses APIHidingPass::run(Module &M, ModuleAnalysisManager &AM) {
     bool modified = false;
     LLVMContext &ctx = M.getContext();
     IRBuilder<> builder(ctx);
     Triple targetTriple(M.getTargetTriple());
 
+    bool useGnuHash = getApiResolver() == ApiResolver::GnuHash && targetTriple.isOSLinux() &&
+                      M.getDataLayout().getPointerSize() == 8;
+
     // Step 1: Declare OS-specific dynamic loading functions
     FunctionCallee resolveFunc;
-    if (targetTriple.isOSWindows()) {
+    if (useGnuHash) {
+        // Resolved through dl_iterate_phdr in createGnuHashResolver
+    } else if (targetTriple.isOSWindows()) {
         FunctionType *loadLibTy = FunctionType::get(builder.getPtrTy(), {builder.getPtrTy()}, false);
         FunctionCallee loadLib = M.getOrInsertFunction("LoadLibraryA", loadLibTy);
         
@@ -30,10 +524,22 @@ PreservedAnalyses APIHidingPass::run(Module &M, ModuleAnalysisManager &AM) {
     }
 
     std::vector<CallInst *> targetCalls;
+    // Where each call site loads and, if needed, resolves its slot. Calls in a
+    // loop do it once in the preheader of the outermost loop that has one (or
+    // at the end of the entry block if none does); all other calls do it in
+    // place.
+    DenseMap<CallInst *, Instruction *> guardPoints;
+    auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+    ProfileSummaryInfo &PSI = AM.getResult<ProfileSummaryAnalysis>(M);
+    double hotRatio = getHotCallRatio();
+    LibcallPolicy libcalls = getLibcallPolicy();
+    ApiReport report;
+    const char *hiddenBy = useGnuHash ? "gnuhash" : targetTriple.isOSWindows() ? "GetProcAddress" : "dlsym";
 
     for (Function &F : M) {
         if (F.empty() || F.getName().starts_with("obf.")) continue;
 
+        std::vector<CallInst *> calls;
         for (BasicBlock &BB : F) {
             for (Instruction &I : BB) {
                 if (auto *callInst = dyn_cast<CallInst>(&I)) {
@@ -43,44 +549,143 @@ PreservedAnalyses APIHidingPass::run(Module &M, ModuleAnalysisManager &AM) {
                     if (callee && callee->isDeclaration() && !callee->isIntrinsic() && 
                         callee->getName() != "dlsym" && callee->getName() != "GetProcAddress" &&
                         callee->getName() != "LoadLibraryA") {
-                        targetCalls.push_back(callInst);
+                        calls.push_back(callInst);
                     }
                 }
             }
         }
+        if (calls.empty()) continue;
+
+        auto &LI = FAM.getResult<LoopAnalysis>(F);
+        auto &TLI = FAM.getResult<TargetLibraryAnalysis>(F);
+        BlockFrequencyInfo *BFI = hotRatio > 0.0 ? &FAM.getResult<BlockFrequencyAnalysis>(F) : nullptr;
+        bool useProfile = PSI.hasProfileSummary() && F.hasProfileData();
+        // The entry terminator dominates every loop and is never a rewritten
+        // call, unlike the entry block's first instruction
+        Instruction *entryPoint = F.getEntryBlock().getTerminator();
+
+        for (CallInst *CI : calls) {
+            BasicBlock *BB = CI->getParent();
+            std::string symbol = CI->getCalledFunction()->getName().str();
+            if (BFI) {
+                bool hot = useProfile
+                    ? PSI.isHotBlock(BB, BFI)
+                    : BFI->getBlockFreq(BB).getFrequency() >= hotRatio * BFI->getEntryFreq().getFrequency();
+                if (hot) {
+                    ++report[{"kept", symbol, "hot call site"}];
+                    continue;
+                }
+            }
+            if (libcalls == LibcallPolicy::Keep) {
+                if (const char *reason = getBuiltinExemption(CI, TLI)) {
+                    ++report[{"kept", symbol, reason}];
+                    continue;
+                }
+            }
+            ++report[{"hidden", symbol, hiddenBy}];
+
+            Instruction *guardPoint = CI;
+            if (Loop *L = LI.getLoopFor(BB)) {
+                guardPoint = entryPoint;
+                for (; L; L = L->getParentLoop()) {
+                    if (BasicBlock *preheader = L->getLoopPreheader()) guardPoint = preheader->getTerminator();
+                }
+            }
+            guardPoints[CI] = guardPoint;
+            targetCalls.push_back(CI);
+        }
+    }
+
+    // Step 2: Route every call through a per-symbol slot. Each imported symbol
+    // gets one pointer slot; a call site loads the slot and only calls the
+    // resolver while it is still null, so once resolved a call costs a load, a
+    // well-predicted branch and the indirect call. With the dlsym resolver each
+    // symbol also gets a name string; the GNU-hash resolver keeps only hashes
+    // and fills every slot in the module on its first call.
+    struct ImportSlot {
+        Constant *name = nullptr;
+        Constant *slot = nullptr;
+    };
+    StringMap<ImportSlot> imports;
+    std::vector<StringRef> importOrder;
+    for (CallInst *CI : targetCalls) {
+        if (imports.insert({CI->getCalledFunction()->getName(), ImportSlot()}).second)
+            importOrder.push_back(CI->getCalledFunction()->getName());
+    }
+    writeApiReport(M, report);
+    if (importOrder.empty()) return PreservedAnalyses::all();
+
+    DenseMap<std::pair<Instruction *, Constant *>, Value *> guardedTargets;
+    Function *resolver = nullptr;
+    MDNode *unlikely = MDBuilder(ctx).createBranchWeights(1, 2000);
+    Align slotAlign = M.getDataLayout().getPointerABIAlignment(0);
+    if (useGnuHash) {
+        std::vector<uint32_t> hashValues, checkValues;
+        for (StringRef funcName : importOrder) {
+            hashValues.push_back(gnuHash(funcName));
+            checkValues.push_back(nameCheckHash(funcName));
+        }
+        auto *hashes = new GlobalVariable(M, ArrayType::get(builder.getInt32Ty(), hashValues.size()), true,
+            GlobalValue::PrivateLinkage, ConstantDataArray::get(ctx, hashValues), "obf.api_hashes");
+        hashes->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        auto *checks = new GlobalVariable(M, ArrayType::get(builder.getInt32Ty(), checkValues.size()), true,
+            GlobalValue::PrivateLinkage, ConstantDataArray::get(ctx, checkValues), "obf.api_checks");
+        checks->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        ArrayType *slotsTy = ArrayType::get(builder.getPtrTy(), importOrder.size());
+        auto *slots = new GlobalVariable(M, slotsTy, false, GlobalValue::PrivateLinkage,
+            ConstantAggregateZero::get(slotsTy), "obf.api_slots");
+        slots->setAlignment(slotAlign);
+        for (size_t i = 0; i < importOrder.size(); ++i) {
+            imports[importOrder[i]].slot = ConstantExpr::getInBoundsGetElementPtr(slotsTy, slots,
+                ArrayRef<Constant *>{builder.getInt64(0), builder.getInt64(i)});
+        }
+        resolver = createGnuHashResolver(M, hashes, checks, slots, importOrder.size());
     }
 
-    // Step 2: Replace direct calls with dynamic resolution
     for (CallInst *CI : targetCalls) {
         Function *callee = CI->getCalledFunction();
         StringRef funcName = callee->getName();
 
         builder.SetInsertPoint(CI);
-        
-        // Create a global string for the function name
-        Constant *funcNameStr = builder.CreateGlobalStringPtr(funcName, "obf.api." + funcName.str());
-
-        Value *resolvedPtr = nullptr;
-        if (targetTriple.isOSWindows()) {
-            // GetProcAddress(GetModuleHandleA(NULL), "funcName")
-            FunctionType *getModTy = FunctionType::get(builder.getPtrTy(), {builder.getPtrTy()}, false);
-            FunctionCallee getMod = M.getOrInsertFunction("GetModuleHandleA", getModTy);
-            Value *hModule = builder.CreateCall(getMod, {ConstantPointerNull::get(builder.getPtrTy())});
-            resolvedPtr = builder.CreateCall(resolveFunc, {hModule, funcNameStr});
-        } else {
-            // dlsym(RTLD_DEFAULT, "funcName")
-            // RTLD_DEFAULT is usually 0 on Linux/Solaris, and -2 on macOS
-            intptr_t rtld_default_val = targetTriple.isMacOSX() ? -2 : 0;
-            // FIXED: Changed getIntToPtr to CreateIntToPtr
-            Value *handle = builder.CreateIntToPtr(builder.getInt64(rtld_default_val), builder.getPtrTy());
-            resolvedPtr = builder.CreateCall(resolveFunc, {handle, funcNameStr});
+
+        ImportSlot &import = imports[funcName];
+        if (!import.slot) {
+            // Create a global string for the function name
+            import.name = builder.CreateGlobalStringPtr(funcName, "obf.api." + funcName.str());
+            auto *slot = new GlobalVariable(M, builder.getPtrTy(), false, GlobalValue::PrivateLinkage,
+                ConstantPointerNull::get(builder.getPtrTy()), "obf.api_slot." + funcName.str());
+            slot->setAlignment(slotAlign);
+            import.slot = slot;
+        }
+        if (!resolver) resolver = createImportResolver(M, targetTriple, resolveFunc);
+
+        // Calls hoisted to the same guard point share one load and resolve.
+        Value *&resolvedPtr = guardedTargets[{guardPoints.lookup(CI), import.slot}];
+        if (!resolvedPtr) {
+            Instruction *guardPoint = guardPoints.lookup(CI);
+            builder.SetInsertPoint(guardPoint);
+            LoadInst *cached = builder.CreateAlignedLoad(builder.getPtrTy(), import.slot, slotAlign, "api_ptr");
+            cached->setAtomic(AtomicOrdering::Acquire);
+            BasicBlock *guardBlock = cached->getParent();
+            Instruction *slow = SplitBlockAndInsertIfThen(builder.CreateIsNull(cached), guardPoint, false, unlikely);
+            builder.SetInsertPoint(slow);
+            Value *resolved = useGnuHash ? builder.CreateCall(resolver, {import.slot})
+                                         : builder.CreateCall(resolver, {import.slot, import.name});
+            builder.SetInsertPoint(guardPoint);
+            PHINode *target = builder.CreatePHI(builder.getPtrTy(), 2, "api_target");
+            target->addIncoming(cached, guardBlock);
+            target->addIncoming(resolved, slow->getParent());
+            resolvedPtr = target;
         }
+        builder.SetInsertPoint(CI);
 
         // Replace the direct call with an indirect call
         FunctionType *calleeType = callee->getFunctionType();
         std::vector<Value *> args(CI->args().begin(), CI->args().end());
         
         CallInst *indirectCall = builder.CreateCall(calleeType, resolvedPtr, args);
+        indirectCall->setCallingConv(CI->getCallingConv());
+        indirectCall->setAttributes(CI->getAttributes());
         
         if (!CI->getType()->isVoidTy()) {
             CI->replaceAllUsesWith(indirectCall);
@@ -106,7 +711,11 @@ PassPluginLibraryInfo getAPIHidingPluginInfo() {
                 });
             PB.registerPipelineStartEPCallback(
                 [](ModulePassManager &MPM, OptimizationLevel Level) {
-                    MPM.addPass(APIHidingPass());
+                    if (getLibcallPolicy() != LibcallPolicy::Late) MPM.addPass(APIHidingPass());
+                });
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel Level) {
+                    if (getLibcallPolicy() == LibcallPolicy::Late) MPM.addPass(APIHidingPass());
                 });
         }};
 }
@@ -1,4 +1,6 @@
 #include "AntiDebugging.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Intrinsics.h"
@@ -7,10 +9,246 @@
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 #include "llvm/TargetParser/Triple.h"
 #include "../Utils/Random.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
 #include <vector>
 
 using namespace llvm;
 
+// Read the timing check probability from the HIDEIR_TIMING_PROB environment
+// variable, set by the orchestrator from the YAML config: the chance that each
+// eligible block gets a timing check. Defaults to 0.2.
+static double getTimingProbability() {
+    if (const char *env = std::getenv("HIDEIR_TIMING_PROB")) {
+        double val = std::atof(env);
+        if (val >= 0.0 && val <= 1.0) return val;
+    }
+    return 0.2;
+}
+
+// Read HIDEIR_TIMING_BUDGET: how many timing checks a function may execute per
+// call, estimated by BlockFrequencyInfo. Each check costs two cycle counter
+// reads (20-40 cycles each for rdtsc). Defaults to 2.0.
+static double getTimingBudget() {
+    if (const char *env = std::getenv("HIDEIR_TIMING_BUDGET")) {
+        double val = std::atof(env);
+        if (val >= 0.0) return val;
+    }
+    return 2.0;
+}
+
+// Read HIDEIR_TIMING_LIMIT_MS: how long a timed block may take before it
+// counts as single-stepped. A startup constructor converts it to cycle counter
+// ticks by timing the counter against the system clock. 0 skips calibration
+// and keeps the fixed 0xFFFFFFF-tick threshold. Defaults to 250.
+static uint64_t getTimingLimit() {
+    if (const char *env = std::getenv("HIDEIR_TIMING_LIMIT_MS")) {
+        return std::strtoull(env, nullptr, 10);
+    }
+    return 250;
+}
+
+// Read HIDEIR_TIMING_CONFIRM. When set, a timed block over the threshold only
+// traps if it was also over it on its previous run: each block keeps a strike
+// flag that a slow run sets and a fast run clears. A preemption or steal-time
+// spike slows one run, while single-stepping, or a breakpoint inside the
+// block, slows every run of it.
+static bool getTimingConfirm() {
+    if (const char *env = std::getenv("HIDEIR_TIMING_CONFIRM")) {
+        return std::atoi(env) != 0;
+    }
+    return false;
+}
+
+// Ticks of the uncalibrated threshold. At a few GHz this is a fraction of a
+// second, which a human stepping through the code in a debugger exceeds easily.
+static constexpr uint64_t kFixedTimingThreshold = 0xFFFFFFF;
+
+// Give a definition that every module of an image shares linkonce_odr
+// linkage, hidden visibility and, where the object format has them, its own
+// COMDAT, so the linker keeps a single copy per executable or shared library.
+static void shareWithinImage(GlobalObject *GO, const Triple &targetTriple) {
+    GO->setLinkage(GlobalValue::LinkOnceODRLinkage);
+    GO->setVisibility(GlobalValue::HiddenVisibility);
+    if (targetTriple.supportsCOMDAT())
+        GO->setComdat(GO->getParent()->getOrInsertComdat(GO->getName()));
+}
+
+// Create obf.timing_threshold.<limitMs> and the obf.timing_calibrate.<limitMs>
+// constructor that sets it. The constructor spins for a quarter millisecond of
+// system clock (clock_gettime(CLOCK_MONOTONIC), or QueryPerformanceCounter on
+// Windows) to find the counter ticks per millisecond, and times 16
+// back-to-back counter reads to find the cost of the counter itself, which is
+// large where the hypervisor traps it. The threshold is limitMs worth of ticks
+// plus the slowest read pair. Checks that run before the constructor, or after
+// a failed calibration, use the fixed threshold. Both are linkonce_odr and the
+// constructor entry is tied to the constructor's COMDAT, so an image built
+// from many modules calibrates once; where there are no COMDATs, the
+// constructor returns at once if the threshold is already set.
+static GlobalVariable *createTimingCalibration(Module &M, const Triple &targetTriple, uint64_t limitMs) {
+    LLVMContext &ctx = M.getContext();
+    IRBuilder<> builder(ctx);
+    Type *i32Ty = builder.getInt32Ty();
+    Type *i64Ty = builder.getInt64Ty();
+    Type *ptrTy = builder.getPtrTy();
+    Function *cycleCounter = Intrinsic::getDeclaration(&M, Intrinsic::readcyclecounter);
+
+    GlobalVariable *threshold = new GlobalVariable(
+        M, i64Ty, false, GlobalValue::LinkOnceODRLinkage,
+        builder.getInt64(kFixedTimingThreshold), "obf.timing_threshold." + Twine(limitMs));
+    shareWithinImage(threshold, targetTriple);
+
+    Function *calibrate = Function::Create(
+        FunctionType::get(builder.getVoidTy(), false),
+        GlobalValue::LinkOnceODRLinkage,
+        "obf.timing_calibrate." + Twine(limitMs),
+        &M);
+    shareWithinImage(calibrate, targetTriple);
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", calibrate);
+    BasicBlock *begin = BasicBlock::Create(ctx, "calibrate.begin", calibrate);
+    BasicBlock *spin = BasicBlock::Create(ctx, "calibrate.spin", calibrate);
+    BasicBlock *pairs = BasicBlock::Create(ctx, "calibrate.pairs", calibrate);
+    BasicBlock *store = BasicBlock::Create(ctx, "calibrate.store", calibrate);
+    BasicBlock *done = BasicBlock::Create(ctx, "calibrate.done", calibrate);
+    IRBuilder<> entryBuilder(entry);
+
+    // readClock() emits a clock read and returns its value and whether it succeeded
+    Value *clockBuf = nullptr;
+    Value *unitsPerMs = nullptr;
+    builder.SetInsertPoint(begin);
+    std::function<std::pair<Value *, Value *>()> readClock;
+    if (targetTriple.isOSWindows()) {
+        FunctionType *qpcType = FunctionType::get(i32Ty, {ptrTy}, false);
+        FunctionCallee qpc = M.getOrInsertFunction("QueryPerformanceCounter", qpcType);
+        FunctionCallee qpf = M.getOrInsertFunction("QueryPerformanceFrequency", qpcType);
+        clockBuf = entryBuilder.CreateAlloca(i64Ty, nullptr, "calibrate.clock");
+        builder.CreateCall(qpf, {clockBuf});
+        unitsPerMs = builder.CreateUDiv(builder.CreateLoad(i64Ty, clockBuf), builder.getInt64(1000));
+        readClock = [&builder, qpc, clockBuf, i64Ty]() {
+            Value *ok = builder.CreateICmpNE(builder.CreateCall(qpc, {clockBuf}), builder.getInt32(0));
+            return std::make_pair(builder.CreateLoad(i64Ty, clockBuf), ok);
+        };
+    } else {
+        // struct timespec { time_t tv_sec; long tv_nsec; }
+        Type *longTy = M.getDataLayout().getIntPtrType(ctx);
+        int clockMonotonic = targetTriple.isOSDarwin() ? 6
+            : (targetTriple.isOSFreeBSD() || targetTriple.isOSSolaris()) ? 4 : 1;
+        FunctionCallee clockGettime = M.getOrInsertFunction(
+            "clock_gettime", FunctionType::get(i32Ty, {i32Ty, ptrTy}, false));
+        clockBuf = entryBuilder.CreateAlloca(ArrayType::get(longTy, 2), nullptr, "calibrate.clock");
+        unitsPerMs = builder.getInt64(1000000);
+        readClock = [&builder, clockGettime, clockBuf, i64Ty, i32Ty, longTy, clockMonotonic]() {
+            Value *ret = builder.CreateCall(clockGettime, {builder.getInt32(clockMonotonic), clockBuf});
+            Value *sec = builder.CreateLoad(longTy, clockBuf);
+            Value *nsec = builder.CreateLoad(longTy, builder.CreateConstGEP1_32(longTy, clockBuf, 1));
+            Value *ns = builder.CreateAdd(
+                builder.CreateMul(builder.CreateSExt(sec, i64Ty), builder.getInt64(1000000000)),
+                builder.CreateSExt(nsec, i64Ty));
+            return std::make_pair(ns, builder.CreateICmpEQ(ret, builder.getInt32(0)));
+        };
+    }
+    Value *spinUnits = builder.CreateUDiv(unitsPerMs, builder.getInt64(4));
+    auto [start, startOk] = readClock();
+    Value *startTicks = builder.CreateCall(cycleCounter);
+    builder.CreateCondBr(startOk, spin, done);
+
+    // Spin until a quarter millisecond has passed
+    BasicBlock *check = BasicBlock::Create(ctx, "calibrate.check", calibrate, pairs);
+    BasicBlock *rate = BasicBlock::Create(ctx, "calibrate.rate", calibrate, pairs);
+    builder.SetInsertPoint(spin);
+    auto [now, nowOk] = readClock();
+    Value *endTicks = builder.CreateCall(cycleCounter);
+    Value *elapsed = builder.CreateSub(now, start);
+    builder.CreateCondBr(nowOk, check, done);
+
+    builder.SetInsertPoint(check);
+    builder.CreateCondBr(builder.CreateICmpULE(elapsed, spinUnits), spin, rate);
+
+    builder.SetInsertPoint(rate);
+    Value *ticksPerMs = builder.CreateUDiv(
+        builder.CreateMul(builder.CreateSub(endTicks, startTicks), unitsPerMs), elapsed, "ticks_per_ms");
+    builder.CreateCondBr(builder.CreateICmpEQ(ticksPerMs, builder.getInt64(0)), done, pairs);
+
+    // Slowest of 16 back-to-back counter reads
+    builder.SetInsertPoint(pairs);
+    PHINode *i = builder.CreatePHI(i32Ty, 2, "pair.i");
+    PHINode *slowest = builder.CreatePHI(i64Ty, 2, "pair.max");
+    i->addIncoming(builder.getInt32(0), rate);
+    slowest->addIncoming(builder.getInt64(0), rate);
+    Value *first = builder.CreateCall(cycleCounter);
+    Value *second = builder.CreateCall(cycleCounter);
+    Value *pair = builder.CreateSub(second, first);
+    Value *nextSlowest = builder.CreateSelect(builder.CreateICmpUGT(pair, slowest), pair, slowest);
+    Value *nextI = builder.CreateAdd(i, builder.getInt32(1));
+    i->addIncoming(nextI, pairs);
+    slowest->addIncoming(nextSlowest, pairs);
+    builder.CreateCondBr(builder.CreateICmpULT(nextI, builder.getInt32(16)), pairs, store);
+
+    builder.SetInsertPoint(store);
+    builder.CreateStore(
+        builder.CreateAdd(builder.CreateMul(ticksPerMs, builder.getInt64(limitMs)), nextSlowest),
+        threshold);
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+
+    // Another module's copy of the constructor may have run already
+    Value *calibrated = entryBuilder.CreateICmpNE(
+        entryBuilder.CreateLoad(i64Ty, threshold), entryBuilder.getInt64(kFixedTimingThreshold));
+    entryBuilder.CreateCondBr(calibrated, done, begin);
+
+    appendToGlobalCtors(M, calibrate, 0, calibrate);
+    return threshold;
+}
+
+// Pick the blocks of F that get a timing check. Blocks inside loops are never
+// timed, so a check runs at most once per call (function entry and the blocks
+// between loops) or once per loop entry (loop preheaders). The entry block is
+// considered first, then the preheaders, then the remaining blocks; each is
+// drawn with the given probability and kept while the estimated executions
+// per call of the checks kept so far stay within the budget.
+static std::vector<BasicBlock *> selectTimedBlocks(
+    Function &F,
+    LoopInfo &LI,
+    BlockFrequencyInfo &BFI,
+    double probability,
+    double budget)
+{
+    std::vector<BasicBlock *> candidates;
+    candidates.push_back(&F.getEntryBlock());
+    for (Loop *L : LI) {
+        if (BasicBlock *preheader = L->getLoopPreheader()) {
+            if (preheader != &F.getEntryBlock()) candidates.push_back(preheader);
+        }
+    }
+    for (BasicBlock &BB : F) {
+        if (LI.getLoopFor(&BB) || std::find(candidates.begin(), candidates.end(), &BB) != candidates.end()) continue;
+        candidates.push_back(&BB);
+    }
+
+    std::vector<BasicBlock *> selected;
+    double entryFreq = static_cast<double>(BFI.getEntryFreq().getFrequency());
+    double spent = 0.0;
+    for (BasicBlock *BB : candidates) {
+        if (probability < 1.0) {
+            double roll = ObfuscatorUtils::Random::generateRandomIntInRange(0, 10000) / 10000.0;
+            if (roll >= probability) continue;
+        }
+
+        BasicBlock::iterator first = BB->getFirstInsertionPt();
+        while (BB->isEntryBlock() && isa<AllocaInst>(*first)) ++first;
+        if (&*first == BB->getTerminator()) continue;
+
+        double cost = entryFreq > 0.0 ? BFI.getBlockFreq(BB).getFrequency() / entryFreq : 1.0;
+        if (spent + cost > budget) continue;
+        spent += cost;
+        selected.push_back(BB);
+    }
+    return selected;
+}
+
 PreservedAnalyses AntiDebuggingPass::run(Module &M, ModuleAnalysisManager &AM) {
     bool modified = false;
     LLVMContext &ctx = M.getContext();
@@ -82,20 +320,28 @@ PreservedAnalyses AntiDebuggingPass::run(Module &M, ModuleAnalysisManager &AM) {
     // ==========================================
     if (targetTriple.isX86() || targetTriple.isPPC()) {
     Function *cycleCounter = Intrinsic::getDeclaration(&M, Intrinsic::readcyclecounter);
+    FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+    double probability = getTimingProbability();
+    double budget = getTimingBudget();
+    uint64_t limitMs = getTimingLimit();
+    GlobalVariable *threshold = limitMs ? createTimingCalibration(M, targetTriple, limitMs) : nullptr;
+    bool confirm = getTimingConfirm();
     
     for (Function &F : M) {
         if (F.empty() || F.getName().starts_with("obf.")) continue;
 
-        std::vector<BasicBlock *> blocks;
-        for (BasicBlock &BB : F) blocks.push_back(&BB);
+        std::vector<BasicBlock *> blocks = selectTimedBlocks(
+            F,
+            FAM.getResult<LoopAnalysis>(F),
+            FAM.getResult<BlockFrequencyAnalysis>(F),
+            probability,
+            budget);
 
         for (BasicBlock *BB : blocks) {
-            // Randomly inject timing traps (20% probability)
-            if (ObfuscatorUtils::Random::generateRandomIntInRange(1, 100) > 20) continue;
-            
-            Instruction *firstInst = &*BB->getFirstInsertionPt();
+            BasicBlock::iterator first = BB->getFirstInsertionPt();
+            while (BB->isEntryBlock() && isa<AllocaInst>(*first)) ++first;
+            Instruction *firstInst = &*first;
             Instruction *termInst = BB->getTerminator();
-            if (!termInst || firstInst == termInst || isa<PHINode>(firstInst)) continue;
 
             // Start timer
             builder.SetInsertPoint(firstInst);
@@ -107,9 +353,11 @@ PreservedAnalyses AntiDebuggingPass::run(Module &M, ModuleAnalysisManager &AM) {
             
             Value *diff = builder.CreateSub(endCycles, startCycles);
             
-            // 0xFFFFFFF CPU cycles is roughly a fraction of a second.
-            // A human manually stepping through assembly in GDB will trigger this easily.
-            Value *isStepping = builder.CreateICmpUGT(diff, builder.getInt64(0xFFFFFFF));
+            // A human manually stepping through assembly in GDB exceeds the
+            // calibrated (or fixed) threshold easily.
+            Value *limit = threshold ? static_cast<Value *>(builder.CreateLoad(builder.getInt64Ty(), threshold))
+                                     : builder.getInt64(kFixedTimingThreshold);
+            Value *isStepping = builder.CreateICmpUGT(diff, limit);
 
             BasicBlock *timeTrapBB = BasicBlock::Create(ctx, "time_trap", &F);
             BasicBlock *timeContBB = BB->splitBasicBlock(termInst, "time_cont");
@@ -118,9 +366,42 @@ PreservedAnalyses AntiDebuggingPass::run(Module &M, ModuleAnalysisManager &AM) {
             trapBuilder.CreateCall(trapIntrinsic);
             trapBuilder.CreateUnreachable();
 
+            // Optionally trap only on the block's second slow run in a row
+            BasicBlock *slowBB = timeTrapBB;
+            BasicBlock *fastBB = timeContBB;
+            if (confirm) {
+                GlobalVariable *strike = new GlobalVariable(
+                    M, builder.getInt8Ty(), false, GlobalValue::PrivateLinkage,
+                    builder.getInt8(0), "obf.timing_strike");
+                auto loadStrike = [&](IRBuilder<> &SB) {
+                    LoadInst *load = SB.CreateAlignedLoad(SB.getInt8Ty(), strike, Align(1));
+                    load->setAtomic(AtomicOrdering::Monotonic);
+                    return SB.CreateICmpNE(load, SB.getInt8(0));
+                };
+                auto storeStrike = [&](IRBuilder<> &SB, uint8_t value) {
+                    SB.CreateAlignedStore(SB.getInt8(value), strike, Align(1))
+                        ->setAtomic(AtomicOrdering::Monotonic);
+                };
+
+                slowBB = BasicBlock::Create(ctx, "time_confirm", &F, timeTrapBB);
+                IRBuilder<> confirmBuilder(slowBB);
+                Value *struck = loadStrike(confirmBuilder);
+                storeStrike(confirmBuilder, 1);
+                confirmBuilder.CreateCondBr(struck, timeTrapBB, timeContBB);
+
+                // A fast run only writes the flag when it has to clear it
+                fastBB = BasicBlock::Create(ctx, "time_fast", &F, slowBB);
+                BasicBlock *clearBB = BasicBlock::Create(ctx, "time_clear", &F, slowBB);
+                IRBuilder<> fastBuilder(fastBB);
+                fastBuilder.CreateCondBr(loadStrike(fastBuilder), clearBB, timeContBB);
+                IRBuilder<> clearBuilder(clearBB);
+                storeStrike(clearBuilder, 0);
+                clearBuilder.CreateBr(timeContBB);
+            }
+
             BB->getTerminator()->eraseFromParent();
             IRBuilder<> branchBuilder(BB);
-            branchBuilder.CreateCondBr(isStepping, timeTrapBB, timeContBB);
+            branchBuilder.CreateCondBr(isStepping, slowBB, fastBB);
             
             modified = true;
         }
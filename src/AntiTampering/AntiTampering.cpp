@@ -1,20 +1,392 @@
 #include "AntiTampering.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/IntrinsicsAArch64.h"
+#include "llvm/IR/IntrinsicsX86.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Triple.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
+#include <cstdlib>
+#include <tuple>
 #include <vector>
 
 using namespace llvm;
 
-static std::pair<Value*, BasicBlock*> createHashLoop(
+enum class TamperMode { Entry, Sampled, Window, Watchdog, Page };
+
+// Read HIDEIR_TAMPER_MODE. "entry" (default) hashes the function on every
+// call; "sampled" runs the check on every Nth protected call per thread;
+// "window" runs it at most once per cycle-counter window per thread. The
+// sampled and window gates cost a thread-local load, compare and store.
+// "watchdog" inserts no checks into the functions at all and re-verifies
+// them from a background thread instead. "page" hashes the image's code in
+// 4 KiB pages; a check only loads its function's verified flag and re-hashes
+// the function's pages when a background thread has expired it at the end of
+// an epoch. On ELF targets the pages cover the whole executable segment
+// holding the protected functions; elsewhere they run from the lowest
+// protected function to the first 64 bytes of the highest one.
+static TamperMode getTamperMode() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_MODE")) {
+        if (StringRef(env) == "sampled") return TamperMode::Sampled;
+        if (StringRef(env) == "window") return TamperMode::Window;
+        if (StringRef(env) == "watchdog") return TamperMode::Watchdog;
+        if (StringRef(env) == "page") return TamperMode::Page;
+    }
+    return TamperMode::Entry;
+}
+
+// Read HIDEIR_TAMPER_SAMPLE_RATE: in sampled mode, the number of protected
+// calls per thread between two checks. Defaults to 64.
+static uint32_t getTamperSampleRate() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_SAMPLE_RATE")) {
+        int val = std::atoi(env);
+        if (val >= 1) return static_cast<uint32_t>(val);
+    }
+    return 64;
+}
+
+// Read HIDEIR_TAMPER_WINDOW: in window mode, the number of cycle-counter
+// ticks (llvm.readcyclecounter: TSC on x86, CNTVCT on AArch64) between two
+// checks on a thread. Defaults to 2^24, a few milliseconds on current CPUs.
+// On targets without a cycle counter the check runs once per thread.
+static uint64_t getTamperWindow() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_WINDOW")) {
+        uint64_t val = std::strtoull(env, nullptr, 10);
+        if (val > 0) return val;
+    }
+    return 1ull << 24;
+}
+
+// Read HIDEIR_TAMPER_JITTER. When set, each re-arm draws the next interval
+// uniformly from [N/2, 3N/2) with a per-thread xorshift generator, so checks
+// do not land at a predictable call count or time.
+static bool getTamperJitter() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_JITTER")) {
+        return std::atoi(env) != 0;
+    }
+    return false;
+}
+
+// Read HIDEIR_TAMPER_WATCHDOG_PERIOD: milliseconds the watchdog thread
+// sleeps between two verification rounds. Defaults to 1000. All modules of an
+// image share one thread, which uses the shortest period any of them asks for.
+static uint64_t getWatchdogPeriod() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_WATCHDOG_PERIOD")) {
+        uint64_t val = std::strtoull(env, nullptr, 10);
+        if (val > 0) return val;
+    }
+    return 1000;
+}
+
+// Read HIDEIR_TAMPER_WATCHDOG_BUDGET: the number of functions the watchdog
+// verifies per round, continuing round-robin in the next round. This caps the
+// CPU time of a round. Defaults to 0, which verifies every function each round.
+static uint64_t getWatchdogBudget() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_WATCHDOG_BUDGET")) {
+        return std::strtoull(env, nullptr, 10);
+    }
+    return 0;
+}
+
+// Read HIDEIR_TAMPER_EPOCH: in page mode, the milliseconds a verified page
+// is trusted before its next check re-hashes it. Defaults to 1000.
+static uint64_t getTamperEpoch() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_EPOCH")) {
+        uint64_t val = std::strtoull(env, nullptr, 10);
+        if (val > 0) return val;
+    }
+    return 1000;
+}
+
+// Read HIDEIR_TAMPER_BASELINE. "startup" (default) hashes every protected
+// function in a constructor to take the baselines. "postlink" emits the
+// baselines unset into the .hideir_tamper section instead, and
+// hideir-tamper-patch fills them in from the linked ELF image, so nothing is
+// hashed at startup. Only honoured for ELF targets, and not in page mode,
+// whose page baselines are always taken at startup.
+static bool getPostLinkBaseline() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_BASELINE")) {
+        return StringRef(env) == "postlink";
+    }
+    return false;
+}
+
+// Read HIDEIR_TAMPER_FULL_LENGTH, set along with hideir-tamper-patch
+// --full-length: the post-link baselines then cover whole functions instead
+// of the 64-byte window. Only the report uses it; the checks read their
+// lengths from the patched table.
+static bool getTamperFullLength() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_FULL_LENGTH")) {
+        return std::atoi(env) != 0;
+    }
+    return false;
+}
+
+enum class TamperSelect { All, Auto };
+
+// Read HIDEIR_TAMPER_SELECT. "all" (default) protects every function in the
+// module. "auto" skips functions the inliner will copy into their callers
+// anyway (always-inline, single-caller local, or smaller than
+// HIDEIR_TAMPER_MIN_SIZE) and, in entry, sampled and window modes, hot
+// functions whose entry checks would dominate their cost.
+static TamperSelect getTamperSelect() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_SELECT")) {
+        if (StringRef(env) == "auto") return TamperSelect::Auto;
+    }
+    return TamperSelect::All;
+}
+
+// Read HIDEIR_TAMPER_MIN_SIZE: in auto selection, functions with fewer IR
+// instructions than this are left unprotected. Defaults to 20.
+static unsigned getTamperMinSize() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_MIN_SIZE")) {
+        int val = std::atoi(env);
+        if (val >= 0) return static_cast<unsigned>(val);
+    }
+    return 20;
+}
+
+// Read HIDEIR_TAMPER_HOT_RATIO: in auto selection without a PGO profile, a
+// function estimated to run at least this many times per call of a module
+// entry point is hot. With a profile, the profile's hot-entry test decides.
+// Defaults to 8.
+static double getTamperHotRatio() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_HOT_RATIO")) {
+        double val = std::atof(env);
+        if (val > 0.0) return val;
+    }
+    return 8.0;
+}
+
+// Read HIDEIR_TAMPER_VOUCH. When set, a hot function skipped by auto
+// selection is verified by its least frequently run protected caller, whose
+// entry check then also hashes the callee.
+static bool getTamperVouch() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_VOUCH")) {
+        return std::atoi(env) != 0;
+    }
+    return false;
+}
+
+enum class TamperHash { FNV1a, Wide, CRC32C };
+
+// Read HIDEIR_TAMPER_HASH, the hash kernel of the integrity checks.
+// "fnv1a" (default) hashes one byte per iteration. "wide" hashes 32 bytes per
+// iteration in four independent 64-bit multiply-add lanes. "crc32c" does the
+// same with four CRC32C lanes, using the SSE4.2 (x86-64) or CRC (AArch64)
+// instructions, and falls back to "wide" when the protected functions are
+// not compiled for them. hideir-tamper-patch implements all three.
+static TamperHash getTamperHash() {
+    if (const char *env = std::getenv("HIDEIR_TAMPER_HASH")) {
+        StringRef hash(env);
+        if (hash == "wide") return TamperHash::Wide;
+        if (hash == "crc32c") return TamperHash::CRC32C;
+    }
+    return TamperHash::FNV1a;
+}
+
+static const char *getTamperHashName(TamperHash kernel) {
+    switch (kernel) {
+    case TamperHash::Wide:
+        return "wide";
+    case TamperHash::CRC32C:
+        return "crc32c";
+    default:
+        return "fnv1a";
+    }
+}
+
+// Target feature providing the CRC32C instructions, if the target has one
+// (clang enables "+crc32" along with SSE4.2)
+static StringRef getCRC32CFeature(const Triple &targetTriple) {
+    if (targetTriple.getArch() == Triple::x86_64) return "+crc32";
+    if (targetTriple.getArch() == Triple::aarch64) return "+crc";
+    return "";
+}
+
+static bool hasTargetFeature(const Function &F, StringRef feature) {
+    SmallVector<StringRef, 32> features;
+    F.getFnAttribute("target-features").getValueAsString().split(features, ',');
+    return is_contained(features, feature);
+}
+
+// Use CRC32C only if every function that runs a check may execute the
+// instructions; otherwise the checks would fault on older CPUs.
+static TamperHash resolveTamperHash(
+    TamperHash hash,
+    const Triple &targetTriple,
+    const std::vector<Function *> &targets)
+{
+    if (hash != TamperHash::CRC32C) return hash;
+    StringRef feature = getCRC32CFeature(targetTriple);
+    if (feature.empty()) return TamperHash::Wide;
+    for (Function *F : targets)
+        if (!hasTargetFeature(*F, feature)) return TamperHash::Wide;
+    return TamperHash::CRC32C;
+}
+
+// Build the post-link baseline table in the .hideir_tamper section:
+//   { [8 x i8] "HIDEIRT?", iN count, [count x { iN offset, i32 length, i32 hash }] }
+// with iN the pointer width and the last magic byte naming the hash kernel:
+// 'P' for FNV-1a, 'W' for the wide kernel and 'C' for CRC32C. `offset` is
+// the function address relative to the entry itself, so the linker resolves
+// it without a dynamic relocation and the patcher can read it straight from
+// the file. `length` starts at the
+// 64-byte hash window and `hash` at 0 until the patcher rewrites them.
+// Returns the addresses of each entry's length and hash fields.
+static std::pair<std::vector<Constant *>, std::vector<Constant *>>
+createBaselineTable(Module &M, const std::vector<Function *> &targets, TamperHash kernel)
+{
+    LLVMContext &ctx = M.getContext();
+    Type *i32Ty = Type::getInt32Ty(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    Type *intPtrTy = M.getDataLayout().getIntPtrType(ctx);
+    StructType *entryTy = StructType::get(ctx, {intPtrTy, i32Ty, i32Ty});
+    ArrayType *entriesTy = ArrayType::get(entryTy, targets.size());
+    StructType *tableTy = StructType::get(
+        ctx,
+        {ArrayType::get(Type::getInt8Ty(ctx), 8), intPtrTy, entriesTy});
+
+    GlobalVariable *table = new GlobalVariable(
+        M,
+        tableTy,
+        true,
+        GlobalValue::PrivateLinkage,
+        nullptr,
+        "obf.tamper_baseline_table");
+    table->setSection(".hideir_tamper");
+    table->setAlignment(M.getDataLayout().getPointerABIAlignment(0));
+
+    std::vector<Constant *> entries, lengths, hashes;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        Function *F = targets[i];
+        auto field = [&](unsigned idx) {
+            return ConstantExpr::getInBoundsGetElementPtr(
+                tableTy,
+                table,
+                ArrayRef<Constant *>{
+                    ConstantInt::get(i32Ty, 0),
+                    ConstantInt::get(i32Ty, 2),
+                    ConstantInt::get(i32Ty, i),
+                    ConstantInt::get(i32Ty, idx)});
+        };
+
+        // A preemptible symbol cannot be the target of a link-time
+        // PC-relative reference in a shared object; go through a local
+        // alias. Weak definitions are never preemptible here, see run().
+        Constant *target = F;
+        if (!F->hasLocalLinkage() && !F->isDSOLocal())
+            target = GlobalAlias::create(
+                GlobalValue::PrivateLinkage,
+                "obf.tamper_alias." + F->getName(),
+                F);
+
+        Constant *offset = ConstantExpr::getSub(
+            ConstantExpr::getPtrToInt(target, i64Ty),
+            ConstantExpr::getPtrToInt(field(0), i64Ty));
+        if (intPtrTy != i64Ty)
+            offset = ConstantExpr::getTrunc(offset, intPtrTy);
+
+        entries.push_back(ConstantStruct::get(
+            entryTy,
+            {offset, ConstantInt::get(i32Ty, 64), ConstantInt::get(i32Ty, 0)}));
+        lengths.push_back(field(1));
+        hashes.push_back(field(2));
+    }
+
+    const char *magic = kernel == TamperHash::CRC32C ? "HIDEIRTC"
+                        : kernel == TamperHash::Wide ? "HIDEIRTW"
+                                                     : "HIDEIRTP";
+    table->setInitializer(ConstantStruct::get(
+        tableTy,
+        {ConstantDataArray::getString(ctx, magic, false),
+         ConstantInt::get(intPtrTy, targets.size()),
+         ConstantArray::get(entriesTy, entries)}));
+    return {lengths, hashes};
+}
+
+// Build the cold re-arm helper of the sampled and window gates:
+//   void obf.tamper_rearm()
+// It stores the next countdown (sampled) or deadline (window) into the
+// thread-local gate variable, optionally jittered by a thread-local xorshift32
+// state seeded from that state's own (per-thread) address.
+static Function *createRearmFunction(
+    Module &M,
+    TamperMode mode,
+    GlobalVariable *gate,
+    uint64_t interval,
+    bool jitter)
+{
+    LLVMContext &ctx = M.getContext();
+    FunctionType *fnTy = FunctionType::get(Type::getVoidTy(ctx), false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.tamper_rearm", &M);
+    fn->addFnAttr(Attribute::NoInline);
+    fn->addFnAttr(Attribute::Cold);
+
+    IRBuilder<> B(BasicBlock::Create(ctx, "entry", fn));
+    Type *gateTy = gate->getValueType();
+
+    Value *next = ConstantInt::get(gateTy, interval);
+    if (jitter && interval >= 2) {
+        GlobalVariable *rng = new GlobalVariable(
+            M,
+            B.getInt32Ty(),
+            false,
+            GlobalValue::InternalLinkage,
+            B.getInt32(0),
+            "obf.tamper_rng",
+            nullptr,
+            GlobalValue::GeneralDynamicTLSModel);
+
+        Value *state = B.CreateLoad(B.getInt32Ty(), rng);
+        Value *seed = B.CreateOr(
+            B.CreateTrunc(B.CreatePtrToInt(rng, B.getInt64Ty()), B.getInt32Ty()),
+            B.getInt32(1));
+        state = B.CreateSelect(B.CreateICmpEQ(state, B.getInt32(0)), seed, state);
+
+        // xorshift32
+        state = B.CreateXor(state, B.CreateShl(state, 13));
+        state = B.CreateXor(state, B.CreateLShr(state, 17));
+        state = B.CreateXor(state, B.CreateShl(state, 5));
+        B.CreateStore(state, rng);
+
+        Value *offset = B.CreateURem(
+            B.CreateZExt(state, gateTy),
+            ConstantInt::get(gateTy, interval));
+        next = B.CreateAdd(ConstantInt::get(gateTy, interval / 2), offset);
+    }
+
+    if (mode == TamperMode::Window) {
+        Function *counter = Intrinsic::getDeclaration(&M, Intrinsic::readcyclecounter);
+        next = B.CreateAdd(B.CreateCall(counter), next);
+    }
+    B.CreateStore(next, gate);
+    B.CreateRetVoid();
+    return fn;
+}
+
+// Byte loop: state = step(state, byte) for each of the first `length` bytes
+// of `targetFunc`, starting from `init`. Runs at least once.
+static std::pair<Value*, BasicBlock*> createByteLoop(
     LLVMContext &ctx,
-    IRBuilder<> &B,
     Function *parentFunc,
-    Function *targetFunc,
-    BasicBlock *startBlock)
+    Value *targetFunc,
+    Value *length,
+    BasicBlock *startBlock,
+    Value *init,
+    function_ref<Value *(IRBuilder<> &, Value *, Value *)> step)
 {
     // Create loop blocks
     BasicBlock *loopHeader = BasicBlock::Create(ctx, "hash.loop", parentFunc);
@@ -27,37 +399,29 @@ static std::pair<Value*, BasicBlock*> createHashLoop(
     // Loop body
     IRBuilder<> loopBuilder(loopHeader);
 
-    PHINode *iNode = loopBuilder.CreatePHI(B.getInt32Ty(), 2, "hash.i");
-    PHINode *hashNode = loopBuilder.CreatePHI(B.getInt32Ty(), 2, "hash.val");
-
-    Value *startHash = B.getInt32(0x811c9dc5);
+    PHINode *iNode = loopBuilder.CreatePHI(loopBuilder.getInt32Ty(), 2, "hash.i");
+    PHINode *hashNode = loopBuilder.CreatePHI(init->getType(), 2, "hash.val");
 
-    iNode->addIncoming(B.getInt32(0), startBlock);
-    hashNode->addIncoming(startHash, startBlock);
+    iNode->addIncoming(loopBuilder.getInt32(0), startBlock);
+    hashNode->addIncoming(init, startBlock);
 
     // Cast function to pointer
-    Value *funcPtr = loopBuilder.CreatePointerCast(targetFunc, B.getPtrTy());
+    Value *funcPtr = loopBuilder.CreatePointerCast(targetFunc, loopBuilder.getPtrTy());
 
     // Read byte
     Value *bytePtr = loopBuilder.CreateInBoundsGEP(
-        B.getInt8Ty(), funcPtr, iNode);
+        loopBuilder.getInt8Ty(), funcPtr, iNode);
 
     Value *byteVal = loopBuilder.CreateLoad(
-        B.getInt8Ty(), bytePtr, true);
+        loopBuilder.getInt8Ty(), bytePtr, true);
 
-    Value *byteExt = loopBuilder.CreateZExt(
-        byteVal, B.getInt32Ty());
-
-    // FNV-1a
-    Value *xorVal = loopBuilder.CreateXor(hashNode, byteExt);
-    Value *newHash = loopBuilder.CreateMul(
-        xorVal, B.getInt32(16777619));
+    Value *newHash = step(loopBuilder, hashNode, byteVal);
 
     Value *nextI = loopBuilder.CreateAdd(
-        iNode, B.getInt32(1));
+        iNode, loopBuilder.getInt32(1));
 
     Value *cond = loopBuilder.CreateICmpSLT(
-        nextI, B.getInt32(64));
+        nextI, length);
 
     loopBuilder.CreateCondBr(cond, loopHeader, loopEnd);
 
@@ -67,71 +431,1219 @@ static std::pair<Value*, BasicBlock*> createHashLoop(
     return { newHash, loopEnd };
 }
 
-PreservedAnalyses AntiTamperingPass::run(Module &M, ModuleAnalysisManager &) {
+// FNV-1a step
+static Value *fnv1aStep(IRBuilder<> &B, Value *hash, Value *byte) {
+    Value *xorVal = B.CreateXor(hash, B.CreateZExt(byte, B.getInt32Ty()));
+    return B.CreateMul(xorVal, B.getInt32(16777619));
+}
+
+// Hash the first `length` bytes of `targetFunc` with `kernel`, starting at
+// `startBlock`. Returns the 32-bit hash and the (unterminated) block it is
+// available in.
+//
+// The wide and CRC32C kernels read 32-byte blocks at offsets 0, 32, 64, ...
+// and a last block at length - 32, which overlaps its predecessor unless
+// length is a multiple of 32, so no byte tail remains. Each 8-byte word of a
+// block goes to its own lane, so the four dependency chains overlap; the
+// lanes are folded into one hash at the end. Lengths below 32 are hashed
+// bytewise: with FNV-1a by the wide kernel, with the byte form of the
+// instruction by CRC32C. hideir-tamper-patch mirrors this exactly.
+static std::pair<Value*, BasicBlock*> createHashLoop(
+    LLVMContext &ctx,
+    IRBuilder<> &B,
+    Function *parentFunc,
+    Value *targetFunc,
+    Value *length,
+    BasicBlock *startBlock,
+    TamperHash kernel = TamperHash::FNV1a)
+{
+    if (kernel == TamperHash::FNV1a)
+        return createByteLoop(
+            ctx, parentFunc, targetFunc, length, startBlock,
+            B.getInt32(0x811c9dc5), fnv1aStep);
+
+    Module &M = *parentFunc->getParent();
+    Triple targetTriple(M.getTargetTriple());
+    bool crc = kernel == TamperHash::CRC32C;
+    bool x86 = targetTriple.getArch() == Triple::x86_64;
+    if (crc) {
+        // Helpers the pass creates (constructor, watchdog) run on the same
+        // CPUs as the protected functions, which all have the feature
+        StringRef feature = getCRC32CFeature(targetTriple);
+        if (!hasTargetFeature(*parentFunc, feature)) {
+            StringRef features =
+                parentFunc->getFnAttribute("target-features").getValueAsString();
+            parentFunc->addFnAttr(
+                "target-features",
+                features.empty() ? feature.str() : (features + "," + feature).str());
+        }
+    }
+
+    Type *i32Ty = B.getInt32Ty();
+    Type *i64Ty = B.getInt64Ty();
+    const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+    const uint64_t seeds[4] = {
+        0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL,
+        0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL};
+
+    // crc = crc32c(crc, 8 bytes of word)
+    auto crcWord = [&](IRBuilder<> &CB, Value *crcVal, Value *word) -> Value * {
+        if (x86)
+            return CB.CreateTrunc(
+                CB.CreateCall(
+                    Intrinsic::getDeclaration(&M, Intrinsic::x86_sse42_crc32_64_64),
+                    {CB.CreateZExt(crcVal, i64Ty), word}),
+                i32Ty);
+        return CB.CreateCall(
+            Intrinsic::getDeclaration(&M, Intrinsic::aarch64_crc32cx),
+            {crcVal, word});
+    };
+    // lane = (lane + word) * prime; lane ^= lane >> 29. An add, not a xor,
+    // so a seed immediate read back as a word of the first block cannot
+    // cancel itself out.
+    auto mixWord = [&](IRBuilder<> &MB, Value *lane, Value *word) -> Value * {
+        lane = MB.CreateMul(MB.CreateAdd(lane, word), ConstantInt::get(i64Ty, prime));
+        return MB.CreateXor(lane, MB.CreateLShr(lane, 29));
+    };
+
+    BasicBlock *wordLoop = BasicBlock::Create(ctx, "hash.words", parentFunc);
+    BasicBlock *wordEnd = BasicBlock::Create(ctx, "hash.words.end", parentFunc);
+    BasicBlock *byteStart = BasicBlock::Create(ctx, "hash.bytes", parentFunc);
+    BasicBlock *done = BasicBlock::Create(ctx, "hash.done", parentFunc);
+
+    IRBuilder<> startBuilder(startBlock);
+    Value *last = startBuilder.CreateSub(length, startBuilder.getInt32(32), "hash.last");
+    startBuilder.CreateCondBr(
+        startBuilder.CreateICmpSGE(length, startBuilder.getInt32(32)),
+        wordLoop,
+        byteStart);
+
+    // One 32-byte block per iteration, one word per lane
+    IRBuilder<> loopBuilder(wordLoop);
+    PHINode *offset = loopBuilder.CreatePHI(i32Ty, 2, "hash.off");
+    offset->addIncoming(loopBuilder.getInt32(0), startBlock);
+    std::vector<PHINode *> lanePhis;
+    for (unsigned k = 0; k < 4; ++k) {
+        PHINode *lane = loopBuilder.CreatePHI(crc ? i32Ty : i64Ty, 2, "hash.lane");
+        lane->addIncoming(
+            crc ? loopBuilder.getInt32(0xffffffff) : ConstantInt::get(i64Ty, seeds[k]),
+            startBlock);
+        lanePhis.push_back(lane);
+    }
+
+    Value *funcPtr = loopBuilder.CreatePointerCast(targetFunc, loopBuilder.getPtrTy());
+    Value *blockPtr = loopBuilder.CreateInBoundsGEP(loopBuilder.getInt8Ty(), funcPtr, offset);
+    std::vector<Value *> lanes;
+    for (unsigned k = 0; k < 4; ++k) {
+        PHINode *lane = lanePhis[k];
+        Value *wordPtr = k == 0 ? blockPtr
+                                : loopBuilder.CreateConstInBoundsGEP1_32(
+                                      loopBuilder.getInt8Ty(), blockPtr, 8 * k);
+        Value *word = loopBuilder.CreateAlignedLoad(i64Ty, wordPtr, Align(1), true);
+        Value *next = crc ? crcWord(loopBuilder, lane, word) : mixWord(loopBuilder, lane, word);
+        lane->addIncoming(next, wordLoop);
+        lanes.push_back(next);
+    }
+
+    // The final block starts at length - 32
+    Value *nextOffset = loopBuilder.CreateAdd(offset, loopBuilder.getInt32(32));
+    nextOffset = loopBuilder.CreateSelect(
+        loopBuilder.CreateICmpSLT(nextOffset, last), nextOffset, last);
+    offset->addIncoming(nextOffset, wordLoop);
+    loopBuilder.CreateCondBr(loopBuilder.CreateICmpSLT(offset, last), wordLoop, wordEnd);
+
+    // Fold the lanes into 32 bits
+    IRBuilder<> endBuilder(wordEnd);
+    Value *wordHash = lanes[0];
+    for (unsigned k = 1; k < 4; ++k)
+        wordHash = crc ? crcWord(endBuilder, wordHash, endBuilder.CreateZExt(lanes[k], i64Ty))
+                       : mixWord(endBuilder, wordHash, lanes[k]);
+    if (!crc)
+        wordHash = endBuilder.CreateTrunc(
+            endBuilder.CreateXor(wordHash, endBuilder.CreateLShr(wordHash, 32)),
+            i32Ty);
+    endBuilder.CreateBr(done);
+
+    // Short lengths, one byte at a time
+    auto [byteHash, byteEnd] = createByteLoop(
+        ctx, parentFunc, targetFunc, length, byteStart,
+        B.getInt32(crc ? 0xffffffff : 0x811c9dc5),
+        [&](IRBuilder<> &LB, Value *hash, Value *byte) -> Value * {
+            if (!crc) return fnv1aStep(LB, hash, byte);
+            if (x86)
+                return LB.CreateCall(
+                    Intrinsic::getDeclaration(&M, Intrinsic::x86_sse42_crc32_32_8),
+                    {hash, byte});
+            return LB.CreateCall(
+                Intrinsic::getDeclaration(&M, Intrinsic::aarch64_crc32cb),
+                {hash, LB.CreateZExt(byte, i32Ty)});
+        });
+    IRBuilder<> byteEndBuilder(byteEnd);
+    byteEndBuilder.CreateBr(done);
+
+    IRBuilder<> doneBuilder(done);
+    PHINode *hash = doneBuilder.CreatePHI(i32Ty, 2, "hash.result");
+    hash->addIncoming(wordHash, wordEnd);
+    hash->addIncoming(byteHash, byteEnd);
+
+    // CRC32C's final inversion
+    Value *result = crc ? doneBuilder.CreateNot(hash) : hash;
+    return { result, done };
+}
+
+// Create a background thread routine named `name`:
+//   ptr name(ptr)   (i32 on Windows, as a thread start routine)
+// Its entry block lowers the thread's priority and, outside Windows,
+// allocates the timespec createSleep fills in as `sleepSpec`. Returns the
+// entry block, left unterminated.
+static BasicBlock *createThreadRoutine(
+    Module &M,
+    const Triple &targetTriple,
+    StringRef name,
+    Function *&fn,
+    Value *&sleepSpec)
+{
+    LLVMContext &ctx = M.getContext();
+    IRBuilder<> B(ctx);
+    Type *ptrTy = B.getPtrTy();
+    Type *intPtrTy = M.getDataLayout().getIntPtrType(ctx);
+    bool windows = targetTriple.isOSWindows();
+
+    FunctionType *fnTy = FunctionType::get(windows ? B.getInt32Ty() : ptrTy, {ptrTy}, false);
+    fn = Function::Create(fnTy, GlobalValue::InternalLinkage, name, &M);
+    if (windows && targetTriple.getArch() == Triple::x86)
+        fn->setCallingConv(CallingConv::X86_StdCall);
+
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", fn);
+    B.SetInsertPoint(entry);
+    sleepSpec = nullptr;
+    if (windows) {
+        // Background priority for this thread: THREAD_PRIORITY_LOWEST
+        FunctionCallee currentThread = M.getOrInsertFunction(
+            "GetCurrentThread", FunctionType::get(ptrTy, false));
+        FunctionCallee setPriority = M.getOrInsertFunction(
+            "SetThreadPriority", FunctionType::get(B.getInt32Ty(), {ptrTy, B.getInt32Ty()}, false));
+        B.CreateCall(setPriority, {B.CreateCall(currentThread), B.getInt32(-2)});
+    } else {
+        // struct timespec { time_t tv_sec; long tv_nsec; }
+        sleepSpec = B.CreateAlloca(ArrayType::get(intPtrTy, 2), nullptr, "watchdog.period");
+        // On Linux, setpriority(PRIO_PROCESS, 0, 19) renices the calling thread only.
+        if (targetTriple.isOSLinux()) {
+            FunctionCallee setPriority = M.getOrInsertFunction(
+                "setpriority",
+                FunctionType::get(B.getInt32Ty(), {B.getInt32Ty(), B.getInt32Ty(), B.getInt32Ty()}, false));
+            B.CreateCall(setPriority, {B.getInt32(0), B.getInt32(0), B.getInt32(19)});
+        }
+    }
+    return entry;
+}
+
+// Sleep for `period` (an i64 number of milliseconds) at the builder's
+// insert point
+static void createSleep(
+    Module &M,
+    IRBuilder<> &B,
+    const Triple &targetTriple,
+    Value *period,
+    Value *sleepSpec)
+{
+    Type *ptrTy = B.getPtrTy();
+    if (targetTriple.isOSWindows()) {
+        FunctionCallee sleep = M.getOrInsertFunction(
+            "Sleep", FunctionType::get(B.getVoidTy(), {B.getInt32Ty()}, false));
+        B.CreateCall(sleep, {B.CreateTrunc(period, B.getInt32Ty())});
+    } else {
+        Type *intPtrTy = M.getDataLayout().getIntPtrType(M.getContext());
+        B.CreateStore(B.CreateZExtOrTrunc(B.CreateUDiv(period, B.getInt64(1000)), intPtrTy), sleepSpec);
+        B.CreateStore(
+            B.CreateZExtOrTrunc(B.CreateMul(B.CreateURem(period, B.getInt64(1000)), B.getInt64(1000000)), intPtrTy),
+            B.CreateConstGEP1_32(intPtrTy, sleepSpec, 1));
+        FunctionCallee nanosleep = M.getOrInsertFunction(
+            "nanosleep", FunctionType::get(B.getInt32Ty(), {ptrTy, ptrTy}, false));
+        B.CreateCall(nanosleep, {sleepSpec, ConstantPointerNull::get(cast<PointerType>(ptrTy))});
+    }
+}
+
+// Start `routine` as a detached thread at the builder's insert point
+static void startWatchdog(
+    Module &M,
+    IRBuilder<> &B,
+    const Triple &targetTriple,
+    Function *routine)
+{
+    Type *ptrTy = B.getPtrTy();
+    Type *intPtrTy = M.getDataLayout().getIntPtrType(M.getContext());
+    Constant *null = ConstantPointerNull::get(cast<PointerType>(ptrTy));
+    if (targetTriple.isOSWindows()) {
+        // CloseHandle(CreateThread(NULL, 0, routine, NULL, 0, NULL))
+        FunctionCallee createThread = M.getOrInsertFunction(
+            "CreateThread",
+            FunctionType::get(ptrTy, {ptrTy, intPtrTy, ptrTy, ptrTy, B.getInt32Ty(), ptrTy}, false));
+        FunctionCallee closeHandle = M.getOrInsertFunction(
+            "CloseHandle", FunctionType::get(B.getInt32Ty(), {ptrTy}, false));
+        Value *thread = B.CreateCall(
+            createThread,
+            {null, ConstantInt::get(intPtrTy, 0), routine, null, B.getInt32(0), null});
+        B.CreateCall(closeHandle, {thread});
+        return;
+    }
+
+    // pthread_create(&tid, NULL, routine, NULL); pthread_detach(tid)
+    Function *parent = B.GetInsertBlock()->getParent();
+    IRBuilder<> allocaBuilder(&*parent->getEntryBlock().getFirstInsertionPt());
+    Value *tid = allocaBuilder.CreateAlloca(intPtrTy, nullptr, "watchdog.tid");
+    FunctionCallee create = M.getOrInsertFunction(
+        "pthread_create",
+        FunctionType::get(B.getInt32Ty(), {ptrTy, ptrTy, ptrTy, ptrTy}, false));
+    FunctionCallee detach = M.getOrInsertFunction(
+        "pthread_detach", FunctionType::get(B.getInt32Ty(), {intPtrTy}, false));
+    B.CreateCall(create, {tid, null, routine, null});
+    B.CreateCall(detach, {B.CreateLoad(intPtrTy, tid)});
+}
+
+// Give an object every module of an image shares linkonce_odr linkage,
+// hidden visibility and, where the object format has them, its own COMDAT,
+// so the linker keeps a single copy per executable or shared library.
+static void shareWithinImage(GlobalObject *GO, const Triple &targetTriple)
+{
+    GO->setLinkage(GlobalValue::LinkOnceODRLinkage);
+    GO->setVisibility(GlobalValue::HiddenVisibility);
+    if (targetTriple.supportsCOMDAT())
+        GO->setComdat(GO->getParent()->getOrInsertComdat(GO->getName()));
+}
+
+// Get or create the background thread `name` that all modules of an image
+// share, and return its registration function:
+//   void <name>_register(ptr record, i64 period)
+// A module registers a { ptr next, ptr round } record once, from its
+// constructor: the record is pushed onto <name>_list, the shared period is
+// lowered to `period` milliseconds, and the first registration in the image
+// starts the thread. Each time the thread wakes up it calls every registered
+// module's `void round()`, so a process runs one such thread per image
+// however many modules were protected.
+static Function *getOrCreateSharedThread(
+    Module &M,
+    const Triple &targetTriple,
+    StringRef name)
+{
+    std::string registerName = (name + "_register").str();
+    if (Function *existing = M.getFunction(registerName))
+        return existing;
+
+    LLVMContext &ctx = M.getContext();
+    IRBuilder<> B(ctx);
+    Type *ptrTy = B.getPtrTy();
+    Type *i32Ty = B.getInt32Ty();
+    Type *i64Ty = B.getInt64Ty();
+    StructType *recordTy = StructType::get(ptrTy, ptrTy);
+
+    auto createShared = [&](Type *ty, Constant *init, StringRef suffix) {
+        auto *GV = new GlobalVariable(M, ty, false, GlobalValue::LinkOnceODRLinkage, init, name + suffix);
+        shareWithinImage(GV, targetTriple);
+        return GV;
+    };
+    GlobalVariable *list = createShared(
+        ptrTy, ConstantPointerNull::get(cast<PointerType>(ptrTy)), "_list");
+    GlobalVariable *periodVar = createShared(i64Ty, ConstantInt::get(i64Ty, UINT64_MAX), "_period");
+    GlobalVariable *started = createShared(i32Ty, ConstantInt::get(i32Ty, 0), "_started");
+
+    // Thread: sleep, then run every registered module's round
+    Function *thread = nullptr;
+    Value *sleepSpec = nullptr;
+    BasicBlock *entry = createThreadRoutine(M, targetTriple, name, thread, sleepSpec);
+    shareWithinImage(thread, targetTriple);
+    BasicBlock *wake = BasicBlock::Create(ctx, "thread.wake", thread);
+    BasicBlock *walk = BasicBlock::Create(ctx, "thread.walk", thread);
+    BasicBlock *visit = BasicBlock::Create(ctx, "thread.visit", thread);
+
+    B.SetInsertPoint(entry);
+    B.CreateBr(wake);
+
+    B.SetInsertPoint(wake);
+    LoadInst *period = B.CreateAlignedLoad(i64Ty, periodVar, Align(8));
+    period->setAtomic(AtomicOrdering::Monotonic);
+    createSleep(M, B, targetTriple, period, sleepSpec);
+    LoadInst *head = B.CreateAlignedLoad(ptrTy, list, M.getDataLayout().getPointerABIAlignment(0));
+    head->setAtomic(AtomicOrdering::Acquire);
+    B.CreateBr(walk);
+
+    B.SetInsertPoint(walk);
+    PHINode *record = B.CreatePHI(ptrTy, 2, "thread.record");
+    record->addIncoming(head, wake);
+    B.CreateCondBr(B.CreateIsNull(record), wake, visit);
+
+    B.SetInsertPoint(visit);
+    Value *round = B.CreateLoad(ptrTy, B.CreateStructGEP(recordTy, record, 1));
+    B.CreateCall(FunctionType::get(B.getVoidTy(), false), round);
+    Value *next = B.CreateLoad(ptrTy, B.CreateStructGEP(recordTy, record, 0));
+    record->addIncoming(next, visit);
+    B.CreateBr(walk);
+
+    // Registration
+    Function *reg = Function::Create(
+        FunctionType::get(B.getVoidTy(), {ptrTy, i64Ty}, false),
+        GlobalValue::LinkOnceODRLinkage,
+        registerName,
+        &M);
+    shareWithinImage(reg, targetTriple);
+    BasicBlock *regEntry = BasicBlock::Create(ctx, "entry", reg);
+    BasicBlock *push = BasicBlock::Create(ctx, "register.push", reg);
+    BasicBlock *pushed = BasicBlock::Create(ctx, "register.pushed", reg);
+    BasicBlock *launch = BasicBlock::Create(ctx, "register.start", reg);
+    BasicBlock *exit = BasicBlock::Create(ctx, "register.exit", reg);
+    Value *newRecord = reg->getArg(0);
+
+    B.SetInsertPoint(regEntry);
+    B.CreateAtomicRMW(AtomicRMWInst::UMin, periodVar, reg->getArg(1), MaybeAlign(8), AtomicOrdering::Monotonic);
+    B.CreateBr(push);
+
+    // Publish the record with release ordering, so the thread sees its
+    // fields once it finds it on the list
+    B.SetInsertPoint(push);
+    LoadInst *oldHead = B.CreateAlignedLoad(ptrTy, list, M.getDataLayout().getPointerABIAlignment(0));
+    oldHead->setAtomic(AtomicOrdering::Monotonic);
+    B.CreateStore(oldHead, B.CreateStructGEP(recordTy, newRecord, 0));
+    Value *swapped = B.CreateAtomicCmpXchg(
+        list, oldHead, newRecord, MaybeAlign(), AtomicOrdering::Release, AtomicOrdering::Monotonic);
+    B.CreateCondBr(B.CreateExtractValue(swapped, 1), pushed, push);
+
+    B.SetInsertPoint(pushed);
+    Value *wasStarted = B.CreateAtomicRMW(
+        AtomicRMWInst::Xchg, started, B.getInt32(1), MaybeAlign(4), AtomicOrdering::Monotonic);
+    B.CreateCondBr(B.CreateICmpEQ(wasStarted, B.getInt32(0)), launch, exit);
+
+    B.SetInsertPoint(launch);
+    startWatchdog(M, B, targetTriple, thread);
+    B.CreateBr(exit);
+
+    B.SetInsertPoint(exit);
+    B.CreateRetVoid();
+    return reg;
+}
+
+// Build this module's watchdog round:
+//   void obf.tamper_watchdog_round()
+// It verifies the next `budget` functions from obf.tamper_targets against
+// their baselines, continuing where the previous round stopped, and traps on
+// the first mismatch. `hashLengths` is empty for the fixed 64-byte window, or
+// holds each baseline's length field. Returns the module's record for the
+// shared obf.tamper_watchdog thread (see getOrCreateSharedThread).
+static GlobalVariable *createWatchdogRound(
+    Module &M,
+    const std::vector<Function *> &targets,
+    const std::vector<Constant *> &expectedHashes,
+    const std::vector<Constant *> &hashLengths,
+    TamperHash kernel)
+{
+    LLVMContext &ctx = M.getContext();
+    IRBuilder<> B(ctx);
+    Type *ptrTy = B.getPtrTy();
+
+    // Runtime-indexable copies of the target and baseline lists
+    std::vector<Constant *> funcs(targets.begin(), targets.end());
+    ArrayType *tableTy = ArrayType::get(ptrTy, targets.size());
+    GlobalVariable *funcTable = new GlobalVariable(
+        M,
+        tableTy,
+        true,
+        GlobalValue::PrivateLinkage,
+        ConstantArray::get(tableTy, funcs),
+        "obf.tamper_targets");
+    GlobalVariable *hashTable = new GlobalVariable(
+        M,
+        tableTy,
+        true,
+        GlobalValue::PrivateLinkage,
+        ConstantArray::get(tableTy, expectedHashes),
+        "obf.tamper_baselines");
+    GlobalVariable *lengthTable = nullptr;
+    if (!hashLengths.empty())
+        lengthTable = new GlobalVariable(
+            M,
+            tableTy,
+            true,
+            GlobalValue::PrivateLinkage,
+            ConstantArray::get(tableTy, hashLengths),
+            "obf.tamper_lengths");
+    // Only the shared thread runs the round, so the cursor needs no atomics
+    GlobalVariable *cursorVar = new GlobalVariable(
+        M,
+        B.getInt32Ty(),
+        false,
+        GlobalValue::PrivateLinkage,
+        B.getInt32(0),
+        "obf.tamper_watchdog_cursor");
+
+    uint64_t count = targets.size();
+    uint64_t budget = getWatchdogBudget();
+    if (budget == 0 || budget > count) budget = count;
+
+    Function *fn = Function::Create(
+        FunctionType::get(B.getVoidTy(), false),
+        GlobalValue::InternalLinkage,
+        "obf.tamper_watchdog_round",
+        &M);
+    fn->addFnAttr(Attribute::NoInline);
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", fn);
+    BasicBlock *sweep = BasicBlock::Create(ctx, "watchdog.sweep", fn);
+
+    B.SetInsertPoint(entry);
+    Value *cursor = B.CreateLoad(B.getInt32Ty(), cursorVar, "watchdog.cursor");
+    B.CreateBr(sweep);
+
+    // Verify one function per iteration, `budget` iterations per round
+    B.SetInsertPoint(sweep);
+    PHINode *done = B.CreatePHI(B.getInt32Ty(), 2, "watchdog.done");
+    done->addIncoming(B.getInt32(0), entry);
+    PHINode *idx = B.CreatePHI(B.getInt32Ty(), 2, "watchdog.idx");
+    idx->addIncoming(cursor, entry);
+    Value *target = B.CreateLoad(
+        ptrTy,
+        B.CreateInBoundsGEP(tableTy, funcTable, {B.getInt32(0), idx}));
+    Value *expectedPtr = B.CreateLoad(
+        ptrTy,
+        B.CreateInBoundsGEP(tableTy, hashTable, {B.getInt32(0), idx}));
+
+    Value *length = B.getInt32(64);
+    if (lengthTable)
+        length = B.CreateLoad(
+            B.getInt32Ty(),
+            B.CreateLoad(ptrTy, B.CreateInBoundsGEP(tableTy, lengthTable, {B.getInt32(0), idx})),
+            true);
+
+    auto [hash, hashEnd] = createHashLoop(ctx, B, fn, target, length, sweep, kernel);
+
+    BasicBlock *verified = BasicBlock::Create(ctx, "watchdog.verified", fn);
+    BasicBlock *exit = BasicBlock::Create(ctx, "watchdog.exit", fn);
+    BasicBlock *trapBlock = BasicBlock::Create(ctx, "tamper.trap", fn);
+
+    IRBuilder<> checkBuilder(hashEnd);
+    Value *expected = checkBuilder.CreateLoad(B.getInt32Ty(), expectedPtr, true);
+    checkBuilder.CreateCondBr(checkBuilder.CreateICmpEQ(hash, expected), verified, trapBlock);
+
+    IRBuilder<> trapBuilder(trapBlock);
+    trapBuilder.CreateCall(Intrinsic::getDeclaration(&M, Intrinsic::trap));
+    trapBuilder.CreateUnreachable();
+
+    B.SetInsertPoint(verified);
+    Value *nextIdx = B.CreateAdd(idx, B.getInt32(1));
+    nextIdx = B.CreateSelect(
+        B.CreateICmpEQ(nextIdx, B.getInt32(static_cast<uint32_t>(count))),
+        B.getInt32(0),
+        nextIdx);
+    Value *nextDone = B.CreateAdd(done, B.getInt32(1));
+    done->addIncoming(nextDone, verified);
+    idx->addIncoming(nextIdx, verified);
+    B.CreateCondBr(
+        B.CreateICmpULT(nextDone, B.getInt32(static_cast<uint32_t>(budget))),
+        sweep,
+        exit);
+
+    B.SetInsertPoint(exit);
+    B.CreateStore(nextIdx, cursorVar);
+    B.CreateRetVoid();
+
+    StructType *recordTy = StructType::get(ptrTy, ptrTy);
+    return new GlobalVariable(
+        M,
+        recordTy,
+        false,
+        GlobalValue::PrivateLinkage,
+        ConstantStruct::get(recordTy, {ConstantPointerNull::get(cast<PointerType>(ptrTy)), fn}),
+        "obf.tamper_watchdog_record");
+}
+
+// Page mode. The constructor allocates one block of
+//   i32 hashes[n]; i8 verified[n]; i8 lead[n]
+// for the n 4 KiB pages of the image's executable segment that holds the
+// targets, found with dl_iterate_phdr on ELF targets, hashes every page, and
+// keeps a root hash over hashes[]. lead[i] marks the pages where a target
+// starts; the pages after one, up to the next lead page, hold the rest of its
+// functions and are verified along with it, and the lowest target also owns
+// the pages before it. Each checked function has its own verified flag in
+// obf.tamper_page_flags, so its entry check is a single load of a fixed
+// address; a clear flag calls obf.tamper_verify_page, which re-hashes the
+// function's pages not yet verified this epoch and sets the flag again. Once
+// per epoch the obf.tamper_epoch thread, shared by every page-mode module of
+// the image, runs each module's obf.tamper_epoch_round, which verifies
+// hashes[] against the root, then clears every flag. Elsewhere the segment is
+// unknown, so the pages run from the lowest target to the first 64 bytes of
+// the highest.
+static void protectPages(
+    Module &M,
+    const Triple &targetTriple,
+    const std::vector<Function *> &targets,
+    const std::vector<Function *> &checked,
+    TamperHash kernel)
+{
+    LLVMContext &ctx = M.getContext();
+    IRBuilder<> B(ctx);
+    Type *ptrTy = B.getPtrTy();
+    Type *i8Ty = B.getInt8Ty();
+    Type *i32Ty = B.getInt32Ty();
+    Type *intPtrTy = M.getDataLayout().getIntPtrType(ctx);
+    Constant *null = ConstantPointerNull::get(cast<PointerType>(ptrTy));
+    const uint64_t pageSize = 4096;
+    Function *trap = Intrinsic::getDeclaration(&M, Intrinsic::trap);
+
+    auto createGlobal = [&](Type *ty, Constant *init, const Twine &name) {
+        return new GlobalVariable(M, ty, false, GlobalValue::PrivateLinkage, init, name);
+    };
+    GlobalVariable *baseVar = createGlobal(ptrTy, null, "obf.tamper_page_base");
+    GlobalVariable *countVar = createGlobal(i32Ty, B.getInt32(0), "obf.tamper_page_count");
+    GlobalVariable *firstVar = createGlobal(i32Ty, B.getInt32(0), "obf.tamper_page_first");
+    GlobalVariable *hashesVar = createGlobal(ptrTy, null, "obf.tamper_page_hashes");
+    GlobalVariable *verifiedVar = createGlobal(ptrTy, null, "obf.tamper_page_verified");
+    GlobalVariable *leadVar = createGlobal(ptrTy, null, "obf.tamper_page_lead");
+    GlobalVariable *rootVar = createGlobal(i32Ty, B.getInt32(0), "obf.tamper_page_root");
+    // One flag per checked function. Checks that run before the constructor,
+    // from earlier constructors, find their flag set.
+    ArrayType *flagsTy = ArrayType::get(i8Ty, checked.size());
+    std::vector<uint8_t> flagsInit(checked.size(), 1);
+    GlobalVariable *flagsVar = createGlobal(
+        flagsTy, ConstantDataArray::get(ctx, flagsInit), "obf.tamper_page_flags");
+
+    auto createTrapBlock = [&](Function *fn) {
+        BasicBlock *trapBlock = BasicBlock::Create(ctx, "tamper.trap", fn);
+        IRBuilder<> trapBuilder(trapBlock);
+        trapBuilder.CreateCall(trap);
+        trapBuilder.CreateUnreachable();
+        return trapBlock;
+    };
+    auto pageAddress = [&](IRBuilder<> &PB, Value *base, Value *idx) {
+        return PB.CreateInBoundsGEP(
+            i8Ty, base, PB.CreateShl(PB.CreateZExt(idx, intPtrTy), 12), "page.addr");
+    };
+
+    // ===============================
+    // void obf.tamper_verify_page(ptr flag, ptr fn): verify the pages fn
+    // owns, from its page up to the next lead page, re-hashing those not yet
+    // verified this epoch, then set its flag
+    // ===============================
+    Function *verify = Function::Create(
+        FunctionType::get(B.getVoidTy(), {ptrTy, ptrTy}, false),
+        GlobalValue::InternalLinkage,
+        "obf.tamper_verify_page",
+        &M);
+    verify->addFnAttr(Attribute::NoInline);
+    {
+        BasicBlock *entry = BasicBlock::Create(ctx, "entry", verify);
+        BasicBlock *pageVisit = BasicBlock::Create(ctx, "page.visit", verify);
+        BasicBlock *pageHash = BasicBlock::Create(ctx, "page.hash", verify);
+        BasicBlock *pageOk = BasicBlock::Create(ctx, "page.ok", verify);
+        BasicBlock *pageLead = BasicBlock::Create(ctx, "page.lead", verify);
+        BasicBlock *exit = BasicBlock::Create(ctx, "page.exit", verify);
+        BasicBlock *trapBlock = createTrapBlock(verify);
+
+        IRBuilder<> EB(entry);
+        Value *base = EB.CreateLoad(ptrTy, baseVar);
+        Value *count = EB.CreateLoad(i32Ty, countVar);
+        Value *hashes = EB.CreateLoad(ptrTy, hashesVar);
+        Value *verified = EB.CreateLoad(ptrTy, verifiedVar);
+        Value *lead = EB.CreateLoad(ptrTy, leadVar);
+        Value *own = EB.CreateTrunc(
+            EB.CreateLShr(
+                EB.CreateSub(
+                    EB.CreatePtrToInt(verify->getArg(1), intPtrTy),
+                    EB.CreatePtrToInt(base, intPtrTy)),
+                12),
+            i32Ty,
+            "page.own");
+        Value *start = EB.CreateSelect(
+            EB.CreateICmpEQ(own, EB.CreateLoad(i32Ty, firstVar)), EB.getInt32(0), own);
+        EB.CreateBr(pageVisit);
+
+        IRBuilder<> VB(pageVisit);
+        PHINode *idx = VB.CreatePHI(i32Ty, 2, "page.idx");
+        idx->addIncoming(start, entry);
+        Value *flag = VB.CreateInBoundsGEP(i8Ty, verified, idx);
+        Value *done = VB.CreateICmpNE(VB.CreateLoad(i8Ty, flag, true), VB.getInt8(0));
+        VB.CreateCondBr(done, pageOk, pageHash);
+
+        IRBuilder<> HB(pageHash);
+        Value *page = pageAddress(HB, base, idx);
+        auto [hash, hashEnd] =
+            createHashLoop(ctx, B, verify, page, B.getInt32(pageSize), pageHash, kernel);
+
+        IRBuilder<> CB(hashEnd);
+        Value *expected = CB.CreateLoad(i32Ty, CB.CreateInBoundsGEP(i32Ty, hashes, idx), true);
+        CB.CreateCondBr(CB.CreateICmpEQ(hash, expected), pageOk, trapBlock);
+
+        IRBuilder<> OB(pageOk);
+        OB.CreateStore(OB.getInt8(1), flag, true);
+        Value *next = OB.CreateAdd(idx, OB.getInt32(1));
+        OB.CreateCondBr(OB.CreateICmpULT(next, count), pageLead, exit);
+
+        // The lowest target's run passes its own lead page
+        IRBuilder<> LB(pageLead);
+        Value *isLead = LB.CreateICmpNE(
+            LB.CreateLoad(i8Ty, LB.CreateInBoundsGEP(i8Ty, lead, next)), LB.getInt8(0));
+        LB.CreateCondBr(LB.CreateAnd(isLead, LB.CreateICmpUGT(next, own)), exit, pageVisit);
+        idx->addIncoming(next, pageLead);
+
+        IRBuilder<> XB(exit);
+        XB.CreateStore(XB.getInt8(1), verify->getArg(0), true);
+        XB.CreateRetVoid();
+    }
+
+    // ===============================
+    // Epoch round, run by the image's shared obf.tamper_epoch thread:
+    // check the page hashes against the root, then expire every page and
+    // every function flag
+    // ===============================
+    uint64_t epoch = getTamperEpoch();
+    Function *expireRound = Function::Create(
+        FunctionType::get(B.getVoidTy(), false),
+        GlobalValue::InternalLinkage,
+        "obf.tamper_epoch_round",
+        &M);
+    expireRound->addFnAttr(Attribute::NoInline);
+    {
+        BasicBlock *entry = BasicBlock::Create(ctx, "entry", expireRound);
+        BasicBlock *expire = BasicBlock::Create(ctx, "epoch.expire", expireRound);
+        BasicBlock *trapBlock = createTrapBlock(expireRound);
+
+        IRBuilder<> EB(entry);
+        Value *count = EB.CreateLoad(i32Ty, countVar);
+        Value *hashes = EB.CreateLoad(ptrTy, hashesVar);
+        auto [root, rootEnd] = createHashLoop(
+            ctx, B, expireRound, hashes, EB.CreateShl(count, 2), entry, kernel);
+
+        IRBuilder<> CB(rootEnd);
+        Value *expected = CB.CreateLoad(i32Ty, rootVar, true);
+        CB.CreateCondBr(CB.CreateICmpEQ(root, expected), expire, trapBlock);
+
+        IRBuilder<> XB(expire);
+        XB.CreateMemSet(
+            XB.CreateLoad(ptrTy, verifiedVar),
+            XB.getInt8(0),
+            XB.CreateZExt(count, intPtrTy),
+            MaybeAlign(),
+            true);
+        XB.CreateMemSet(flagsVar, XB.getInt8(0), checked.size(), MaybeAlign(), true);
+        XB.CreateRetVoid();
+    }
+    StructType *recordTy = StructType::get(ptrTy, ptrTy);
+    GlobalVariable *record = createGlobal(
+        recordTy, ConstantStruct::get(recordTy, {null, expireRound}), "obf.tamper_epoch_record");
+    Function *registerRound = getOrCreateSharedThread(M, targetTriple, "obf.tamper_epoch");
+
+    // ===============================
+    // i32 obf.tamper_page_segment(ptr info, iN size, ptr range): the
+    // dl_iterate_phdr callback. range is { iN addr, iN lo, iN hi }; when the
+    // object has an executable PT_LOAD segment holding addr, widen [lo, hi]
+    // to it and stop the iteration.
+    // ===============================
+    Function *segment = nullptr;
+    StructType *rangeTy = StructType::get(intPtrTy, intPtrTy, intPtrTy);
+    if (targetTriple.isOSBinFormatELF()) {
+        segment = Function::Create(
+            FunctionType::get(i32Ty, {ptrTy, intPtrTy, ptrTy}, false),
+            GlobalValue::InternalLinkage,
+            "obf.tamper_page_segment",
+            &M);
+        BasicBlock *entry = BasicBlock::Create(ctx, "entry", segment);
+        BasicBlock *phdrLoop = BasicBlock::Create(ctx, "phdr.loop", segment);
+        BasicBlock *phdrNext = BasicBlock::Create(ctx, "phdr.next", segment);
+        BasicBlock *found = BasicBlock::Create(ctx, "phdr.found", segment);
+        BasicBlock *exit = BasicBlock::Create(ctx, "phdr.exit", segment);
+
+        // struct dl_phdr_info { addr; name; phdr; u16 phnum; ... } and the
+        // p_type, p_flags, p_vaddr and p_memsz offsets of ElfN_Phdr
+        bool is64 = intPtrTy->getIntegerBitWidth() == 64;
+        unsigned word = is64 ? 8 : 4;
+        unsigned phdrSize = is64 ? 56 : 32;
+        unsigned flagsOffset = is64 ? 4 : 24;
+        unsigned vaddrOffset = is64 ? 16 : 8;
+        unsigned memszOffset = is64 ? 40 : 20;
+
+        Value *info = segment->getArg(0);
+        Value *range = segment->getArg(2);
+        IRBuilder<> EB(entry);
+        Value *addr = EB.CreateLoad(intPtrTy, EB.CreateStructGEP(rangeTy, range, 0));
+        Value *loadBase = EB.CreateLoad(intPtrTy, info);
+        Value *phdrs = EB.CreateLoad(ptrTy, EB.CreateConstInBoundsGEP1_32(i8Ty, info, 2 * word));
+        Value *phnum = EB.CreateZExt(
+            EB.CreateLoad(B.getInt16Ty(), EB.CreateConstInBoundsGEP1_32(i8Ty, info, 3 * word)), i32Ty);
+        EB.CreateCondBr(EB.CreateICmpEQ(phnum, EB.getInt32(0)), exit, phdrLoop);
+
+        IRBuilder<> PB(phdrLoop);
+        PHINode *i = PB.CreatePHI(i32Ty, 2, "phdr.idx");
+        i->addIncoming(PB.getInt32(0), entry);
+        Value *phdr = PB.CreateInBoundsGEP(i8Ty, phdrs, PB.CreateMul(i, PB.getInt32(phdrSize)));
+        Value *type = PB.CreateLoad(i32Ty, phdr);
+        Value *flags = PB.CreateLoad(i32Ty, PB.CreateConstInBoundsGEP1_32(i8Ty, phdr, flagsOffset));
+        Value *lo = PB.CreateAdd(
+            loadBase, PB.CreateLoad(intPtrTy, PB.CreateConstInBoundsGEP1_32(i8Ty, phdr, vaddrOffset)));
+        Value *hi = PB.CreateAdd(
+            lo, PB.CreateLoad(intPtrTy, PB.CreateConstInBoundsGEP1_32(i8Ty, phdr, memszOffset)));
+        // PT_LOAD with PF_X, holding addr
+        Value *match = PB.CreateAnd(
+            PB.CreateAnd(
+                PB.CreateICmpEQ(type, PB.getInt32(1)),
+                PB.CreateICmpNE(PB.CreateAnd(flags, PB.getInt32(1)), PB.getInt32(0))),
+            PB.CreateAnd(PB.CreateICmpUGE(addr, lo), PB.CreateICmpULT(addr, hi)));
+        PB.CreateCondBr(match, found, phdrNext);
+
+        IRBuilder<> NB(phdrNext);
+        Value *next = NB.CreateAdd(i, NB.getInt32(1));
+        i->addIncoming(next, phdrNext);
+        NB.CreateCondBr(NB.CreateICmpULT(next, phnum), phdrLoop, exit);
+
+        IRBuilder<> FB(found);
+        Value *loPtr = FB.CreateStructGEP(rangeTy, range, 1);
+        Value *hiPtr = FB.CreateStructGEP(rangeTy, range, 2);
+        Value *oldLo = FB.CreateLoad(intPtrTy, loPtr);
+        Value *oldHi = FB.CreateLoad(intPtrTy, hiPtr);
+        Value *last = FB.CreateSub(hi, ConstantInt::get(intPtrTy, 1));
+        FB.CreateStore(FB.CreateSelect(FB.CreateICmpULT(lo, oldLo), lo, oldLo), loPtr);
+        FB.CreateStore(FB.CreateSelect(FB.CreateICmpUGT(last, oldHi), last, oldHi), hiPtr);
+        FB.CreateRet(FB.getInt32(1));
+
+        IRBuilder<> XB(exit);
+        XB.CreateRet(XB.getInt32(0));
+    }
+
+    // ===============================
+    // Constructor: lay out and hash the pages, arm the checks
+    // ===============================
+    Function *init = Function::Create(
+        FunctionType::get(B.getVoidTy(), false),
+        GlobalValue::InternalLinkage,
+        "obf.tamper_init",
+        &M);
+    {
+        BasicBlock *entry = BasicBlock::Create(ctx, "entry", init);
+        BasicBlock *allocated = BasicBlock::Create(ctx, "page.alloc", init);
+        BasicBlock *pageHash = BasicBlock::Create(ctx, "page.hash", init);
+        BasicBlock *rootHash = BasicBlock::Create(ctx, "page.root", init);
+        BasicBlock *trapBlock = createTrapBlock(init);
+
+        // [lo, hi] spans the targets up to the first 64 bytes of the highest,
+        // widened to the executable segment holding them where it is known
+        IRBuilder<> EB(entry);
+        Value *lowest = EB.CreatePtrToInt(targets[0], intPtrTy);
+        Value *hi = lowest;
+        for (size_t i = 1; i < targets.size(); ++i) {
+            Value *addr = EB.CreatePtrToInt(targets[i], intPtrTy);
+            lowest = EB.CreateSelect(EB.CreateICmpULT(addr, lowest), addr, lowest);
+            hi = EB.CreateSelect(EB.CreateICmpUGT(addr, hi), addr, hi);
+        }
+        Value *lo = lowest;
+        hi = EB.CreateAdd(hi, ConstantInt::get(intPtrTy, 63));
+        if (segment) {
+            Value *range = EB.CreateAlloca(rangeTy, nullptr, "page.range");
+            EB.CreateStore(lowest, EB.CreateStructGEP(rangeTy, range, 0));
+            EB.CreateStore(lo, EB.CreateStructGEP(rangeTy, range, 1));
+            EB.CreateStore(hi, EB.CreateStructGEP(rangeTy, range, 2));
+            FunctionCallee iterate = M.getOrInsertFunction(
+                "dl_iterate_phdr", FunctionType::get(i32Ty, {ptrTy, ptrTy}, false));
+            EB.CreateCall(iterate, {segment, range});
+            lo = EB.CreateLoad(intPtrTy, EB.CreateStructGEP(rangeTy, range, 1));
+            hi = EB.CreateLoad(intPtrTy, EB.CreateStructGEP(rangeTy, range, 2));
+        }
+        Constant *pageMask = ConstantInt::get(intPtrTy, ~(pageSize - 1));
+        lo = EB.CreateAnd(lo, pageMask, "page.lo");
+        hi = EB.CreateAnd(hi, pageMask, "page.hi");
+        Value *count = EB.CreateTrunc(
+            EB.CreateAdd(EB.CreateLShr(EB.CreateSub(hi, lo), 12), ConstantInt::get(intPtrTy, 1)),
+            i32Ty,
+            "page.count");
+        Value *countN = EB.CreateZExt(count, intPtrTy);
+
+        FunctionCallee calloc = M.getOrInsertFunction(
+            "calloc", FunctionType::get(ptrTy, {intPtrTy, intPtrTy}, false));
+        Value *block = EB.CreateCall(calloc, {countN, ConstantInt::get(intPtrTy, 6)});
+        EB.CreateCondBr(EB.CreateICmpEQ(block, null), trapBlock, allocated);
+
+        IRBuilder<> AB(allocated);
+        Value *base = AB.CreateIntToPtr(lo, ptrTy);
+        Value *verified = AB.CreateInBoundsGEP(i8Ty, block, AB.CreateShl(countN, 2));
+        Value *lead = AB.CreateInBoundsGEP(i8Ty, verified, countN);
+        AB.CreateStore(base, baseVar);
+        AB.CreateStore(count, countVar);
+        AB.CreateStore(block, hashesVar);
+        AB.CreateStore(verified, verifiedVar);
+        AB.CreateStore(lead, leadVar);
+        auto pageIndex = [&](Value *addr) {
+            return AB.CreateLShr(AB.CreateSub(addr, lo), 12);
+        };
+        AB.CreateStore(AB.CreateTrunc(pageIndex(lowest), i32Ty), firstVar);
+        for (Function *F : targets)
+            AB.CreateStore(
+                AB.getInt8(1),
+                AB.CreateInBoundsGEP(i8Ty, lead, pageIndex(AB.CreatePtrToInt(F, intPtrTy))));
+        AB.CreateBr(pageHash);
+
+        // Baseline of every page
+        IRBuilder<> HB(pageHash);
+        PHINode *idx = HB.CreatePHI(i32Ty, 2, "page.idx");
+        idx->addIncoming(HB.getInt32(0), allocated);
+        Value *page = pageAddress(HB, base, idx);
+        auto [hash, hashEnd] =
+            createHashLoop(ctx, B, init, page, B.getInt32(pageSize), pageHash, kernel);
+
+        IRBuilder<> SB(hashEnd);
+        SB.CreateStore(hash, SB.CreateInBoundsGEP(i32Ty, block, idx), true);
+        Value *next = SB.CreateAdd(idx, SB.getInt32(1));
+        idx->addIncoming(next, hashEnd);
+        SB.CreateCondBr(SB.CreateICmpULT(next, count), pageHash, rootHash);
+
+        // Root over the page hashes; every page starts out verified
+        IRBuilder<> TB(rootHash);
+        auto [root, rootEnd] = createHashLoop(
+            ctx, B, init, block, TB.CreateShl(count, 2), rootHash, kernel);
+        IRBuilder<> RB(rootEnd);
+        RB.CreateStore(root, rootVar, true);
+        RB.CreateMemSet(verified, RB.getInt8(1), countN, MaybeAlign(), true);
+        RB.CreateCall(registerRound, {record, RB.getInt64(epoch)});
+        RB.CreateRetVoid();
+    }
+    appendToGlobalCtors(M, init, 0);
+
+    // ===============================
+    // Entry checks: one flag load and compare on the fast path
+    // ===============================
+    MDNode *weights = MDBuilder(ctx).createBranchWeights(2000, 1);
+    for (size_t i = 0; i < checked.size(); ++i) {
+        Function *F = checked[i];
+        BasicBlock &entry = F->getEntryBlock();
+        BasicBlock *cont = entry.splitBasicBlock(&*entry.getFirstInsertionPt(), "tamper.cont");
+        entry.getTerminator()->eraseFromParent();
+        BasicBlock *verifyBlock = BasicBlock::Create(ctx, "tamper.verify", F);
+
+        IRBuilder<> CB(&entry);
+        Value *flag = CB.CreateConstInBoundsGEP2_32(flagsTy, flagsVar, 0, i);
+        Value *ok = CB.CreateICmpNE(CB.CreateLoad(i8Ty, flag, true), CB.getInt8(0));
+        CB.CreateCondBr(ok, cont, verifyBlock, weights);
+
+        IRBuilder<> VB(verifyBlock);
+        VB.CreateCall(verify, {flag, F});
+        VB.CreateBr(cont);
+    }
+}
+
+// Estimate how often each function runs per call of a module entry point
+// (an externally visible or address-taken function): every call site adds
+// its caller's estimate scaled by the call block's BlockFrequencyInfo
+// frequency relative to the caller's entry, propagated top-down over the
+// call graph. Calls within a recursive SCC are not propagated.
+static DenseMap<Function *, double> estimateCallFrequencies(
+    CallGraph &CG,
+    FunctionAnalysisManager &FAM)
+{
+    std::vector<std::vector<CallGraphNode *>> sccs;
+    for (auto it = scc_begin(&CG); !it.isAtEnd(); ++it)
+        sccs.push_back(*it);
+
+    DenseMap<Function *, double> freq;
+    for (auto scc = sccs.rbegin(); scc != sccs.rend(); ++scc) {
+        SmallPtrSet<Function *, 4> members;
+        for (CallGraphNode *node : *scc)
+            if (Function *F = node->getFunction())
+                members.insert(F);
+
+        for (CallGraphNode *node : *scc) {
+            Function *F = node->getFunction();
+            if (!F || F->isDeclaration()) continue;
+            if (!F->hasLocalLinkage() || F->hasAddressTaken())
+                freq[F] += 1.0;
+
+            BlockFrequencyInfo &BFI = FAM.getResult<BlockFrequencyAnalysis>(*F);
+            double entryFreq = static_cast<double>(BFI.getEntryFreq().getFrequency());
+            for (auto &record : *node) {
+                Function *callee = record.second->getFunction();
+                if (!record.first || !callee || callee->isDeclaration() || members.count(callee))
+                    continue;
+                Value *site = *record.first;
+                auto *CB = dyn_cast_or_null<CallBase>(site);
+                if (!CB) continue;
+                double blockFreq = static_cast<double>(BFI.getBlockFreq(CB->getParent()).getFrequency());
+                freq[callee] += freq[F] * blockFreq / entryFreq;
+            }
+        }
+    }
+    return freq;
+}
+
+// Selection outcome of one function
+struct TamperChoice {
+    Function *F;
+    const char *status;                 // "protected", "vouched" or "skipped"
+    std::string reason;
+    double calls;                       // per run: profile count or estimate
+    std::vector<Function *> vouchees;   // hot callees its check also verifies
+};
+
+// Append the selection to HIDEIR_TAMPER_REPORT, if set: one
+// "<status>\t<function>\t<instructions>\t<calls>\t<bytes per check>\t<cost>\t<reason>"
+// line per function under a "# <module>\tkernel <hash>\twindow <window>"
+// header naming the resolved hash kernel and the bytes hashed per function.
+// `calls` is the PGO entry count, or the static estimate per entry-point
+// call; `cost` is the bytes an entry-mode check hashes over those calls
+// (sampled mode divides it by the sample rate, watchdog mode moves it off the
+// calling threads). Both are "-" when the window is not known here: whole
+// functions sized by hideir-tamper-patch --full-length, which reports the
+// lengths it writes, or page mode, whose checks hash whole pages once per
+// epoch instead.
+static void writeTamperReport(
+    const Module &M,
+    const std::vector<TamperChoice> &choices,
+    TamperMode mode,
+    TamperHash kernel,
+    bool fullLength)
+{
+    const char *path = std::getenv("HIDEIR_TAMPER_REPORT");
+    if (!path || !*path || choices.empty()) return;
+
+    std::error_code EC;
+    raw_fd_ostream out(path, EC, sys::fs::OF_Append | sys::fs::OF_Text);
+    if (EC) return;
+    const char *window = mode == TamperMode::Page ? "pages" : fullLength ? "full" : "64";
+    out << "# " << M.getModuleIdentifier() << "\tkernel " << getTamperHashName(kernel)
+        << "\twindow " << window << "\n";
+    for (const TamperChoice &choice : choices) {
+        out << choice.status << "\t" << choice.F->getName() << "\t"
+            << choice.F->getInstructionCount() << "\t"
+            << format("%.1f", choice.calls) << "\t";
+        bool checked = StringRef(choice.status) == "protected";
+        if (!checked) {
+            out << "0\t0";
+        } else if (mode == TamperMode::Page || fullLength) {
+            out << "-\t-";
+        } else {
+            uint64_t bytes = 64 * (1 + choice.vouchees.size());
+            out << bytes << "\t" << format("%.0f", choice.calls * bytes);
+        }
+        out << "\t" << choice.reason << "\n";
+    }
+}
+
+// Decide which functions get a baseline and which of them check themselves
+// on entry, in module order.
+static std::vector<TamperChoice> selectTargets(
+    Module &M,
+    ModuleAnalysisManager &AM,
+    TamperMode mode,
+    bool postLink)
+{
+    TamperSelect select = getTamperSelect();
+    bool estimate = select == TamperSelect::Auto || std::getenv("HIDEIR_TAMPER_REPORT");
+
+    DenseMap<Function *, double> freq;
+    DenseMap<Function *, std::vector<Function *>> callers;
+    ProfileSummaryInfo *PSI = nullptr;
+    if (estimate) {
+        auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        CallGraph &CG = AM.getResult<CallGraphAnalysis>(M);
+        PSI = &AM.getResult<ProfileSummaryAnalysis>(M);
+        freq = estimateCallFrequencies(CG, FAM);
+        for (Function &F : M) {
+            if (F.isDeclaration()) continue;
+            for (auto &record : *CG[&F]) {
+                if (!record.first) continue;
+                if (Function *callee = record.second->getFunction())
+                    callers[callee].push_back(&F);
+            }
+        }
+    }
+
+    unsigned minSize = getTamperMinSize();
+    double hotRatio = getTamperHotRatio();
+    std::vector<TamperChoice> choices;
+    DenseMap<Function *, size_t> choiceIndex;
+    for (Function &F : M) {
+        if (F.empty() || F.getName().starts_with("obf.")) continue;
+
+        TamperChoice choice{&F, "protected", "all", freq.lookup(&F), {}};
+        bool profiled = PSI && PSI->hasProfileSummary() && F.getEntryCount();
+        if (profiled)
+            choice.calls = static_cast<double>(F.getEntryCount()->getCount());
+
+        // An interposable COMDAT/weak copy has no link-time address for
+        // the post-link table to refer to.
+        if (postLink && F.isWeakForLinker() && !F.isDSOLocal()) {
+            choice.status = "skipped";
+            choice.reason = "interposable copy";
+        } else if (select == TamperSelect::Auto) {
+            auto callSites = callers.find(&F);
+            size_t numCallers = callSites == callers.end() ? 0 : callSites->second.size();
+            choice.reason = "selected";
+            if (F.hasFnAttribute(Attribute::AlwaysInline)) {
+                choice.status = "skipped";
+                choice.reason = "always inlined";
+            } else if (F.hasLocalLinkage() && !F.hasAddressTaken() && numCallers == 1) {
+                choice.status = "skipped";
+                choice.reason = "single caller, inlined";
+            } else if (F.getInstructionCount() < minSize) {
+                choice.status = "skipped";
+                choice.reason = "too small";
+            } else if (mode != TamperMode::Watchdog && mode != TamperMode::Page &&
+                       (profiled ? PSI->isFunctionEntryHot(&F) : choice.calls >= hotRatio)) {
+                choice.status = "skipped";
+                choice.reason = "hot";
+            }
+        }
+        choiceIndex[&F] = choices.size();
+        choices.push_back(choice);
+    }
+
+    // A protected caller vouches for each skipped hot callee; the one run
+    // least often pays for it.
+    if (select == TamperSelect::Auto && getTamperVouch()) {
+        for (TamperChoice &choice : choices) {
+            if (choice.reason != "hot") continue;
+            TamperChoice *voucher = nullptr;
+            for (Function *caller : callers.lookup(choice.F)) {
+                auto idx = choiceIndex.find(caller);
+                if (idx == choiceIndex.end()) continue;
+                TamperChoice &candidate = choices[idx->second];
+                if (StringRef(candidate.status) != "protected") continue;
+                if (!voucher || candidate.calls < voucher->calls)
+                    voucher = &candidate;
+            }
+            if (!voucher) continue;
+            voucher->vouchees.push_back(choice.F);
+            choice.status = "vouched";
+            choice.reason = ("by " + voucher->F->getName()).str();
+        }
+    }
+    return choices;
+}
+
+PreservedAnalyses AntiTamperingPass::run(Module &M, ModuleAnalysisManager &AM) {
     bool modified = false;
     LLVMContext &ctx = M.getContext();
     IRBuilder<> builder(ctx);
 
-    // Collect functions
+    Triple targetTriple(M.getTargetTriple());
+    TamperMode mode = getTamperMode();
+    bool postLink = getPostLinkBaseline() && targetTriple.isOSBinFormatELF() &&
+                    mode != TamperMode::Page;
+
+    // Collect functions: every baseline target, and which of them check
+    // themselves (and the callees they vouch for) on entry
+    std::vector<TamperChoice> choices = selectTargets(M, AM, mode, postLink);
+
     std::vector<Function*> targets;
-    for (Function &F : M) {
-        if (!F.empty() && !F.getName().starts_with("obf.")) {
-            targets.push_back(&F);
-        }
+    std::vector<const TamperChoice *> targetChoices;
+    DenseMap<Function *, size_t> targetIndex;
+    for (const TamperChoice &choice : choices) {
+        if (StringRef(choice.status) == "skipped") continue;
+        targetIndex[choice.F] = targets.size();
+        targets.push_back(choice.F);
+        targetChoices.push_back(&choice);
     }
 
+    TamperHash kernel = resolveTamperHash(getTamperHash(), targetTriple, targets);
+    writeTamperReport(M, choices, mode, kernel, postLink && getTamperFullLength());
+
     if (targets.empty())
         return PreservedAnalyses::all();
 
     // ===============================
-    // Create a per-function expected hash global so each function's
-    // integrity is verified independently.
+    // Page mode: page tables and flag checks instead of per-function
+    // baselines
     // ===============================
-    std::vector<GlobalVariable *> expectedHashes;
-    for (size_t i = 0; i < targets.size(); ++i) {
-        GlobalVariable *gh = new GlobalVariable(
-            M,
-            builder.getInt32Ty(),
-            false,
-            GlobalValue::PrivateLinkage,
-            builder.getInt32(0),
-            "obf.expected_hash." + targets[i]->getName().str());
-        expectedHashes.push_back(gh);
+    if (mode == TamperMode::Page) {
+        std::vector<Function *> checked;
+        for (size_t i = 0; i < targets.size(); ++i)
+            if (StringRef(targetChoices[i]->status) == "protected")
+                checked.push_back(targets[i]);
+        protectPages(M, targetTriple, targets, checked, kernel);
+        return PreservedAnalyses::none();
     }
 
-    // ===============================
-    // Constructor: compute baseline hash for every target function
-    // ===============================
     FunctionType *initTy =
         FunctionType::get(Type::getVoidTy(ctx), false);
+    Function *initFunc = nullptr;
+    ReturnInst *initRet = nullptr;
 
-    Function *initFunc =
-        Function::Create(initTy,
-                         GlobalValue::InternalLinkage,
-                         "obf.tamper_init",
-                         &M);
+    // Baseline hash and, for post-link baselines, hash length of each target
+    std::vector<Constant *> expectedHashes;
+    std::vector<Constant *> hashLengths;
 
-    BasicBlock *currentBlock =
-        BasicBlock::Create(ctx, "entry", initFunc);
+    if (postLink) {
+        // ===============================
+        // Post-link baselines: the patcher writes them into the linked
+        // image, no constructor hashes anything.
+        // ===============================
+        std::tie(hashLengths, expectedHashes) = createBaselineTable(M, targets, kernel);
+    } else {
+        // ===============================
+        // Create a per-function expected hash global so each function's
+        // integrity is verified independently.
+        // ===============================
+        for (size_t i = 0; i < targets.size(); ++i) {
+            GlobalVariable *gh = new GlobalVariable(
+                M,
+                builder.getInt32Ty(),
+                false,
+                GlobalValue::PrivateLinkage,
+                builder.getInt32(0),
+                "obf.expected_hash." + targets[i]->getName().str());
+            expectedHashes.push_back(gh);
+        }
 
-    for (size_t i = 0; i < targets.size(); ++i) {
-        auto [initHash, initEnd] =
-            createHashLoop(ctx, builder, initFunc,
-                           targets[i], currentBlock);
+        // ===============================
+        // Constructor: compute baseline hash for every target function
+        // ===============================
+        initFunc =
+            Function::Create(initTy,
+                             GlobalValue::InternalLinkage,
+                             "obf.tamper_init",
+                             &M);
 
-        IRBuilder<> storeBuilder(initEnd);
-        storeBuilder.CreateStore(initHash, expectedHashes[i], true);
+        BasicBlock *currentBlock =
+            BasicBlock::Create(ctx, "entry", initFunc);
 
-        // Chain: each function's hash loop feeds into the next.
-        if (i + 1 < targets.size()) {
-            currentBlock = BasicBlock::Create(ctx, "init.next", initFunc);
-            storeBuilder.CreateBr(currentBlock);
-        } else {
-            storeBuilder.CreateRetVoid();
+        for (size_t i = 0; i < targets.size(); ++i) {
+            auto [initHash, initEnd] =
+                createHashLoop(ctx, builder, initFunc,
+                               targets[i], builder.getInt32(64), currentBlock, kernel);
+
+            IRBuilder<> storeBuilder(initEnd);
+            storeBuilder.CreateStore(initHash, expectedHashes[i], true);
+
+            // Chain: each function's hash loop feeds into the next.
+            if (i + 1 < targets.size()) {
+                currentBlock = BasicBlock::Create(ctx, "init.next", initFunc);
+                storeBuilder.CreateBr(currentBlock);
+            } else {
+                initRet = storeBuilder.CreateRetVoid();
+            }
         }
+
+        appendToGlobalCtors(M, initFunc, 0);
     }
 
-    appendToGlobalCtors(M, initFunc, 0);
+    // ===============================
+    // Watchdog mode: the constructor registers the module's round with the
+    // image's one background thread, which re-verifies the baselines; the
+    // functions themselves stay unchanged.
+    // ===============================
+    if (mode == TamperMode::Watchdog) {
+        if (!initFunc) {
+            initFunc =
+                Function::Create(initTy,
+                                 GlobalValue::InternalLinkage,
+                                 "obf.tamper_init",
+                                 &M);
+            IRBuilder<> retBuilder(BasicBlock::Create(ctx, "entry", initFunc));
+            initRet = retBuilder.CreateRetVoid();
+            appendToGlobalCtors(M, initFunc, 0);
+        }
+
+        GlobalVariable *record =
+            createWatchdogRound(M, targets, expectedHashes, hashLengths, kernel);
+        Function *registerRound = getOrCreateSharedThread(M, targetTriple, "obf.tamper_watchdog");
+
+        // The hash kernels add blocks after the one that returns, so register
+        // right before the constructor's ret rather than in its last block
+        IRBuilder<> startBuilder(initRet);
+        startBuilder.CreateCall(registerRound, {record, startBuilder.getInt64(getWatchdogPeriod())});
+        return PreservedAnalyses::none();
+    }
 
     // ===============================
     // Runtime checks: each function hashes *itself*
@@ -139,7 +1651,40 @@ PreservedAnalyses AntiTamperingPass::run(Module &M, ModuleAnalysisManager &) {
     Function *trap =
         Intrinsic::getDeclaration(&M, Intrinsic::trap);
 
+    // ===============================
+    // Sampled and window modes gate the check on a thread-local
+    // countdown or deadline; only an expired gate pays for the hash.
+    // ===============================
+    GlobalVariable *gate = nullptr;
+    Function *rearm = nullptr;
+    MDNode *gateWeights = nullptr;
+    if (mode != TamperMode::Entry) {
+        bool sampled = mode == TamperMode::Sampled;
+        uint64_t interval = sampled ? getTamperSampleRate() : getTamperWindow();
+        Type *gateTy = sampled ? builder.getInt32Ty() : builder.getInt64Ty();
+
+        // General-dynamic TLS, so the gate also works in shared libraries
+        // loaded with dlopen. The linker relaxes it to a single
+        // thread-pointer-relative access when it links an executable.
+        gate = new GlobalVariable(
+            M,
+            gateTy,
+            false,
+            GlobalValue::InternalLinkage,
+            ConstantInt::get(gateTy, 0),
+            sampled ? "obf.tamper_countdown" : "obf.tamper_deadline",
+            nullptr,
+            GlobalValue::GeneralDynamicTLSModel);
+        rearm = createRearmFunction(M, mode, gate, interval, getTamperJitter());
+        gateWeights = MDBuilder(ctx).createBranchWeights(
+            1, sampled ? static_cast<uint32_t>(interval) : 2000);
+    }
+
     for (size_t i = 0; i < targets.size(); ++i) {
+        // Vouched functions are verified by their voucher's check
+        if (StringRef(targetChoices[i]->status) != "protected")
+            continue;
+
         Function *F = targets[i];
         BasicBlock &entry = F->getEntryBlock();
         Instruction *insertPt = &*entry.getFirstInsertionPt();
@@ -151,30 +1696,78 @@ PreservedAnalyses AntiTamperingPass::run(Module &M, ModuleAnalysisManager &) {
         // Remove default branch
         entry.getTerminator()->eraseFromParent();
 
-        // Hash this function's own bytes at runtime
-        auto [runtimeHash, endBlock] =
-            createHashLoop(ctx, builder, F,
-                           F, &entry);
+        BasicBlock *hashStart = &entry;
+        if (gate) {
+            // Decrement the countdown, or read the cycle counter, and
+            // only fall into the check once the gate has expired.
+            IRBuilder<> gateBuilder(&entry);
+            Value *due = nullptr;
+            if (mode == TamperMode::Sampled) {
+                Value *left = gateBuilder.CreateSub(
+                    gateBuilder.CreateLoad(builder.getInt32Ty(), gate),
+                    builder.getInt32(1));
+                gateBuilder.CreateStore(left, gate);
+                due = gateBuilder.CreateICmpSLT(left, builder.getInt32(1));
+            } else {
+                Function *counter = Intrinsic::getDeclaration(&M, Intrinsic::readcyclecounter);
+                Value *now = gateBuilder.CreateCall(counter);
+                due = gateBuilder.CreateICmpUGE(
+                    now,
+                    gateBuilder.CreateLoad(builder.getInt64Ty(), gate));
+            }
 
-        IRBuilder<> checkBuilder(endBlock);
+            hashStart = BasicBlock::Create(ctx, "tamper.sample", F);
+            gateBuilder.CreateCondBr(due, hashStart, cont, gateWeights);
 
-        Value *stored =
-            checkBuilder.CreateLoad(
-                builder.getInt32Ty(),
-                expectedHashes[i],
-                true);
+            IRBuilder<> sampleBuilder(hashStart);
+            sampleBuilder.CreateCall(rearm);
+        }
 
-        Value *valid =
-            checkBuilder.CreateICmpEQ(runtimeHash, stored);
+        // Hash this function's own bytes at runtime, then those of each
+        // callee it vouches for, every one against its own baseline
+        std::vector<size_t> checked = {i};
+        for (Function *callee : targetChoices[i]->vouchees)
+            checked.push_back(targetIndex.lookup(callee));
 
-        BasicBlock *trapBlock =
-            BasicBlock::Create(ctx, "tamper.trap", F);
+        BasicBlock *trapBlock = nullptr;
+        for (size_t k = 0; k < checked.size(); ++k) {
+            size_t idx = checked[k];
+            Value *length = builder.getInt32(64);
+            if (!hashLengths.empty()) {
+                IRBuilder<> lengthBuilder(hashStart);
+                length = lengthBuilder.CreateLoad(
+                    builder.getInt32Ty(),
+                    hashLengths[idx],
+                    true);
+            }
 
-        IRBuilder<> trapBuilder(trapBlock);
-        trapBuilder.CreateCall(trap);
-        trapBuilder.CreateUnreachable();
+            auto [runtimeHash, endBlock] =
+                createHashLoop(ctx, builder, F,
+                               targets[idx], length, hashStart, kernel);
+
+            IRBuilder<> checkBuilder(endBlock);
 
-        checkBuilder.CreateCondBr(valid, cont, trapBlock);
+            Value *stored =
+                checkBuilder.CreateLoad(
+                    builder.getInt32Ty(),
+                    expectedHashes[idx],
+                    true);
+
+            Value *valid =
+                checkBuilder.CreateICmpEQ(runtimeHash, stored);
+
+            if (!trapBlock) {
+                trapBlock = BasicBlock::Create(ctx, "tamper.trap", F);
+                IRBuilder<> trapBuilder(trapBlock);
+                trapBuilder.CreateCall(trap);
+                trapBuilder.CreateUnreachable();
+            }
+
+            BasicBlock *next = cont;
+            if (k + 1 < checked.size())
+                next = hashStart = BasicBlock::Create(ctx, "tamper.vouch", F);
+            checkBuilder.CreateCondBr(valid, next, trapBlock);
+        }
 
         modified = true;
     }
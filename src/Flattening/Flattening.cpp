@@ -1,13 +1,26 @@
 #include "Flattening.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 #include "../Utils/Random.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <functional>
+#include <map>
 #include <vector>
 
 using namespace llvm;
@@ -22,6 +35,143 @@ static double getFlattenProbability() {
     return 1.0;
 }
 
+enum class DispatchKind { Indirect, Switch };
+
+// Read the dispatcher kind from HIDEIR_FLATTEN_DISPATCH. "indirect" (default)
+// stores BlockAddresses and jumps through indirectbr; "switch" gives every block
+// a dense integer state ID so the backend can lower the dispatcher to a jump table.
+static DispatchKind getDispatchKind() {
+    if (const char *env = std::getenv("HIDEIR_FLATTEN_DISPATCH")) {
+        if (StringRef(env) == "switch") return DispatchKind::Switch;
+    }
+    return DispatchKind::Indirect;
+}
+
+// Read HIDEIR_FLATTEN_REGISTER_STATE. When set, the dispatcher state is an SSA
+// value (PHIs in loop_end and dispatch_header) instead of a stack slot, and the
+// values demoted for flattening are promoted back to registers afterwards.
+static bool getRegisterState() {
+    if (const char *env = std::getenv("HIDEIR_FLATTEN_REGISTER_STATE")) {
+        return std::atoi(env) != 0;
+    }
+    return false;
+}
+
+// Upper bound on the PHI incoming values register-state mode may add when it
+// promotes demoted slots back to SSA (see step 5 of the pass). Slots beyond
+// the budget stay in memory, so promotion never grows quadratically with the
+// number of dispatcher edges.
+static constexpr size_t kPromotionPhiBudget = 1 << 20;
+
+// Read HIDEIR_FLATTEN_KEEP_HOT_LOOPS. When set, hot innermost loops are kept
+// intact and dispatched as a single super-node instead of per block.
+static bool getKeepHotLoops() {
+    if (const char *env = std::getenv("HIDEIR_FLATTEN_KEEP_HOT_LOOPS")) {
+        return std::atoi(env) != 0;
+    }
+    return false;
+}
+
+// Read HIDEIR_FLATTEN_HOT_LOOP_RATIO: how many times per function invocation a
+// loop header must execute (estimated by BlockFrequencyInfo) before the loop
+// counts as hot when no PGO profile is available. Defaults to 8.
+static double getHotLoopRatio() {
+    if (const char *env = std::getenv("HIDEIR_FLATTEN_HOT_LOOP_RATIO")) {
+        double val = std::atof(env);
+        if (val > 0.0) return val;
+    }
+    return 8.0;
+}
+
+// Read HIDEIR_FLATTEN_THREADED: the fraction (0.0 - 1.0) of flattened blocks,
+// hottest first, that get their own copy of the dispatcher instead of jumping
+// back to the shared one. Each copy is a separate indirect branch site with its
+// own prediction history, at the cost of one jump table or destination list per
+// copy. Defaults to 0.0 (a single shared dispatcher).
+static double getThreadedFraction() {
+    if (const char *env = std::getenv("HIDEIR_FLATTEN_THREADED")) {
+        double val = std::atof(env);
+        if (val >= 0.0 && val <= 1.0) return val;
+    }
+    return 0.0;
+}
+
+// Read HIDEIR_FLATTEN_FANOUT: the maximum number of successors of a single
+// dispatcher. Functions with more dispatch targets get a tree of dispatchers
+// over integer state IDs instead of one node with thousands of edges. 0
+// (default) keeps a single dispatcher; values below 2 are ignored.
+static unsigned getFlattenFanout() {
+    if (const char *env = std::getenv("HIDEIR_FLATTEN_FANOUT")) {
+        int val = std::atoi(env);
+        if (val >= 2) return static_cast<unsigned>(val);
+    }
+    return 0;
+}
+
+// Select the hot innermost loops that should stay out of the dispatcher and map
+// each of their blocks, plus the preheader, to that preheader. The preheader
+// becomes the only dispatcher target for the loop, so the loop body keeps its
+// direct edges and its header PHIs. Blocks absent from the map are their own region.
+static DenseMap<BasicBlock *, BasicBlock *> collectHotLoopRegions(Function &F, FunctionAnalysisManager &AM) {
+    DenseMap<BasicBlock *, BasicBlock *> regions;
+
+    auto &LI = AM.getResult<LoopAnalysis>(F);
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    auto &BFI = AM.getResult<BlockFrequencyAnalysis>(F);
+
+    // With -fprofile-instr-use the profile summary is already cached by the
+    // inliner; without a profile fall back to static frequency estimates.
+    auto &MAMProxy = AM.getResult<ModuleAnalysisManagerFunctionProxy>(F);
+    ProfileSummaryInfo *PSI = MAMProxy.getCachedResult<ProfileSummaryAnalysis>(*F.getParent());
+    bool useProfile = PSI && PSI->hasProfileSummary() && F.hasProfileData();
+
+    uint64_t entryFreq = BFI.getEntryFreq().getFrequency();
+    double ratio = getHotLoopRatio();
+
+    std::vector<Loop *> hotLoops;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+        if (!L->isInnermost()) continue;
+
+        // A dedicated preheader gives the super-node a single entry from the dispatcher.
+        if (!L->getLoopPreheader()) continue;
+
+        bool hot = useProfile
+            ? PSI->isHotBlock(L->getHeader(), &BFI)
+            : BFI.getBlockFreq(L->getHeader()).getFrequency() >= ratio * entryFreq;
+        if (!hot) continue;
+
+        // Demoting invoke results may split edges inside the loop, and exit edges
+        // out of indirectbr/callbr cannot be split; leave such loops flattened.
+        bool eligible = true;
+        for (BasicBlock *BB : L->blocks()) {
+            Instruction *term = BB->getTerminator();
+            if (BB->isEHPad() || isa<InvokeInst>(term) || isa<IndirectBrInst>(term) || isa<CallBrInst>(term)) {
+                eligible = false;
+                break;
+            }
+        }
+        if (eligible) hotLoops.push_back(L);
+    }
+
+    for (Loop *L : hotLoops) {
+        BasicBlock *preheader = L->getLoopPreheader();
+        regions[preheader] = preheader;
+        for (BasicBlock *BB : L->blocks()) regions[BB] = preheader;
+
+        // Give every exit edge its own block inside the region, so values that leave
+        // the loop are spilled once on exit rather than on every iteration.
+        SmallVector<std::pair<BasicBlock *, BasicBlock *>, 4> exitEdges;
+        L->getExitEdges(exitEdges);
+        for (auto &edge : exitEdges) {
+            BasicBlock *exitBB = SplitEdge(edge.first, edge.second, &DT, &LI, nullptr, "loop_exit");
+            regions[exitBB] = preheader;
+        }
+        formLCSSA(*L, DT, &LI, nullptr);
+    }
+
+    return regions;
+}
+
 PreservedAnalyses FlatteningPass::run(Function &F, FunctionAnalysisManager &AM) {
     if (F.empty() || F.hasFnAttribute(Attribute::OptimizeNone) || F.getName().contains("obf.")) {
         return PreservedAnalyses::all();
@@ -36,42 +186,64 @@ PreservedAnalyses FlatteningPass::run(Function &F, FunctionAnalysisManager &AM)
         }
     }
 
-    // 1. SSA Demotion: Required to prevent cross-block register uses in the flattened CFG.
+    // Blocks of preserved hot loops share a region headed by the loop preheader.
+    DenseMap<BasicBlock *, BasicBlock *> regions;
+    if (getKeepHotLoops()) regions = collectHotLoopRegions(F, AM);
+
+    // Threaded dispatch picks its blocks by estimated frequency. Query it before
+    // flattening rewrites the CFG; blocks created later report a zero frequency.
+    double threadedFraction = getThreadedFraction();
+    BlockFrequencyInfo *BFI = nullptr;
+    if (threadedFraction > 0.0) BFI = &AM.getResult<BlockFrequencyAnalysis>(F);
+
+    auto regionOf = [&regions](BasicBlock *BB) {
+        auto it = regions.find(BB);
+        return it == regions.end() ? BB : it->second;
+    };
+
+    // 1. SSA Demotion: Required to prevent cross-region register uses in the flattened CFG.
+    // A region is a single block unless it belongs to a preserved hot loop.
     
-    // Step A: Demote all PHIs to stack slots.
+    // Step A: Demote all PHIs to stack slots, except those inside a preserved
+    // loop whose predecessors all stay within the loop's region.
     std::vector<PHINode *> phis;
-    for (BasicBlock &BB : F) 
+    for (BasicBlock &BB : F) {
+        if (regionOf(&BB) != &BB) continue;
         for (Instruction &I : BB) 
             if (auto *phi = dyn_cast<PHINode>(&I)) 
                 phis.push_back(phi);
+    }
     
-    for (PHINode *P : phis) DemotePHIToStack(P);
-
-    // Step B: Iteratively demote any instruction that is used in a different block.
-    // This is crucial because DemotePHIToStack creates new LoadInsts that may 
-    // themselves have cross-block uses that break dominance after flattening.
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        std::vector<Instruction *> toDemote;
-        for (BasicBlock &BB : F) {
-            for (Instruction &I : BB) {
-                if (isa<AllocaInst>(&I)) continue;
-                for (User *U : I.users()) {
-                    if (auto *UI = dyn_cast<Instruction>(U)) {
-                        if (UI->getParent() != &BB) {
-                            toDemote.push_back(&I);
-                            break;
-                        }
-                    }
+    // Remember the stack slots created here so register-state mode can promote them again.
+    std::vector<AllocaInst *> demotedSlots;
+    for (PHINode *P : phis) demotedSlots.push_back(DemotePHIToStack(P));
+
+    // Step B: Demote every instruction that is used in a different region.
+    // One scan collects them after Step A, so the reloads DemotePHIToStack left
+    // behind are already included. DemoteRegToStack reloads a value in the block
+    // of each user (or at the end of the incoming block for a PHI), so nothing it
+    // creates is used across regions again and the worklist never has to be
+    // refilled. The cost is linear in the number of uses, which matters for
+    // machine-generated functions with tens of thousands of blocks.
+    std::vector<Instruction *> worklist;
+    for (BasicBlock &BB : F) {
+        BasicBlock *defRegion = regionOf(&BB);
+        for (Instruction &I : BB) {
+            if (isa<AllocaInst>(&I)) continue;
+            for (Use &U : I.uses()) {
+                auto *UI = dyn_cast<Instruction>(U.getUser());
+                if (!UI) continue;
+                // A PHI reads its operand at the end of the incoming block.
+                BasicBlock *useBB = UI->getParent();
+                if (auto *PN = dyn_cast<PHINode>(UI)) useBB = PN->getIncomingBlock(U);
+                if (regionOf(useBB) != defRegion) {
+                    worklist.push_back(&I);
+                    break;
                 }
             }
         }
-        if (!toDemote.empty()) {
-            for (Instruction *I : toDemote) DemoteRegToStack(*I);
-            changed = true;
-        }
     }
+    for (Instruction *I : worklist) demotedSlots.push_back(DemoteRegToStack(*I));
 
     // 2. Prepare the entry trampoline.
     // We must keep all AllocaInsts in the actual entry block to satisfy the Verifier.
@@ -86,47 +258,217 @@ PreservedAnalyses FlatteningPass::run(Function &F, FunctionAnalysisManager &AM)
         }
     }
 
+    // The entry block may have been the preheader of a preserved loop. Its region
+    // and the header PHIs now refer to the logic block that took over its body.
+    if (regions.count(entryBlock)) {
+        for (auto &entry : regions)
+            if (entry.second == entryBlock) entry.second = firstBlock;
+        regions.erase(entryBlock);
+        regions[firstBlock] = firstBlock;
+    }
+    for (BasicBlock *succ : successors(firstBlock))
+        succ->replacePhiUsesWith(entryBlock, firstBlock);
+
     // 3. Setup Dispatcher Structure.
+    DispatchKind kind = getDispatchKind();
     BasicBlock *loopEntry = BasicBlock::Create(F.getContext(), "dispatch_header", &F);
     BasicBlock *loopEnd = BasicBlock::Create(F.getContext(), "loop_end", &F);
-    BasicBlock *dispatchBlock = BasicBlock::Create(F.getContext(), "indirect_dispatch", &F);
+    BasicBlock *dispatchBlock = BasicBlock::Create(F.getContext(),
+        kind == DispatchKind::Switch ? "switch_dispatch" : "indirect_dispatch", &F);
 
     std::vector<BasicBlock *> originalBlocks;
+    std::vector<BasicBlock *> dispatchTargets;
 
     for (BasicBlock &BB : F) {
         if (&BB == entryBlock || &BB == loopEntry || &BB == loopEnd || &BB == dispatchBlock) continue;
         originalBlocks.push_back(&BB);
+        // Blocks inside a preserved loop are only reached through its preheader.
+        if (regionOf(&BB) == &BB) dispatchTargets.push_back(&BB);
     }
 
     if (originalBlocks.empty()) return PreservedAnalyses::all();
 
-    // Setup Entry Trampoline: Initialize state with the BlockAddress of the first block.
+    // More targets than the configured fanout: dispatch through a tree whose
+    // nodes each cover a contiguous range of state IDs.
+    unsigned fanout = getFlattenFanout();
+    bool dispatchTree = fanout != 0 && dispatchTargets.size() > fanout;
+    bool integerState = kind == DispatchKind::Switch || dispatchTree;
+
+    // With integer states each target gets a dense state ID from a per-function random
+    // permutation of [0, N), so the IDs form a compact jump table but leak no block order.
+    DenseMap<BasicBlock *, ConstantInt *> stateIds;
+    std::vector<BasicBlock *> targetById(dispatchTargets.size());
+    if (integerState) {
+        std::vector<uint32_t> ids(dispatchTargets.size());
+        for (uint32_t i = 0; i < ids.size(); ++i) ids[i] = i;
+        for (uint32_t i = ids.size(); i > 1; --i)
+            std::swap(ids[i - 1], ids[ObfuscatorUtils::Random::generateRandomIntInRange(0, i - 1)]);
+        for (size_t i = 0; i < dispatchTargets.size(); ++i) {
+            stateIds[dispatchTargets[i]] = ConstantInt::get(Type::getInt32Ty(F.getContext()), ids[i]);
+            targetById[ids[i]] = dispatchTargets[i];
+        }
+    }
+
+    // The state value that selects a given block in the dispatcher.
+    auto stateFor = [&](BasicBlock *BB) -> Constant * {
+        if (integerState) return stateIds.lookup(BB);
+        return BlockAddress::get(BB);
+    };
+
+    // Threaded blocks: the hottest routed blocks, by the frequency of the original
+    // block they came from, each dispatching on their own.
+    DenseSet<BasicBlock *> threaded;
+    if (BFI) {
+        std::vector<BasicBlock *> candidates;
+        for (BasicBlock *BB : originalBlocks)
+            if (isa<BranchInst>(BB->getTerminator())) candidates.push_back(BB);
+        auto freqOf = [&](BasicBlock *BB) {
+            return BFI->getBlockFreq(BB == firstBlock ? entryBlock : BB).getFrequency();
+        };
+        std::stable_sort(candidates.begin(), candidates.end(),
+            [&](BasicBlock *A, BasicBlock *B) { return freqOf(A) > freqOf(B); });
+        size_t count = static_cast<size_t>(std::ceil(threadedFraction * candidates.size()));
+        threaded.insert(candidates.begin(), candidates.begin() + std::min(count, candidates.size()));
+    }
+
+    // Setup Entry Trampoline: Initialize state with the first block's state value.
+    bool registerState = getRegisterState();
     IRBuilder<> entryBuilder(entryBlock);
-    
-    // Allocate space to hold a pointer (the block address)
-    AllocaInst *stateVar = entryBuilder.CreateAlloca(entryBuilder.getPtrTy(), nullptr, "state_var");
-    
-    // Store the memory address of the first logical block into the state variable
-    entryBuilder.CreateStore(BlockAddress::get(firstBlock), stateVar);
+    Type *stateTy = entryBuilder.getPtrTy();
+    if (integerState) stateTy = entryBuilder.getInt32Ty();
+
+    AllocaInst *stateVar = nullptr;
+    if (!registerState || !threaded.empty()) {
+        // Allocate space to hold the state (a block address or a state ID).
+        // Register-state mode only needs it for the threaded dispatcher copies.
+        stateVar = entryBuilder.CreateAlloca(stateTy, nullptr, "state_var");
+    }
+    if (!registerState) {
+        // Store the state of the first logical block into the state variable
+        entryBuilder.CreateStore(stateFor(firstBlock), stateVar);
+    }
     entryBuilder.CreateBr(loopEntry);
 
     // Central Dispatcher Logic.
     IRBuilder<> builder(loopEntry);
+    PHINode *statePhi = nullptr;
+    PHINode *nextStatePhi = nullptr;
+    if (registerState) {
+        // Every transition feeds loop_end, which loops the next state back into
+        // dispatch_header, so the state never has to round-trip through memory.
+        statePhi = builder.CreatePHI(stateTy, 2, "state");
+        builder.SetInsertPoint(loopEnd);
+        nextStatePhi = builder.CreatePHI(stateTy, 0, "state.next");
+        statePhi->addIncoming(stateFor(firstBlock), entryBlock);
+        statePhi->addIncoming(nextStatePhi, loopEnd);
+        builder.SetInsertPoint(loopEntry);
+    }
     builder.CreateBr(dispatchBlock);
     
     builder.SetInsertPoint(loopEnd);
     builder.CreateBr(loopEntry);
 
-    // Create the Indirect Branch instruction
+    // Record the next state at the end of the block the builder is inserting into.
+    auto setState = [&](IRBuilder<> &B, Value *state) {
+        if (registerState) {
+            nextStatePhi->addIncoming(state, B.GetInsertBlock());
+        } else {
+            B.CreateStore(state, stateVar);
+        }
+    };
+
+    // Every stored state is a valid case, so switch defaults are unreachable and
+    // the backend can drop the range check in front of the jump table.
+    BasicBlock *defaultBlock = nullptr;
+    auto getDefaultBlock = [&]() {
+        if (!defaultBlock) {
+            defaultBlock = BasicBlock::Create(F.getContext(), "dispatch_default", &F);
+            new UnreachableInst(F.getContext(), defaultBlock);
+        }
+        return defaultBlock;
+    };
+
+    // Dispatcher tree. A node covering IDs [lo, hi) switches on state / span,
+    // where span is the ID range of each child; leaves (span 1) jump to the
+    // targets themselves. The root span is the largest power of the fanout below
+    // N, so every node has at most `fanout` successors and all nodes below the
+    // root are shared. They receive the state through a PHI, since the root is
+    // replicated into every threaded block.
+    uint64_t rootSpan = 1;
+    if (dispatchTree)
+        while (rootSpan * fanout < dispatchTargets.size()) rootSpan *= fanout;
+
+    std::map<std::pair<uint64_t, uint64_t>, BasicBlock *> treeNodes;
+    std::function<void(IRBuilder<> &, Value *, uint64_t, uint64_t, uint64_t)> emitNode =
+        [&](IRBuilder<> &B, Value *state, uint64_t lo, uint64_t hi, uint64_t span) {
+        if (span == 1) {
+            if (kind == DispatchKind::Indirect) {
+                // Indirect-mode leaves jump through their own small constant table
+                // of block addresses, so a leaf is still a single indirectbr. One
+                // function-wide table would be re-uniqued in full every time one
+                // of its blocks is deleted.
+                std::vector<Constant *> addrs;
+                for (uint64_t id = lo; id < hi; ++id) addrs.push_back(BlockAddress::get(targetById[id]));
+                auto *tableTy = ArrayType::get(B.getPtrTy(), addrs.size());
+                auto *table = new GlobalVariable(*F.getParent(), tableTy, /*isConstant=*/true,
+                    GlobalValue::PrivateLinkage, ConstantArray::get(tableTy, addrs), "obf.flatten_table");
+                Value *index = lo ? B.CreateSub(state, B.getInt32(lo)) : state;
+                index = B.CreateZExt(index, B.getInt64Ty());
+                Value *slot = B.CreateInBoundsGEP(tableTy, table, {B.getInt64(0), index});
+                Value *addr = B.CreateLoad(B.getPtrTy(), slot, "target_addr");
+                IndirectBrInst *indirectBr = B.CreateIndirectBr(addr, hi - lo);
+                for (uint64_t id = lo; id < hi; ++id) indirectBr->addDestination(targetById[id]);
+            } else {
+                SwitchInst *sw = B.CreateSwitch(state, getDefaultBlock(), hi - lo);
+                for (uint64_t id = lo; id < hi; ++id) sw->addCase(B.getInt32(id), targetById[id]);
+            }
+            return;
+        }
+
+        Value *cluster = B.CreateUDiv(state, B.getInt32(span), "cluster");
+        SwitchInst *sw = B.CreateSwitch(cluster, getDefaultBlock(), fanout);
+        for (uint64_t childLo = lo; childLo < hi; childLo += span) {
+            BasicBlock *&child = treeNodes[{childLo, span}];
+            if (!child) {
+                child = BasicBlock::Create(F.getContext(), "dispatch_node", &F);
+                IRBuilder<> childBuilder(child);
+                PHINode *childState = childBuilder.CreatePHI(state->getType(), 1, "node_state");
+                emitNode(childBuilder, childState, childLo, std::min(childLo + span, hi), span / fanout);
+            }
+            cast<PHINode>(&child->front())->addIncoming(state, B.GetInsertBlock());
+            sw->addCase(B.getInt32(childLo / span), child);
+        }
+    };
+
+    // Emit a dispatcher on the given state at the builder's insertion point. The
+    // shared dispatcher and every threaded copy are built the same way.
+    auto emitDispatch = [&](IRBuilder<> &B, Value *state) {
+        if (dispatchTree) {
+            emitNode(B, state, 0, dispatchTargets.size(), rootSpan);
+        } else if (kind == DispatchKind::Switch) {
+            SwitchInst *sw = B.CreateSwitch(state, getDefaultBlock(), dispatchTargets.size());
+            for (BasicBlock *BB : dispatchTargets) sw->addCase(stateIds[BB], BB);
+        } else {
+            // Create the Indirect Branch instruction
+            IndirectBrInst *indirectBr = B.CreateIndirectBr(state, dispatchTargets.size());
+
+            // Register every region head as a valid destination for the indirect branch
+            for (BasicBlock *BB : dispatchTargets) indirectBr->addDestination(BB);
+        }
+    };
+
     builder.SetInsertPoint(dispatchBlock);
-    LoadInst *loadState = builder.CreateLoad(builder.getPtrTy(), stateVar, "load_state");
-    IndirectBrInst *indirectBr = builder.CreateIndirectBr(loadState, originalBlocks.size());
+    Value *loadState = statePhi;
+    if (!registerState) loadState = builder.CreateLoad(stateTy, stateVar, "load_state");
+    emitDispatch(builder, loadState);
 
-    // 4. Re-route Original Blocks back into the dispatcher using their BlockAddresses.
+    // An edge stays direct only when it continues inside the same preserved loop.
+    auto isInternalEdge = [&](BasicBlock *from, BasicBlock *to) {
+        return regionOf(to) != to && regionOf(to) == regionOf(from);
+    };
+
+    // 4. Re-route Original Blocks back into the dispatcher using their state values.
     for (BasicBlock *BB : originalBlocks) {
-        // Register the block as a valid destination for the indirect branch
-        indirectBr->addDestination(BB);
-        
         Instruction *term = BB->getTerminator();
         
         // Functions ending in return or resume leave the dispatcher naturally.
@@ -134,21 +476,61 @@ PreservedAnalyses FlatteningPass::run(Function &F, FunctionAnalysisManager &AM)
 
         builder.SetInsertPoint(term);
         if (auto *br = dyn_cast<BranchInst>(term)) {
+            // Branches inside a preserved loop keep their direct edges. Its exit
+            // edges were split beforehand, so no branch mixes both kinds of edge.
+            if (all_of(successors(BB), [&](BasicBlock *succ) { return isInternalEdge(BB, succ); })) {
+                continue;
+            }
+
+            Value *next = nullptr;
             if (br->isConditional()) {
-                // Update state variable with the BlockAddress based on the branch condition.
-                Value *select = builder.CreateSelect(br->getCondition(),
-                    BlockAddress::get(br->getSuccessor(0)),
-                    BlockAddress::get(br->getSuccessor(1)));
-                builder.CreateStore(select, stateVar);
+                // Update state variable with the successor's state based on the branch condition.
+                next = builder.CreateSelect(br->getCondition(),
+                    stateFor(br->getSuccessor(0)),
+                    stateFor(br->getSuccessor(1)));
             } else {
-                // Update state variable with the unconditional BlockAddress.
-                builder.CreateStore(BlockAddress::get(br->getSuccessor(0)), stateVar);
+                // Update state variable with the unconditional successor's state.
+                next = stateFor(br->getSuccessor(0));
+            }
+
+            if (threaded.count(BB)) {
+                // Threaded copy: reload the state and dispatch right here, like a
+                // threaded interpreter. The round trip is volatile because a
+                // dispatch on the select itself would be folded back into a plain
+                // conditional branch by SimplifyCFG.
+                builder.CreateStore(next, stateVar, /*isVolatile=*/true);
+                Value *state = builder.CreateLoad(stateTy, stateVar, /*isVolatile=*/true, "load_state");
+                emitDispatch(builder, state);
+            } else {
+                setState(builder, next);
+                builder.CreateBr(loopEnd);
             }
-            builder.CreateBr(loopEnd);
             term->eraseFromParent();
         }
     }
 
+    // 5. Promote the demoted values back to SSA. PromoteMemToReg recomputes
+    // dominance on the flattened CFG, so values that live across the dispatcher
+    // get PHIs in dispatch_header and the rest become plain registers again.
+    if (registerState) {
+        // Every slot that lives across the dispatcher costs PHIs with one
+        // incoming value per dispatcher edge: the jumps back to loop_end plus
+        // the edges into each target. Cap the total so huge functions keep the
+        // remaining slots in memory instead of growing quadratically.
+        size_t dispatchEdges = pred_size(loopEnd);
+        for (BasicBlock *BB : dispatchTargets) dispatchEdges += pred_size(BB);
+        size_t maxSlots = std::max<size_t>(1, kPromotionPhiBudget / std::max<size_t>(1, dispatchEdges));
+        std::vector<AllocaInst *> promotable;
+        for (AllocaInst *AI : demotedSlots) {
+            if (promotable.size() == maxSlots) break;
+            if (AI && isAllocaPromotable(AI)) promotable.push_back(AI);
+        }
+        if (!promotable.empty()) {
+            DominatorTree DT(F);
+            PromoteMemToReg(promotable, DT);
+        }
+    }
+
     return PreservedAnalyses::none();
 }
 
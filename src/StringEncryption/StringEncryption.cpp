@@ -1,13 +1,23 @@
 #include "StringEncryption.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 #include "llvm/Support/raw_ostream.h"
 #include "../Utils/Crypto.h"
 #include "../Utils/Random.h"
+#include <cstdlib>
 #include <vector>
 
 using namespace llvm;
@@ -15,16 +25,655 @@ using namespace llvm;
 // Number of bytes in the rolling XOR key
 static constexpr unsigned KEY_LENGTH = 8;
 
+// Per-string guard states used by lazy mode.
+static constexpr uint32_t FLAG_ENCRYPTED = 0;
+static constexpr uint32_t FLAG_BUSY = 1;
+static constexpr uint32_t FLAG_READY = 2;
+
+// Largest string transient mode decrypts into a stack buffer; bigger ones fall
+// back to eager decryption.
+static constexpr uint64_t MAX_TRANSIENT_BYTES = 4096;
+
+enum class StringMode { Eager, Lazy, Transient, Arena };
+
+// Read HIDEIR_STRING_TRANSIENT_BUDGET: the stack bytes transient mode may give
+// each function for strings used inside loops, which keep a buffer of their
+// own while the loop runs. Strings that would exceed it fall back to eager
+// decryption. Defaults to 16384.
+static uint64_t getTransientBudget() {
+    if (const char *env = std::getenv("HIDEIR_STRING_TRANSIENT_BUDGET")) {
+        return std::strtoull(env, nullptr, 10);
+    }
+    return 16384;
+}
+
+// Read HIDEIR_STRING_MODE. "eager" (default) decrypts every string in a startup
+// constructor; "lazy" decrypts each string on its first use behind an atomic
+// guard; "transient" never decrypts the global and instead decrypts into a
+// stack buffer around each use, wiping it afterwards; "arena" keeps the
+// ciphertext read-only and decrypts a copy into a private arena on first use.
+static StringMode getStringMode() {
+    if (const char *env = std::getenv("HIDEIR_STRING_MODE")) {
+        if (StringRef(env) == "lazy") return StringMode::Lazy;
+        if (StringRef(env) == "arena") return StringMode::Arena;
+        if (StringRef(env) == "transient") return StringMode::Transient;
+    }
+    return StringMode::Eager;
+}
+
+// Read HIDEIR_STRING_MAX_SIZE: strings larger than this many bytes (embedded
+// certificates, schemas, lookup tables) are handled by the large-blob policy
+// instead of the configured mode. Defaults to 1 MiB; 0 disables the cutoff.
+static uint64_t getMaxStringSize() {
+    if (const char *env = std::getenv("HIDEIR_STRING_MAX_SIZE")) {
+        return std::strtoull(env, nullptr, 10);
+    }
+    return 1 << 20;
+}
+
+enum class StringCipher { Xor, ChaCha20 };
+
+// Read HIDEIR_STRING_CIPHER. "xor" (default) applies a per-string 8-byte
+// rolling key; "chacha20" encrypts every string with ChaCha20 under one
+// module key and a random per-string nonce.
+static StringCipher getStringCipher() {
+    if (const char *env = std::getenv("HIDEIR_STRING_CIPHER")) {
+        if (StringRef(env) == "chacha20") return StringCipher::ChaCha20;
+    }
+    return StringCipher::Xor;
+}
+
+// ChaCha20 blocks the runtime kernel computes per loop iteration. Each state
+// row is one vector holding that row of every block, so the rounds run on
+// 32-lane vectors that the backend splits across AVX2, SSE2 or NEON registers,
+// or scalarizes on targets without SIMD.
+static constexpr unsigned CHACHA_BLOCKS = 8;
+
+enum class PrefoldLevel { None, Results, All };
+
+// Read HIDEIR_STRING_PREFOLD. Library calls on string literals are folded
+// before encryption, while the plaintext is still a constant: "results"
+// (default) replaces strlen/strcmp/strncmp/memcmp calls whose result is known,
+// "all" also turns small fixed-size memcpys from a literal into immediate
+// stores (which puts those bytes into the code), and "none" disables folding.
+static PrefoldLevel getPrefoldLevel() {
+    if (const char *env = std::getenv("HIDEIR_STRING_PREFOLD")) {
+        if (StringRef(env) == "none") return PrefoldLevel::None;
+        if (StringRef(env) == "all") return PrefoldLevel::All;
+    }
+    return PrefoldLevel::Results;
+}
+
+enum class LargeBlobPolicy { Lazy, Eager, Skip };
+
+// Read HIDEIR_STRING_LARGE_POLICY for strings above the size cutoff. "lazy"
+// (default) decrypts a blob only when it is first used, "eager" decrypts it at
+// startup like any other string, and "skip" leaves it unencrypted.
+static LargeBlobPolicy getLargeBlobPolicy() {
+    if (const char *env = std::getenv("HIDEIR_STRING_LARGE_POLICY")) {
+        if (StringRef(env) == "eager") return LargeBlobPolicy::Eager;
+        if (StringRef(env) == "skip") return LargeBlobPolicy::Skip;
+    }
+    return LargeBlobPolicy::Lazy;
+}
+
+// Whether a direct use of a string can read a transient copy instead: the
+// pointer must not outlive the instruction and nothing may write through it.
+// Loads qualify, and so do call arguments the callee declares nocapture and
+// readonly, or that are passed to a library function known to only read its
+// string arguments. Everything else (stores, memcpy/memset destinations,
+// registration APIs such as putenv or pthread_create) keeps the string eager.
+static bool isTransientUse(const Use &U, FunctionAnalysisManager &FAM) {
+    auto *I = dyn_cast<Instruction>(U.getUser());
+    if (!I) return false;
+    if (isa<LoadInst>(I)) return true;
+    auto *CB = dyn_cast<CallBase>(I);
+    if (!CB || isa<CallBrInst>(CB) || !CB->isArgOperand(&U)) return false;
+    unsigned argNo = CB->getArgOperandNo(&U);
+    if (CB->doesNotCapture(argNo) && CB->onlyReadsMemory(argNo)) return true;
+
+    LibFunc func;
+    const TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(*I->getFunction());
+    if (!TLI.getLibFunc(*CB, func)) return false;
+    switch (func) {
+    case LibFunc_strlen:
+    case LibFunc_strnlen:
+    case LibFunc_strcmp:
+    case LibFunc_strncmp:
+    case LibFunc_strcasecmp:
+    case LibFunc_strncasecmp:
+    case LibFunc_memcmp:
+    case LibFunc_bcmp:
+    case LibFunc_puts:
+    case LibFunc_fputs:
+    case LibFunc_printf:
+    case LibFunc_fprintf:
+    case LibFunc_perror:
+    case LibFunc_atoi:
+    case LibFunc_atol:
+    case LibFunc_atoll:
+    case LibFunc_atof:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Collect the instructions that use C, looking through constant expressions.
+// Returns false if C is also reachable from something that is not an
+// instruction (such as another global's initializer), which no use-site guard
+// can protect.
+static bool collectInstructionUsers(Constant *C, std::vector<Instruction *> &users) {
+    for (User *U : C->users()) {
+        if (auto *I = dyn_cast<Instruction>(U)) {
+            users.push_back(I);
+        } else if (auto *CE = dyn_cast<ConstantExpr>(U)) {
+            if (!collectInstructionUsers(CE, users)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rewrite the constant expression CE into instructions at every place where an
+// instruction uses it, directly or through further constant expressions, so
+// that the value it is built on ends up used by instruction operands only.
+static void expandConstantExpr(ConstantExpr *CE) {
+    std::vector<User *> users(CE->user_begin(), CE->user_end());
+    for (User *U : users) {
+        if (auto *outer = dyn_cast<ConstantExpr>(U)) {
+            expandConstantExpr(outer);
+        } else if (auto *PN = dyn_cast<PHINode>(U)) {
+            // Materialize once per incoming block; a block may appear on
+            // several edges and must then feed the same value.
+            DenseMap<BasicBlock *, Instruction *> expanded;
+            for (unsigned op = 0; op < PN->getNumIncomingValues(); ++op) {
+                if (PN->getIncomingValue(op) != CE) continue;
+                Instruction *&NI = expanded[PN->getIncomingBlock(op)];
+                if (!NI) NI = CE->getAsInstruction(PN->getIncomingBlock(op)->getTerminator());
+                PN->setIncomingValue(op, NI);
+            }
+        } else if (auto *I = dyn_cast<Instruction>(U)) {
+            I->replaceUsesOfWith(CE, CE->getAsInstruction(I));
+        }
+    }
+}
+
+// Replace a call that only reads string literals with its result, computed
+// from the plaintext. Returns true if the call was folded and erased.
+static bool foldStringLibCall(CallInst *CI, const TargetLibraryInfo &TLI, const DataLayout &DL, PrefoldLevel level) {
+    Value *result = nullptr;
+    StringRef lhs, rhs;
+    LibFunc func;
+    if (auto *MC = dyn_cast<MemCpyInst>(CI)) {
+        // A copy of 1, 2, 4 or 8 bytes becomes one integer store, which is
+        // what InstCombine would have made of it on a plaintext source.
+        auto *size = dyn_cast<ConstantInt>(MC->getLength());
+        if (level != PrefoldLevel::All || MC->isVolatile() || !size) return false;
+        uint64_t n = size->getZExtValue();
+        if (!isPowerOf2_64(n) || n > 8 || !getConstantStringInfo(MC->getSource(), lhs, /*TrimAtNul=*/false) ||
+            lhs.size() < n) return false;
+        APInt bytes(8 * n, 0);
+        for (uint64_t k = 0; k < n; ++k) {
+            uint64_t index = DL.isLittleEndian() ? n - 1 - k : k;
+            bytes = bytes.shl(8) | APInt(8 * n, static_cast<uint8_t>(lhs[index]));
+        }
+        new StoreInst(ConstantInt::get(CI->getContext(), bytes), MC->getDest(), false,
+            MC->getDestAlign().valueOrOne(), MC);
+        MC->eraseFromParent();
+        return true;
+    }
+    if (!TLI.getLibFunc(*CI, func)) return false;
+
+    switch (func) {
+    case LibFunc_strlen:
+        if (getConstantStringInfo(CI->getArgOperand(0), lhs))
+            result = ConstantInt::get(CI->getType(), lhs.size());
+        break;
+    case LibFunc_strcmp:
+        if (getConstantStringInfo(CI->getArgOperand(0), lhs) && getConstantStringInfo(CI->getArgOperand(1), rhs))
+            result = ConstantInt::get(CI->getType(), lhs.compare(rhs), /*IsSigned=*/true);
+        break;
+    case LibFunc_strncmp:
+        // The strings end at their NUL, which sorts before any other byte,
+        // so comparing the truncated strings matches the C semantics.
+        if (auto *n = dyn_cast<ConstantInt>(CI->getArgOperand(2)))
+            if (getConstantStringInfo(CI->getArgOperand(0), lhs) && getConstantStringInfo(CI->getArgOperand(1), rhs))
+                result = ConstantInt::get(CI->getType(),
+                    lhs.take_front(n->getZExtValue()).compare(rhs.take_front(n->getZExtValue())), /*IsSigned=*/true);
+        break;
+    case LibFunc_memcmp:
+    case LibFunc_bcmp:
+        if (auto *n = dyn_cast<ConstantInt>(CI->getArgOperand(2)))
+            if (getConstantStringInfo(CI->getArgOperand(0), lhs, /*TrimAtNul=*/false) &&
+                getConstantStringInfo(CI->getArgOperand(1), rhs, /*TrimAtNul=*/false) &&
+                lhs.size() >= n->getZExtValue() && rhs.size() >= n->getZExtValue())
+                result = ConstantInt::get(CI->getType(),
+                    lhs.take_front(n->getZExtValue()).compare(rhs.take_front(n->getZExtValue())), /*IsSigned=*/true);
+        break;
+    default:
+        break;
+    }
+    if (!result) return false;
+    CI->replaceAllUsesWith(result);
+    CI->eraseFromParent();
+    return true;
+}
+
+// Whether V is GV or a constant expression built on top of it.
+static bool refersTo(Value *V, GlobalVariable *GV) {
+    if (V == GV) return true;
+    if (auto *CE = dyn_cast<ConstantExpr>(V))
+        return any_of(CE->operands(), [GV](Value *Op) { return refersTo(Op, GV); });
+    return false;
+}
+
+// Pack the rolling key into the i64 whose in-memory bytes are key[0..7] on the
+// target, so XORing a word of a string at an 8-byte offset applies the key.
+static uint64_t packKey(const std::array<uint8_t, KEY_LENGTH> &key, const DataLayout &DL) {
+    uint64_t packed = 0;
+    for (unsigned k = 0; k < KEY_LENGTH; ++k) {
+        unsigned shift = DL.isBigEndian() ? 8 * (KEY_LENGTH - 1 - k) : 8 * k;
+        packed |= static_cast<uint64_t>(key[k]) << shift;
+    }
+    return packed;
+}
+
+// Build the decryption kernel shared by every mode:
+//   void obf.xor_range(ptr data, i64 len, i64 key)
+// It XORs the packed key into the string one unaligned 64-bit word at a time,
+// which the loop vectorizer widens to SIMD, then finishes the tail bytewise
+// by indexing the key through a stack copy.
+static Function *getOrCreateXorKernel(Module &M) {
+    if (Function *existing = M.getFunction("obf.xor_range")) return existing;
+
+    LLVMContext &ctx = M.getContext();
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    FunctionType *fnTy = FunctionType::get(Type::getVoidTy(ctx), {ptrTy, i64Ty, i64Ty}, false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.xor_range", &M);
+    // Transient mode copies constant ciphertext into a buffer before calling
+    // this; inlined, the optimizer could fold the plaintext into the caller.
+    fn->addFnAttr(Attribute::NoInline);
+
+    Value *data = fn->getArg(0);
+    Value *len = fn->getArg(1);
+    Value *key = fn->getArg(2);
+
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", fn);
+    BasicBlock *wordLoop = BasicBlock::Create(ctx, "words", fn);
+    BasicBlock *tailCheck = BasicBlock::Create(ctx, "tail_check", fn);
+    BasicBlock *tailLoop = BasicBlock::Create(ctx, "tail", fn);
+    BasicBlock *done = BasicBlock::Create(ctx, "done", fn);
+
+    IRBuilder<> builder(entry);
+    Value *keyBuf = builder.CreateAlloca(i64Ty, nullptr, "key_bytes");
+    builder.CreateStore(key, keyBuf);
+    Value *words = builder.CreateLShr(len, 3, "word_count");
+    Value *tailStart = builder.CreateShl(words, 3, "tail_start");
+    builder.CreateCondBr(builder.CreateICmpNE(words, builder.getInt64(0)), wordLoop, tailCheck);
+
+    builder.SetInsertPoint(wordLoop);
+    PHINode *w = builder.CreatePHI(i64Ty, 2, "w");
+    w->addIncoming(builder.getInt64(0), entry);
+    Value *wordPtr = builder.CreateInBoundsGEP(i64Ty, data, w);
+    Value *word = builder.CreateAlignedLoad(i64Ty, wordPtr, MaybeAlign(1));
+    builder.CreateAlignedStore(builder.CreateXor(word, key), wordPtr, MaybeAlign(1));
+    Value *nextWord = builder.CreateAdd(w, builder.getInt64(1));
+    w->addIncoming(nextWord, wordLoop);
+    builder.CreateCondBr(builder.CreateICmpEQ(nextWord, words), tailCheck, wordLoop);
+
+    builder.SetInsertPoint(tailCheck);
+    builder.CreateCondBr(builder.CreateICmpNE(tailStart, len), tailLoop, done);
+
+    builder.SetInsertPoint(tailLoop);
+    PHINode *i = builder.CreatePHI(i64Ty, 2, "i");
+    i->addIncoming(tailStart, tailCheck);
+    Value *bytePtr = builder.CreateInBoundsGEP(builder.getInt8Ty(), data, i);
+    Value *keyPtr = builder.CreateInBoundsGEP(builder.getInt8Ty(), keyBuf,
+        builder.CreateAnd(i, builder.getInt64(KEY_LENGTH - 1)));
+    Value *plain = builder.CreateXor(builder.CreateLoad(builder.getInt8Ty(), bytePtr),
+        builder.CreateLoad(builder.getInt8Ty(), keyPtr));
+    builder.CreateStore(plain, bytePtr);
+    Value *next = builder.CreateAdd(i, builder.getInt64(1));
+    i->addIncoming(next, tailLoop);
+    builder.CreateCondBr(builder.CreateICmpEQ(next, len), done, tailLoop);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    return fn;
+}
+
+// Return the module's ChaCha20 key, a private [8 x i32] global created with
+// random words on first use.
+static GlobalVariable *getOrCreateStringKey(Module &M) {
+    if (GlobalVariable *existing = M.getNamedGlobal("obf.string_key")) return existing;
+
+    std::vector<uint32_t> words(8);
+    for (uint32_t &word : words) word = ObfuscatorUtils::Random::generateRandomInt();
+    auto *keyGV = new GlobalVariable(M, ArrayType::get(Type::getInt32Ty(M.getContext()), 8), true,
+        GlobalValue::PrivateLinkage, ConstantDataArray::get(M.getContext(), words), "obf.string_key");
+    keyGV->setAlignment(Align(16));
+    return keyGV;
+}
+
+// Build the ChaCha20 decryption kernel:
+//   void obf.chacha20_xor(ptr data, i64 len, i64 nonce)
+// Each iteration computes CHACHA_BLOCKS keystream blocks at once with the
+// four state rows held in <4 * CHACHA_BLOCKS x i32> vectors (lane 4*b+c is
+// column c of block b). Diagonal rounds rotate lanes within each block with
+// shufflevector. Full chunks are XORed as vectors; the final partial chunk
+// goes through a stack copy of the keystream bytewise.
+static Function *getOrCreateChaChaKernel(Module &M) {
+    if (Function *existing = M.getFunction("obf.chacha20_xor")) return existing;
+
+    LLVMContext &ctx = M.getContext();
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    Type *i32Ty = Type::getInt32Ty(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    constexpr unsigned lanes = 4 * CHACHA_BLOCKS;
+    constexpr uint64_t chunkBytes = 64 * CHACHA_BLOCKS;
+    auto *rowTy = FixedVectorType::get(i32Ty, lanes);
+    auto *quadTy = FixedVectorType::get(i32Ty, 4);
+    FunctionType *fnTy = FunctionType::get(Type::getVoidTy(ctx), {ptrTy, i64Ty, i64Ty}, false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.chacha20_xor", &M);
+    fn->addFnAttr(Attribute::NoInline);
+    GlobalVariable *keyGV = getOrCreateStringKey(M);
+
+    Value *data = fn->getArg(0);
+    Value *len = fn->getArg(1);
+    Value *nonce = fn->getArg(2);
+
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", fn);
+    BasicBlock *chunk = BasicBlock::Create(ctx, "chunk", fn);
+    BasicBlock *full = BasicBlock::Create(ctx, "full", fn);
+    BasicBlock *partial = BasicBlock::Create(ctx, "partial", fn);
+    BasicBlock *tail = BasicBlock::Create(ctx, "tail", fn);
+    BasicBlock *done = BasicBlock::Create(ctx, "done", fn);
+
+    // Shuffle masks over the 4 lanes of every block: broadcast a single 4-word
+    // row to all blocks, or rotate each block's lanes left by some amount.
+    SmallVector<int, lanes> broadcast;
+    for (unsigned l = 0; l < lanes; ++l) broadcast.push_back(l % 4);
+    auto rotateLanes = [&](IRBuilder<> &B, Value *row, unsigned by) {
+        SmallVector<int, lanes> mask;
+        for (unsigned l = 0; l < lanes; ++l) mask.push_back(l - l % 4 + (l + by) % 4);
+        return B.CreateShuffleVector(row, mask);
+    };
+
+    IRBuilder<> builder(entry);
+    AllocaInst *ksBuf = builder.CreateAlloca(ArrayType::get(builder.getInt8Ty(), chunkBytes), nullptr, "keystream");
+    ksBuf->setAlignment(Align(16));
+    Value *keyLo = builder.CreateAlignedLoad(quadTy, keyGV, Align(16), "key_lo");
+    Value *keyHi = builder.CreateAlignedLoad(quadTy,
+        builder.CreateConstInBoundsGEP1_64(i32Ty, keyGV, 4), Align(16), "key_hi");
+    SmallVector<Constant *, lanes> sigma, blockIdx;
+    const uint32_t expand[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    for (unsigned l = 0; l < lanes; ++l) {
+        sigma.push_back(builder.getInt32(expand[l % 4]));
+        blockIdx.push_back(builder.getInt32(l % 4 == 0 ? l / 4 : 0));
+    }
+    Value *row0 = ConstantVector::get(sigma);
+    Value *row1 = builder.CreateShuffleVector(keyLo, broadcast, "row1");
+    Value *row2 = builder.CreateShuffleVector(keyHi, broadcast, "row2");
+    Value *nonceLo = builder.CreateTrunc(nonce, i32Ty);
+    Value *nonceHi = builder.CreateTrunc(builder.CreateLShr(nonce, 32), i32Ty);
+    builder.CreateCondBr(builder.CreateICmpNE(len, builder.getInt64(0)), chunk, done);
+
+    builder.SetInsertPoint(chunk);
+    PHINode *offset = builder.CreatePHI(i64Ty, 2, "offset");
+    offset->addIncoming(builder.getInt64(0), entry);
+    Value *counter = builder.CreateLShr(offset, 6);
+    Value *quad3 = PoisonValue::get(quadTy);
+    quad3 = builder.CreateInsertElement(quad3, builder.CreateTrunc(counter, i32Ty), uint64_t(0));
+    quad3 = builder.CreateInsertElement(quad3, builder.CreateTrunc(builder.CreateLShr(counter, 32), i32Ty), 1);
+    quad3 = builder.CreateInsertElement(quad3, nonceLo, 2);
+    quad3 = builder.CreateInsertElement(quad3, nonceHi, 3);
+    // The chunk's first counter is a multiple of CHACHA_BLOCKS, so adding the
+    // block index to the low word never carries.
+    Value *row3 = builder.CreateAdd(builder.CreateShuffleVector(quad3, broadcast),
+        ConstantVector::get(blockIdx), "row3");
+
+    Function *fshl = Intrinsic::getDeclaration(&M, Intrinsic::fshl, {rowTy});
+    auto rotl = [&](Value *v, unsigned n) {
+        Value *amount = ConstantVector::getSplat(ElementCount::getFixed(lanes), builder.getInt32(n));
+        return builder.CreateCall(fshl, {v, v, amount});
+    };
+    Value *x[4] = {row0, row1, row2, row3};
+    auto quarterRound = [&]() {
+        x[0] = builder.CreateAdd(x[0], x[1]); x[3] = rotl(builder.CreateXor(x[3], x[0]), 16);
+        x[2] = builder.CreateAdd(x[2], x[3]); x[1] = rotl(builder.CreateXor(x[1], x[2]), 12);
+        x[0] = builder.CreateAdd(x[0], x[1]); x[3] = rotl(builder.CreateXor(x[3], x[0]), 8);
+        x[2] = builder.CreateAdd(x[2], x[3]); x[1] = rotl(builder.CreateXor(x[1], x[2]), 7);
+    };
+    for (unsigned round = 0; round < 10; ++round) {
+        quarterRound();
+        x[1] = rotateLanes(builder, x[1], 1);
+        x[2] = rotateLanes(builder, x[2], 2);
+        x[3] = rotateLanes(builder, x[3], 3);
+        quarterRound();
+        x[1] = rotateLanes(builder, x[1], 3);
+        x[2] = rotateLanes(builder, x[2], 2);
+        x[3] = rotateLanes(builder, x[3], 1);
+    }
+    x[0] = builder.CreateAdd(x[0], row0);
+    x[1] = builder.CreateAdd(x[1], row1);
+    x[2] = builder.CreateAdd(x[2], row2);
+    x[3] = builder.CreateAdd(x[3], row3);
+
+    // Gather the 16 words of each block back into memory order.
+    SmallVector<Value *, CHACHA_BLOCKS> keystream;
+    for (unsigned b = 0; b < CHACHA_BLOCKS; ++b) {
+        SmallVector<int, 8> pick;
+        for (unsigned c = 0; c < 8; ++c) pick.push_back(c < 4 ? 4 * b + c : lanes + 4 * b + c - 4);
+        Value *lo = builder.CreateShuffleVector(x[0], x[1], pick);
+        Value *hi = builder.CreateShuffleVector(x[2], x[3], pick);
+        Value *block = builder.CreateShuffleVector(lo, hi,
+            ArrayRef<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}));
+        // Keystream words are serialized little-endian.
+        if (M.getDataLayout().isBigEndian())
+            block = builder.CreateUnaryIntrinsic(Intrinsic::bswap, block);
+        keystream.push_back(block);
+    }
+    auto *blockTy = FixedVectorType::get(i32Ty, 16);
+    Value *remaining = builder.CreateSub(len, offset, "remaining");
+    builder.CreateCondBr(builder.CreateICmpUGE(remaining, builder.getInt64(chunkBytes)), full, partial);
+
+    builder.SetInsertPoint(full);
+    for (unsigned b = 0; b < CHACHA_BLOCKS; ++b) {
+        Value *blockPtr = builder.CreateInBoundsGEP(builder.getInt8Ty(), data,
+            builder.CreateAdd(offset, builder.getInt64(64 * b)));
+        Value *cipher = builder.CreateAlignedLoad(blockTy, blockPtr, MaybeAlign(1));
+        builder.CreateAlignedStore(builder.CreateXor(cipher, keystream[b]), blockPtr, MaybeAlign(1));
+    }
+    Value *nextOffset = builder.CreateAdd(offset, builder.getInt64(chunkBytes));
+    offset->addIncoming(nextOffset, full);
+    builder.CreateCondBr(builder.CreateICmpEQ(nextOffset, len), done, chunk);
+
+    builder.SetInsertPoint(partial);
+    for (unsigned b = 0; b < CHACHA_BLOCKS; ++b)
+        builder.CreateAlignedStore(keystream[b], builder.CreateConstInBoundsGEP1_64(blockTy, ksBuf, b), Align(16));
+    builder.CreateBr(tail);
+
+    builder.SetInsertPoint(tail);
+    PHINode *i = builder.CreatePHI(i64Ty, 2, "i");
+    i->addIncoming(builder.getInt64(0), partial);
+    Value *bytePtr = builder.CreateInBoundsGEP(builder.getInt8Ty(), data, builder.CreateAdd(offset, i));
+    Value *ksPtr = builder.CreateInBoundsGEP(builder.getInt8Ty(), ksBuf, i);
+    Value *plain = builder.CreateXor(builder.CreateLoad(builder.getInt8Ty(), bytePtr),
+        builder.CreateLoad(builder.getInt8Ty(), ksPtr));
+    builder.CreateStore(plain, bytePtr);
+    Value *next = builder.CreateAdd(i, builder.getInt64(1));
+    i->addIncoming(next, tail);
+    builder.CreateCondBr(builder.CreateICmpEQ(next, remaining), done, tail);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    return fn;
+}
+
+// Return the decryption kernel for the configured cipher. Both take
+// (ptr data, i64 len, i64 key), where key is the packed rolling key for XOR
+// and the per-string nonce for ChaCha20.
+static Function *getOrCreateDecryptKernel(Module &M, StringCipher cipher) {
+    return cipher == StringCipher::ChaCha20 ? getOrCreateChaChaKernel(M) : getOrCreateXorKernel(M);
+}
+
+// Build the shared slow path of lazy mode:
+//   void obf.decrypt_once(ptr flag, ptr data, i64 len, i64 key)
+// The first caller moves the flag from ENCRYPTED to BUSY, decrypts the string
+// with the cipher's kernel and publishes READY with release ordering. Racing
+// callers spin until READY, so no thread ever observes a half-decrypted string.
+static Function *createLazyDecryptor(Module &M, Function *kernel) {
+    LLVMContext &ctx = M.getContext();
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    FunctionType *fnTy = FunctionType::get(Type::getVoidTy(ctx), {ptrTy, ptrTy, i64Ty, i64Ty}, false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.decrypt_once", &M);
+    fn->addFnAttr(Attribute::NoInline);
+    fn->addFnAttr(Attribute::Cold);
+
+    Value *flag = fn->getArg(0);
+    Value *data = fn->getArg(1);
+    Value *len = fn->getArg(2);
+    Value *key = fn->getArg(3);
+
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", fn);
+    BasicBlock *publish = BasicBlock::Create(ctx, "publish", fn);
+    BasicBlock *wait = BasicBlock::Create(ctx, "wait", fn);
+    BasicBlock *done = BasicBlock::Create(ctx, "done", fn);
+
+    IRBuilder<> builder(entry);
+    Value *claim = builder.CreateAtomicCmpXchg(flag, builder.getInt32(FLAG_ENCRYPTED),
+        builder.getInt32(FLAG_BUSY), MaybeAlign(4), AtomicOrdering::Acquire, AtomicOrdering::Acquire);
+    builder.CreateCondBr(builder.CreateExtractValue(claim, 1), publish, wait);
+
+    builder.SetInsertPoint(publish);
+    builder.CreateCall(kernel, {data, len, key});
+    builder.CreateAlignedStore(builder.getInt32(FLAG_READY), flag, MaybeAlign(4))
+        ->setAtomic(AtomicOrdering::Release);
+    builder.CreateRetVoid();
+
+    // Another thread owns the decryption; wait for it to publish.
+    builder.SetInsertPoint(wait);
+    LoadInst *state = builder.CreateAlignedLoad(builder.getInt32Ty(), flag, MaybeAlign(4));
+    state->setAtomic(AtomicOrdering::Acquire);
+    builder.CreateCondBr(builder.CreateICmpEQ(state, builder.getInt32(FLAG_READY)), done, wait);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    return fn;
+}
+
+// Build the first-use path of arena mode:
+//   ptr obf.decrypt_to_arena(ptr flag, ptr slot, ptr src, i64 len, i64 key, i64 align)
+// The caller that claims the flag bump-allocates len bytes at the requested
+// alignment from obf.string_arena, copies the read-only ciphertext there,
+// decrypts the copy and publishes its address in the slot with release
+// ordering. Racing callers spin until the slot is set. Returns the copy.
+static Function *createArenaDecryptor(Module &M, Function *kernel, GlobalVariable *arena, GlobalVariable *next) {
+    LLVMContext &ctx = M.getContext();
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    FunctionType *fnTy = FunctionType::get(ptrTy, {ptrTy, ptrTy, ptrTy, i64Ty, i64Ty, i64Ty}, false);
+    Function *fn = Function::Create(fnTy, GlobalValue::InternalLinkage, "obf.decrypt_to_arena", &M);
+    fn->addFnAttr(Attribute::NoInline);
+    fn->addFnAttr(Attribute::Cold);
+
+    Value *flag = fn->getArg(0);
+    Value *slot = fn->getArg(1);
+    Value *src = fn->getArg(2);
+    Value *len = fn->getArg(3);
+    Value *key = fn->getArg(4);
+    Value *align = fn->getArg(5);
+
+    BasicBlock *entry = BasicBlock::Create(ctx, "entry", fn);
+    BasicBlock *publish = BasicBlock::Create(ctx, "publish", fn);
+    BasicBlock *wait = BasicBlock::Create(ctx, "wait", fn);
+    BasicBlock *done = BasicBlock::Create(ctx, "done", fn);
+
+    IRBuilder<> builder(entry);
+    Value *claim = builder.CreateAtomicCmpXchg(flag, builder.getInt32(FLAG_ENCRYPTED),
+        builder.getInt32(FLAG_BUSY), MaybeAlign(4), AtomicOrdering::Acquire, AtomicOrdering::Acquire);
+    builder.CreateCondBr(builder.CreateExtractValue(claim, 1), publish, wait);
+
+    // Reserve len + align - 1 bytes so the copy can be aligned within them.
+    builder.SetInsertPoint(publish);
+    Value *alignMask = builder.CreateSub(align, builder.getInt64(1));
+    Value *offset = builder.CreateAtomicRMW(AtomicRMWInst::Add, next, builder.CreateAdd(len, alignMask),
+        MaybeAlign(8), AtomicOrdering::Monotonic);
+    Value *base = builder.CreateAdd(builder.CreatePtrToInt(arena, i64Ty), offset);
+    Value *padding = builder.CreateAnd(builder.CreateNeg(base), alignMask);
+    Value *dst = builder.CreateInBoundsGEP(builder.getInt8Ty(), arena, builder.CreateAdd(offset, padding), "copy");
+    builder.CreateMemCpy(dst, Align(1), src, Align(1), len);
+    builder.CreateCall(kernel, {dst, len, key});
+    builder.CreateAlignedStore(dst, slot, MaybeAlign(8))->setAtomic(AtomicOrdering::Release);
+    builder.CreateRet(dst);
+
+    // Another thread owns the decryption; wait for it to publish the copy.
+    builder.SetInsertPoint(wait);
+    LoadInst *published = builder.CreateAlignedLoad(ptrTy, slot, MaybeAlign(8));
+    published->setAtomic(AtomicOrdering::Acquire);
+    builder.CreateCondBr(builder.CreateIsNull(published), wait, done);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRet(published);
+    return fn;
+}
+
 PreservedAnalyses StringEncryptionPass::run(Module &M, ModuleAnalysisManager &AM) {
     bool modified = false;
     LLVMContext &ctx = M.getContext();
 
     struct EncryptedString {
         GlobalVariable *GV;
-        std::array<uint8_t, KEY_LENGTH> key;
+        uint64_t key; // packed rolling key or ChaCha20 nonce
+        StringMode mode;
     };
     std::vector<EncryptedString> targetStrings;
 
+    StringMode mode = getStringMode();
+    uint64_t maxSize = getMaxStringSize();
+    LargeBlobPolicy largePolicy = getLargeBlobPolicy();
+    StringCipher cipher = getStringCipher();
+
+    // Fold library calls on string literals while their contents are still
+    // constants, so lengths and comparison results stay visible to the
+    // optimizer. A string left without uses is dropped instead of encrypted.
+    PrefoldLevel prefold = getPrefoldLevel();
+    if (prefold != PrefoldLevel::None) {
+        FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        std::vector<GlobalVariable *> unused;
+        for (GlobalVariable &GV : M.globals()) {
+            if (GV.getName().starts_with("llvm.") || !GV.hasInitializer() || !GV.isConstant()) continue;
+            auto *CDS = dyn_cast<ConstantDataSequential>(GV.getInitializer());
+            if (!CDS || !CDS->getElementType()->isIntegerTy(8)) continue;
+
+            std::vector<Instruction *> users;
+            collectInstructionUsers(&GV, users);
+            SmallPtrSet<CallInst *, 8> calls;
+            for (Instruction *I : users)
+                if (auto *CI = dyn_cast<CallInst>(I)) calls.insert(CI);
+            bool folded = false;
+            for (CallInst *CI : calls) {
+                const TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(*CI->getFunction());
+                folded |= foldStringLibCall(CI, TLI, M.getDataLayout(), prefold);
+            }
+            if (!folded) continue;
+            modified = true;
+            GV.removeDeadConstantUsers();
+            if (GV.use_empty() && GV.hasLocalLinkage()) unused.push_back(&GV);
+        }
+        for (GlobalVariable *GV : unused) GV->eraseFromParent();
+    }
+
+    std::array<uint32_t, 8> chachaKey;
+    if (cipher == StringCipher::ChaCha20) {
+        auto *keyData = cast<ConstantDataArray>(getOrCreateStringKey(M)->getInitializer());
+        for (unsigned w = 0; w < 8; ++w) chachaKey[w] = static_cast<uint32_t>(keyData->getElementAsInteger(w));
+    }
+
     // Iterate through all global variables
     for (GlobalVariable &GV : M.globals()) {
         // Skip metadata and globals without initializers
@@ -41,16 +690,38 @@ PreservedAnalyses StringEncryptionPass::run(Module &M, ModuleAnalysisManager &AM
         StringRef data = CDS->getRawDataValues();
         if (data.empty() || data.size() < 4) continue; // Skip very short strings/padding
 
-        // Generate a multi-byte rolling key for this specific string
-        std::array<uint8_t, KEY_LENGTH> key;
-        for (unsigned k = 0; k < KEY_LENGTH; ++k) {
-            key[k] = static_cast<uint8_t>(ObfuscatorUtils::Random::generateRandomIntInRange(1, 255));
+        StringMode stringMode = mode;
+        if (maxSize && data.size() > maxSize) {
+            if (largePolicy == LargeBlobPolicy::Skip) continue;
+            stringMode = largePolicy == LargeBlobPolicy::Lazy ? StringMode::Lazy : StringMode::Eager;
         }
-        
-        // Perform rolling XOR encryption
-        std::vector<uint8_t> encrypted;
-        for (size_t i = 0; i < data.size(); ++i) {
-            encrypted.push_back(static_cast<uint8_t>(data[i]) ^ key[i % KEY_LENGTH]);
+        // Other modules reach a global that is not local without going through
+        // any guard or copy emitted here, so it is decrypted at startup instead.
+        if (!GV.hasLocalLinkage()) stringMode = StringMode::Eager;
+        // Transient and arena mode make the global read-only again once its
+        // uses read copies, which is only sound for a string that was read-only.
+        if ((stringMode == StringMode::Transient || stringMode == StringMode::Arena) && !GV.isConstant())
+            stringMode = StringMode::Eager;
+
+        std::vector<uint8_t> encrypted(data.begin(), data.end());
+        uint64_t packedKey;
+        if (cipher == StringCipher::ChaCha20) {
+            // Encrypt under the module key with a fresh nonce for this string
+            packedKey = (static_cast<uint64_t>(ObfuscatorUtils::Random::generateRandomInt()) << 32) |
+                ObfuscatorUtils::Random::generateRandomInt();
+            ObfuscatorUtils::Crypto::chacha20Xor(encrypted.data(), encrypted.size(), chachaKey, packedKey);
+        } else {
+            // Generate a multi-byte rolling key for this specific string
+            std::array<uint8_t, KEY_LENGTH> key;
+            for (unsigned k = 0; k < KEY_LENGTH; ++k) {
+                key[k] = static_cast<uint8_t>(ObfuscatorUtils::Random::generateRandomIntInRange(1, 255));
+            }
+
+            // Perform rolling XOR encryption in place
+            for (size_t i = 0; i < encrypted.size(); ++i) {
+                encrypted[i] ^= key[i % KEY_LENGTH];
+            }
+            packedKey = packKey(key, M.getDataLayout());
         }
 
         // Replace the plaintext with encrypted data
@@ -58,49 +729,312 @@ PreservedAnalyses StringEncryptionPass::run(Module &M, ModuleAnalysisManager &AM
         GV.setInitializer(newInit);
         
         // CRITICAL: Global must be mutable so the decryption stub can write to it
+        // (transient and arena mode make it constant again for the strings they handle)
         GV.setConstant(false);
         
-        targetStrings.push_back({&GV, key});
+        targetStrings.push_back({&GV, packedKey, stringMode});
         modified = true;
     }
 
-    if (!modified) return PreservedAnalyses::all();
+    if (targetStrings.empty()) return modified ? PreservedAnalyses::none() : PreservedAnalyses::all();
+
+    // Lazy mode: guard every use with an acquire load of the string's flag and
+    // only call into obf.decrypt_once while it is not READY yet. Strings that
+    // are referenced from other globals' initializers have no use site to guard
+    // and stay in the eager constructor below.
+    auto usesMode = [&](StringMode m) {
+        return any_of(targetStrings, [m](const EncryptedString &ES) { return ES.mode == m; });
+    };
+
+    if (usesMode(StringMode::Lazy)) {
+        Function *decryptOnce = nullptr;
+        MDNode *unlikely = MDBuilder(ctx).createBranchWeights(1, 2000);
+        std::vector<EncryptedString> eagerStrings;
+        for (const EncryptedString &ES : targetStrings) {
+            std::vector<Instruction *> users;
+            if (ES.mode != StringMode::Lazy || !collectInstructionUsers(ES.GV, users)) {
+                eagerStrings.push_back(ES);
+                continue;
+            }
+            if (!decryptOnce) decryptOnce = createLazyDecryptor(M, getOrCreateDecryptKernel(M, cipher));
+
+            auto *flag = new GlobalVariable(M, Type::getInt32Ty(ctx), false, GlobalValue::PrivateLinkage,
+                ConstantInt::get(Type::getInt32Ty(ctx), FLAG_ENCRYPTED), "obf.string_flag");
+            flag->setAlignment(Align(4));
+            uint64_t len = ES.GV->getValueType()->getArrayNumElements();
+
+            SmallPtrSet<Instruction *, 8> guarded;
+            for (Instruction *I : users) {
+                // A PHI reads the string on its incoming edge, so guard there.
+                std::vector<Instruction *> guardPoints;
+                if (auto *PN = dyn_cast<PHINode>(I)) {
+                    for (unsigned op = 0; op < PN->getNumIncomingValues(); ++op)
+                        if (refersTo(PN->getIncomingValue(op), ES.GV))
+                            guardPoints.push_back(PN->getIncomingBlock(op)->getTerminator());
+                } else {
+                    guardPoints.push_back(I);
+                }
+                erase_if(guardPoints, [&](Instruction *at) { return !guarded.insert(at).second; });
+                for (Instruction *at : guardPoints) {
+                    IRBuilder<> builder(at);
+                    LoadInst *state = builder.CreateAlignedLoad(builder.getInt32Ty(), flag, MaybeAlign(4), "string_state");
+                    state->setAtomic(AtomicOrdering::Acquire);
+                    Value *pending = builder.CreateICmpNE(state, builder.getInt32(FLAG_READY));
+                    Instruction *slow = SplitBlockAndInsertIfThen(pending, at, false, unlikely);
+                    builder.SetInsertPoint(slow);
+                    builder.CreateCall(decryptOnce, {flag, ES.GV, builder.getInt64(len), builder.getInt64(ES.key)});
+                }
+            }
+        }
+        targetStrings = std::move(eagerStrings);
+        if (targetStrings.empty()) return PreservedAnalyses::none();
+    }
+
+    // Arena mode: the global keeps its ciphertext and stays read-only, so its
+    // pages remain shared between processes. Each string gets a slot holding
+    // the address of its decrypted copy; every use loads the slot with acquire
+    // ordering and only calls obf.decrypt_to_arena while it is still null. The
+    // copies are packed back to back in obf.string_arena, a zero-initialized
+    // buffer sized for all arena strings, so a process only dirties as many
+    // private pages as the strings it actually uses need.
+    if (usesMode(StringMode::Arena)) {
+        Type *ptrTy = PointerType::getUnqual(ctx);
+        Type *i64Ty = Type::getInt64Ty(ctx);
+        std::vector<EncryptedString> arenaStrings, eagerStrings;
+        uint64_t capacity = 0;
+        for (const EncryptedString &ES : targetStrings) {
+            std::vector<Instruction *> users;
+            if (ES.mode != StringMode::Arena || !collectInstructionUsers(ES.GV, users)) {
+                eagerStrings.push_back(ES);
+                continue;
+            }
+            arenaStrings.push_back(ES);
+            capacity += ES.GV->getValueType()->getArrayNumElements() + ES.GV->getAlign().valueOrOne().value() - 1;
+        }
+
+        if (!arenaStrings.empty()) {
+            ArrayType *arenaTy = ArrayType::get(Type::getInt8Ty(ctx), capacity);
+            auto *arena = new GlobalVariable(M, arenaTy, false, GlobalValue::PrivateLinkage,
+                ConstantAggregateZero::get(arenaTy), "obf.string_arena");
+            arena->setAlignment(Align(16));
+            auto *next = new GlobalVariable(M, i64Ty, false, GlobalValue::PrivateLinkage,
+                ConstantInt::get(i64Ty, 0), "obf.arena_next");
+            next->setAlignment(Align(8));
+            Function *decryptToArena = createArenaDecryptor(M, getOrCreateDecryptKernel(M, cipher), arena, next);
+            MDNode *unlikely = MDBuilder(ctx).createBranchWeights(1, 2000);
+
+            for (const EncryptedString &ES : arenaStrings) {
+                ES.GV->setConstant(true);
+                auto *flag = new GlobalVariable(M, Type::getInt32Ty(ctx), false, GlobalValue::PrivateLinkage,
+                    ConstantInt::get(Type::getInt32Ty(ctx), FLAG_ENCRYPTED), "obf.string_flag");
+                flag->setAlignment(Align(4));
+                auto *slot = new GlobalVariable(M, ptrTy, false, GlobalValue::PrivateLinkage,
+                    ConstantPointerNull::get(cast<PointerType>(ptrTy)), "obf.string_slot");
+                slot->setAlignment(Align(8));
+                uint64_t len = ES.GV->getValueType()->getArrayNumElements();
+                uint64_t align = ES.GV->getAlign().valueOrOne().value();
+
+                // Every use must be an instruction operand so it can take the copy.
+                std::vector<ConstantExpr *> exprs;
+                for (User *U : ES.GV->users())
+                    if (auto *CE = dyn_cast<ConstantExpr>(U)) exprs.push_back(CE);
+                for (ConstantExpr *CE : exprs) expandConstantExpr(CE);
+                ES.GV->removeDeadConstantUsers();
+
+                // Load the slot right before each use (or on the incoming edge
+                // for a PHI) and hand the use the copy's address instead.
+                DenseMap<Instruction *, Value *> copies;
+                auto copyAt = [&](Instruction *at) -> Value * {
+                    Value *&copy = copies[at];
+                    if (copy) return copy;
+                    IRBuilder<> builder(at);
+                    LoadInst *current = builder.CreateAlignedLoad(ptrTy, slot, MaybeAlign(8), "string_copy");
+                    current->setAtomic(AtomicOrdering::Acquire);
+                    BasicBlock *guardBlock = current->getParent();
+                    Instruction *slow = SplitBlockAndInsertIfThen(builder.CreateIsNull(current), at, false, unlikely);
+                    builder.SetInsertPoint(slow);
+                    Value *fresh = builder.CreateCall(decryptToArena, {flag, slot, ES.GV,
+                        builder.getInt64(len), builder.getInt64(ES.key), builder.getInt64(align)});
+                    builder.SetInsertPoint(&at->getParent()->front());
+                    PHINode *merged = builder.CreatePHI(ptrTy, 2, "string_ptr");
+                    merged->addIncoming(current, guardBlock);
+                    merged->addIncoming(fresh, slow->getParent());
+                    return copy = merged;
+                };
+
+                std::vector<Use *> uses;
+                for (Use &U : ES.GV->uses()) uses.push_back(&U);
+                for (Use *U : uses) {
+                    if (auto *PN = dyn_cast<PHINode>(U->getUser()))
+                        U->set(copyAt(PN->getIncomingBlock(*U)->getTerminator()));
+                    else
+                        U->set(copyAt(cast<Instruction>(U->getUser())));
+                }
+            }
+        }
+        targetStrings = std::move(eagerStrings);
+        if (targetStrings.empty()) return PreservedAnalyses::none();
+    }
+
+    // Transient mode: the global keeps its ciphertext and stays read-only. A
+    // use outside loops decrypts right before and wipes right after, so those
+    // windows never overlap and the uses of every string share one stack slot
+    // per function, sized to the largest of them (an instruction with several
+    // string operands takes one slot each). Uses inside a loop share one
+    // decryption in the outermost preheader and a wipe on every loop exit; the
+    // string then keeps a buffer of its own in that function, within the
+    // per-function budget.
+    if (usesMode(StringMode::Transient)) {
+        FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        Function *kernel = getOrCreateDecryptKernel(M, cipher);
+        uint64_t budget = getTransientBudget();
+        DenseMap<Function *, uint64_t> bufferBytes;
+        DenseMap<Function *, std::vector<AllocaInst *>> slots;
+        DenseMap<Instruction *, unsigned> slotsTaken;
+        std::vector<EncryptedString> eagerStrings;
+        for (const EncryptedString &ES : targetStrings) {
+            auto *arrTy = cast<ArrayType>(ES.GV->getValueType());
+            uint64_t len = arrTy->getNumElements();
+            std::vector<Use *> uses;
+            for (Use &U : ES.GV->uses()) uses.push_back(&U);
+            if (ES.mode != StringMode::Transient || len > MAX_TRANSIENT_BYTES ||
+                !all_of(uses, [&](Use *U) { return isTransientUse(*U, FAM); })) {
+                eagerStrings.push_back(ES);
+                continue;
+            }
+
+            // Hoist out of the outermost enclosing loop that has a preheader.
+            std::vector<Loop *> regions;
+            SmallPtrSet<Function *, 4> looped;
+            for (Use *U : uses) {
+                auto *I = cast<Instruction>(U->getUser());
+                LoopInfo &LI = FAM.getResult<LoopAnalysis>(*I->getFunction());
+                Loop *region = nullptr;
+                for (Loop *L = LI.getLoopFor(I->getParent()); L; L = L->getParentLoop())
+                    if (L->getLoopPreheader()) region = L;
+                regions.push_back(region);
+                if (region) looped.insert(I->getFunction());
+            }
+            if (any_of(looped, [&](Function *F) { return bufferBytes.lookup(F) + len > budget; })) {
+                eagerStrings.push_back(ES);
+                continue;
+            }
+            for (Function *F : looped) bufferBytes[F] += len;
+            ES.GV->setConstant(true);
+
+            DenseMap<Function *, AllocaInst *> buffers;
+            SmallPtrSet<Loop *, 4> hoisted;
+            auto emitDecrypt = [&](IRBuilder<> &B, Value *buf) {
+                B.CreateMemCpy(buf, Align(1), ES.GV, Align(1), len);
+                B.CreateCall(kernel, {buf, B.getInt64(len), B.getInt64(ES.key)});
+            };
+            auto emitWipe = [&](Instruction *before, Value *buf) {
+                IRBuilder<> B(before);
+                B.CreateMemSet(buf, B.getInt8(0), len, Align(1), /*isVolatile=*/true);
+            };
+
+            for (size_t i = 0; i < uses.size(); ++i) {
+                Use *U = uses[i];
+                Loop *region = regions[i];
+                auto *I = cast<Instruction>(U->getUser());
+                Function *F = I->getFunction();
+                IRBuilder<> entryBuilder(&*F->getEntryBlock().getFirstInsertionPt());
+
+                // The string's own buffer in functions where it is hoisted,
+                // a shared slot everywhere else
+                AllocaInst *buf;
+                if (looped.count(F)) {
+                    AllocaInst *&own = buffers[F];
+                    if (!own) own = entryBuilder.CreateAlloca(arrTy, nullptr, "str_buf");
+                    buf = own;
+                } else {
+                    std::vector<AllocaInst *> &fnSlots = slots[F];
+                    unsigned idx = slotsTaken[I]++;
+                    if (idx == fnSlots.size())
+                        fnSlots.push_back(entryBuilder.CreateAlloca(arrTy, nullptr, "str_slot"));
+                    buf = fnSlots[idx];
+                    if (buf->getAllocatedType()->getArrayNumElements() < len)
+                        buf->setAllocatedType(ArrayType::get(arrTy->getElementType(), len));
+                }
+
+                if (region) {
+                    if (hoisted.insert(region).second) {
+                        IRBuilder<> B(region->getLoopPreheader()->getTerminator());
+                        emitDecrypt(B, buf);
+                        SmallVector<BasicBlock *, 4> exits;
+                        region->getUniqueExitBlocks(exits);
+                        for (BasicBlock *exit : exits) emitWipe(&*exit->getFirstInsertionPt(), buf);
+                        for (BasicBlock *BB : region->blocks())
+                            if (isa<ReturnInst>(BB->getTerminator())) emitWipe(BB->getTerminator(), buf);
+                    }
+                } else {
+                    IRBuilder<> B(I);
+                    emitDecrypt(B, buf);
+                    if (I->isTerminator()) {
+                        for (BasicBlock *succ : successors(I)) emitWipe(&*succ->getFirstInsertionPt(), buf);
+                    } else {
+                        emitWipe(I->getNextNode(), buf);
+                    }
+                }
+                U->set(buf);
+            }
+        }
+        targetStrings = std::move(eagerStrings);
+        if (targetStrings.empty()) return PreservedAnalyses::none();
+    }
+
+    // Describe every string in a constant table of { data, length, key/nonce }
+    // entries. The constructor is one loop over the table, so its size no
+    // longer depends on how many strings or bytes the module contains.
+    Type *ptrTy = PointerType::getUnqual(ctx);
+    Type *i64Ty = Type::getInt64Ty(ctx);
+    StructType *entryTy = StructType::get(ctx, {ptrTy, i64Ty, i64Ty});
+    std::vector<Constant *> entries;
+    entries.reserve(targetStrings.size());
+    for (const EncryptedString &ES : targetStrings) {
+        entries.push_back(ConstantStruct::get(entryTy, {ES.GV,
+            ConstantInt::get(i64Ty, ES.GV->getValueType()->getArrayNumElements()),
+            ConstantInt::get(i64Ty, ES.key)}));
+    }
+    ArrayType *tableTy = ArrayType::get(entryTy, entries.size());
+    auto *table = new GlobalVariable(M, tableTy, true, GlobalValue::PrivateLinkage,
+        ConstantArray::get(tableTy, entries), "obf.string_table");
+    auto *count = new GlobalVariable(M, i64Ty, true, GlobalValue::PrivateLinkage,
+        ConstantInt::get(i64Ty, entries.size()), "obf.string_count");
 
     // Create a decryption function that runs at program startup
     FunctionType *funcType = FunctionType::get(Type::getVoidTy(ctx), false);
     Function *decryptFunc = Function::Create(funcType, GlobalValue::InternalLinkage, "obf.decrypt_strings", &M);
-    
-    // Prevent the optimizer from removing this logic
     decryptFunc->addFnAttr(Attribute::NoInline);
-    decryptFunc->addFnAttr(Attribute::OptimizeNone);
 
     BasicBlock *entryBlock = BasicBlock::Create(ctx, "entry", decryptFunc);
+    BasicBlock *loopBlock = BasicBlock::Create(ctx, "decrypt", decryptFunc);
+    BasicBlock *exitBlock = BasicBlock::Create(ctx, "exit", decryptFunc);
     IRBuilder<> builder(entryBlock);
 
-    for (size_t i = 0; i < targetStrings.size(); ++i) {
-        GlobalVariable *GV = targetStrings[i].GV;
-        const auto &key = targetStrings[i].key;
-        
-        Type *valueType = GV->getValueType();
-        if (!valueType->isArrayTy()) continue;
+    // The entry count is read with a volatile load. GlobalOpt cannot evaluate a
+    // constructor that performs one, so the plaintext is never folded back
+    // into the initializers, while the loop itself stays fully optimizable.
+    Value *numEntries = builder.CreateLoad(i64Ty, count, true, "num_strings");
+    builder.CreateBr(loopBlock);
 
-        uint64_t arrSize = valueType->getArrayNumElements();
-        
-        // Decrypt the string in-place using the rolling key
-        for (uint64_t j = 0; j < arrSize; ++j) {
-            Value *idxList[] = {builder.getInt64(0), builder.getInt64(j)};
-            Value *gep = builder.CreateInBoundsGEP(valueType, GV, idxList);
-            
-            // CRITICAL FIX: Make the load and store VOLATILE (the 'true' argument).
-            // This stops LLVM's GlobalOpt from statically evaluating our decryption routine!
-            LoadInst *load = builder.CreateLoad(builder.getInt8Ty(), gep, true); 
-            Value *xorVal = builder.CreateXor(load, builder.getInt8(key[j % KEY_LENGTH]));
-            builder.CreateStore(xorVal, gep, true);
-        }
-    }
-    
+    builder.SetInsertPoint(loopBlock);
+    PHINode *idx = builder.CreatePHI(i64Ty, 2, "idx");
+    idx->addIncoming(builder.getInt64(0), entryBlock);
+    Value *data = builder.CreateLoad(ptrTy, builder.CreateInBoundsGEP(tableTy, table,
+        {builder.getInt64(0), idx, builder.getInt32(0)}), "data");
+    Value *len = builder.CreateLoad(i64Ty, builder.CreateInBoundsGEP(tableTy, table,
+        {builder.getInt64(0), idx, builder.getInt32(1)}), "len");
+    Value *key = builder.CreateLoad(i64Ty, builder.CreateInBoundsGEP(tableTy, table,
+        {builder.getInt64(0), idx, builder.getInt32(2)}), "key");
+    builder.CreateCall(getOrCreateDecryptKernel(M, cipher), {data, len, key});
+    Value *nextIdx = builder.CreateAdd(idx, builder.getInt64(1));
+    idx->addIncoming(nextIdx, loopBlock);
+    builder.CreateCondBr(builder.CreateICmpULT(nextIdx, numEntries), loopBlock, exitBlock);
+
+    builder.SetInsertPoint(exitBlock);
     builder.CreateRetVoid();
-    
+
     // Append to global constructors to ensure it runs before main()
     appendToGlobalCtors(M, decryptFunc, 0);
 
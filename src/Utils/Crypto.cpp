@@ -2,6 +2,19 @@
 
 namespace ObfuscatorUtils {
 
+    namespace {
+        inline uint32_t rotl32(uint32_t v, int n) {
+            return (v << n) | (v >> (32 - n));
+        }
+
+        inline void quarterRound(uint32_t* x, int a, int b, int c, int d) {
+            x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 16);
+            x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 12);
+            x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 8);
+            x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 7);
+        }
+    } // namespace
+
     std::vector<uint8_t> Crypto::xorEncrypt(const std::string& plaintext, uint8_t key) {
         std::vector<uint8_t> ciphertext;
         ciphertext.reserve(plaintext.size());
@@ -26,4 +39,48 @@ namespace ObfuscatorUtils {
         return plaintext;
     }
 
+    std::array<uint8_t, 64> Crypto::chacha20Block(const std::array<uint32_t, 8>& key, uint64_t counter, uint64_t nonce) {
+        // "expand 32-byte k", the key, then the block counter and the nonce
+        uint32_t state[16] = {
+            0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+            key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+            static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+            static_cast<uint32_t>(nonce), static_cast<uint32_t>(nonce >> 32),
+        };
+
+        uint32_t x[16];
+        for (int i = 0; i < 16; ++i) x[i] = state[i];
+
+        // 10 double rounds: a column round followed by a diagonal round
+        for (int round = 0; round < 10; ++round) {
+            quarterRound(x, 0, 4, 8, 12);
+            quarterRound(x, 1, 5, 9, 13);
+            quarterRound(x, 2, 6, 10, 14);
+            quarterRound(x, 3, 7, 11, 15);
+            quarterRound(x, 0, 5, 10, 15);
+            quarterRound(x, 1, 6, 11, 12);
+            quarterRound(x, 2, 7, 8, 13);
+            quarterRound(x, 3, 4, 9, 14);
+        }
+
+        // Serialize the words little-endian regardless of the host
+        std::array<uint8_t, 64> block;
+        for (int i = 0; i < 16; ++i) {
+            uint32_t word = x[i] + state[i];
+            for (int b = 0; b < 4; ++b) {
+                block[i * 4 + b] = static_cast<uint8_t>(word >> (8 * b));
+            }
+        }
+        return block;
+    }
+
+    void Crypto::chacha20Xor(uint8_t* data, size_t length, const std::array<uint32_t, 8>& key, uint64_t nonce) {
+        for (size_t offset = 0; offset < length; offset += 64) {
+            std::array<uint8_t, 64> block = chacha20Block(key, offset / 64, nonce);
+            for (size_t i = 0; i < 64 && offset + i < length; ++i) {
+                data[offset + i] ^= block[i];
+            }
+        }
+    }
+
 } // namespace ObfuscatorUtils
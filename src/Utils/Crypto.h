@@ -1,8 +1,10 @@
 #ifndef OBFUSCATOR_CRYPTO_H
 #define OBFUSCATOR_CRYPTO_H
 
+#include <array>
 #include <string>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 namespace ObfuscatorUtils {
@@ -13,6 +15,14 @@ namespace ObfuscatorUtils {
 
         // Decrypt an XOR-encrypted byte array back to a string
         static std::string xorDecrypt(const std::vector<uint8_t>& ciphertext, uint8_t key);
+
+        // XOR the ChaCha20 keystream for (key, nonce) into data in place, using the
+        // original layout with a 64-bit block counter starting at 0 and a 64-bit
+        // nonce. Encryption and decryption are the same operation.
+        static void chacha20Xor(uint8_t* data, size_t length, const std::array<uint32_t, 8>& key, uint64_t nonce);
+
+        // Compute one 64-byte ChaCha20 keystream block
+        static std::array<uint8_t, 64> chacha20Block(const std::array<uint32_t, 8>& key, uint64_t counter, uint64_t nonce);
     };
 } // namespace ObfuscatorUtils
 
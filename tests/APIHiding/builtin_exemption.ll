@@ -0,0 +1,59 @@
+; RUN: opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -S < %s | FileCheck %s
+; RUN: env HIDEIR_API_LIBCALLS=hide opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -S < %s | FileCheck %s --check-prefix=HIDE
+; RUN: env HIDEIR_API_LIBCALLS=late opt -load-pass-plugin=%{api_hiding_plugin} -passes="default<O2>" -S < %s | FileCheck %s --check-prefix=LATE
+; RUN: rm -f %t
+; RUN: env HIDEIR_API_REPORT=%t opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -disable-output < %s
+; RUN: FileCheck %s --check-prefix=REPORT < %t
+
+; Library calls that TargetLibraryInfo recognizes and the optimizer lowers
+; (memcpy/memset, sqrt/fabs, string functions on constant strings) stay direct
+; by default. "hide" hides them anyway; "late" defers the pass to the end of
+; the pipeline, after instcombine has lowered them. HIDEIR_API_REPORT lists
+; every symbol with its outcome and reason.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+declare ptr @memcpy(ptr, ptr, i64)
+declare double @sqrt(double)
+declare i64 @strlen(ptr)
+declare i32 @puts(ptr)
+
+@.str = private unnamed_addr constant [6 x i8] c"hello\00"
+
+define i64 @work(ptr %dst, ptr %s, double %x) {
+entry:
+  %m = call ptr @memcpy(ptr %dst, ptr @.str, i64 6)
+  %r = call double @sqrt(double %x)
+  %k = call i64 @strlen(ptr @.str)
+  %n = call i64 @strlen(ptr %s)
+  %p = call i32 @puts(ptr %dst)
+  %sum = add i64 %k, %n
+  ret i64 %sum
+}
+
+; CHECK-LABEL: define i64 @work(
+; CHECK: call ptr @memcpy(ptr %dst, ptr @.str, i64 6)
+; CHECK: call double @sqrt(double %x)
+; CHECK: call i64 @strlen(ptr @.str)
+; CHECK: load atomic ptr, ptr @obf.api_slot.strlen acquire
+; CHECK: call i64 %{{.*}}(ptr %s)
+; CHECK: load atomic ptr, ptr @obf.api_slot.puts acquire
+
+; HIDE-LABEL: define i64 @work(
+; HIDE: load atomic ptr, ptr @obf.api_slot.memcpy acquire
+; HIDE: load atomic ptr, ptr @obf.api_slot.sqrt acquire
+; HIDE: load atomic ptr, ptr @obf.api_slot.strlen acquire
+; HIDE: load atomic ptr, ptr @obf.api_slot.puts acquire
+; HIDE-NOT: call {{.*}} @strlen(
+
+; LATE-NOT: @obf.api_slot.memcpy
+; LATE-LABEL: define i64 @work(
+; LATE-NOT: call ptr @memcpy
+; LATE: load atomic ptr, ptr @obf.api_slot.puts acquire
+
+; REPORT: # <stdin>
+; REPORT-NEXT: hidden{{[[:space:]]}}puts{{[[:space:]]}}1{{[[:space:]]}}dlsym
+; REPORT-NEXT: hidden{{[[:space:]]}}strlen{{[[:space:]]}}1{{[[:space:]]}}dlsym
+; REPORT-NEXT: kept{{[[:space:]]}}memcpy{{[[:space:]]}}1{{[[:space:]]}}memory builtin
+; REPORT-NEXT: kept{{[[:space:]]}}sqrt{{[[:space:]]}}1{{[[:space:]]}}math builtin
+; REPORT-NEXT: kept{{[[:space:]]}}strlen{{[[:space:]]}}1{{[[:space:]]}}constant string argument
@@ -10,13 +10,16 @@ declare i32 @puts(ptr)
 define void @caller() {
 entry:
   ; CHECK: @obf.api.puts = private unnamed_addr constant [5 x i8] c"puts\00"
-  ; This direct call should be replaced with an indirect call via dlsym
+  ; This direct call should be replaced with an indirect call through a slot
+  ; that the resolver fills in with dlsym
+  ; CHECK-LABEL: define void @caller()
   ; CHECK-NOT: call i32 @puts(
-  ; CHECK: call ptr @dlsym(
   ; CHECK: call i32 %{{.*}}(ptr @.str)
   call i32 @puts(ptr @.str)
   ret void
 }
 
-; Verify dlsym is declared
-; CHECK: declare ptr @dlsym(ptr, ptr)
+; Verify dlsym is declared and the resolver calls it
+; CHECK-DAG: declare ptr @dlsym(ptr, ptr)
+; CHECK-LABEL: define internal ptr @obf.api_resolve(
+; CHECK: call ptr @dlsym(ptr null, ptr %1)
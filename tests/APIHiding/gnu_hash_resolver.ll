@@ -0,0 +1,49 @@
+; RUN: env HIDEIR_API_RESOLVER=gnuhash opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -S < %s | FileCheck %s
+
+; With the GNU-hash resolver no symbol names are emitted. Each import is
+; identified by its DT_GNU_HASH value plus an FNV-1a check hash, and the first
+; call through any slot resolves the whole import set in one dl_iterate_phdr
+; pass.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @puts(ptr)
+declare i64 @strlen(ptr)
+
+@.str = private unnamed_addr constant [6 x i8] c"hello\00"
+
+define i64 @caller(ptr %s) {
+entry:
+  %a = call i32 @puts(ptr @.str)
+  %n = call i64 @strlen(ptr %s)
+  ret i64 %n
+}
+
+; CHECK-NOT: c"puts\00"
+; CHECK-NOT: c"strlen\00"
+; CHECK: @obf.api_hashes = private unnamed_addr constant [2 x i32] [i32 2090629905, i32 479443869]
+; CHECK-NEXT: @obf.api_checks = private unnamed_addr constant [2 x i32] [i32 -1670917593, i32 1488600471]
+; CHECK-NEXT: @obf.api_slots = private global [2 x ptr] zeroinitializer, align 8
+
+; CHECK-LABEL: define i64 @caller(
+; CHECK: %[[P1:api_ptr[0-9]*]] = load atomic ptr, ptr {{.*}}@obf.api_slots{{.*}} acquire, align 8
+; CHECK: call ptr @obf.api_resolve_all(ptr {{.*}}@obf.api_slots{{.*}})
+; CHECK: load atomic ptr, ptr getelementptr inbounds ([2 x ptr], ptr @obf.api_slots, i64 0, i64 1) acquire
+; CHECK: call ptr @obf.api_resolve_all(ptr getelementptr inbounds ([2 x ptr], ptr @obf.api_slots, i64 0, i64 1))
+
+; The scan looks up DT_GNU_HASH, DT_SYMTAB, DT_STRTAB and DT_VERSYM.
+; CHECK-LABEL: define internal i32 @obf.api_scan_object(ptr %0, i64 %1, ptr %2)
+; CHECK: icmp eq i64 %{{.*}}, 1879047925
+; CHECK: icmp eq i64 %{{.*}}, 6
+; CHECK: icmp eq i64 %{{.*}}, 5
+; CHECK: icmp eq i64 %{{.*}}, 1879048176
+; CHECK: call ptr %{{.*}}(i64 %{{.*}})
+; CHECK: store atomic ptr %target, ptr %{{.*}} release
+
+; CHECK-LABEL: define internal ptr @obf.api_resolve_all(ptr %0)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: call i32 @dl_iterate_phdr(ptr @obf.api_scan_object, ptr null)
+; CHECK-NEXT: %[[SLOT:.*]] = load atomic ptr, ptr %0 acquire
+; CHECK-NEXT: ret ptr %[[SLOT]]
+
+; CHECK-NOT: @dlsym
@@ -0,0 +1,42 @@
+; RUN: opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -S < %s | FileCheck %s
+
+; Every imported symbol gets exactly one name string and one pointer slot, no
+; matter how many call sites it has. Each call site loads the slot and only
+; calls the shared resolver while it is still null.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @puts(ptr)
+declare i64 @strlen(ptr)
+
+@.str = private unnamed_addr constant [6 x i8] c"hello\00"
+
+define i64 @caller(ptr %s) {
+entry:
+  %a = call i32 @puts(ptr @.str)
+  %b = call i32 @puts(ptr @.str)
+  %n = call i64 @strlen(ptr %s)
+  ret i64 %n
+}
+
+; CHECK: @obf.api.puts = private unnamed_addr constant [5 x i8] c"puts\00"
+; CHECK-NEXT: @obf.api_slot.puts = private global ptr null, align 8
+; CHECK-NEXT: @obf.api.strlen = private unnamed_addr constant [7 x i8] c"strlen\00"
+; CHECK-NEXT: @obf.api_slot.strlen = private global ptr null, align 8
+; CHECK-NOT: @obf.api
+
+; CHECK-LABEL: define i64 @caller(
+; CHECK: %[[P1:api_ptr[0-9]*]] = load atomic ptr, ptr @obf.api_slot.puts acquire, align 8
+; CHECK-NEXT: %[[NULL1:.*]] = icmp eq ptr %[[P1]], null
+; CHECK-NEXT: br i1 %[[NULL1]], label %{{.*}}, label %{{.*}}, !prof
+; CHECK: call ptr @obf.api_resolve(ptr @obf.api_slot.puts,
+; CHECK: %[[T1:api_target[0-9]*]] = phi ptr [ %[[P1]], %{{.*}} ], [ %{{.*}}, %{{.*}} ]
+; CHECK-NEXT: call i32 %[[T1]](ptr @.str)
+; CHECK: load atomic ptr, ptr @obf.api_slot.puts acquire
+; CHECK: load atomic ptr, ptr @obf.api_slot.strlen acquire
+; CHECK: call ptr @obf.api_resolve(ptr @obf.api_slot.strlen,
+; CHECK-NOT: call ptr @dlsym
+
+; CHECK-LABEL: define internal ptr @obf.api_resolve(ptr %0, ptr %1)
+; CHECK: %[[SYM:.*]] = call ptr @dlsym(ptr null, ptr %1)
+; CHECK-NEXT: store atomic ptr %[[SYM]], ptr %0 release
@@ -0,0 +1,100 @@
+; RUN: opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -S < %s | FileCheck %s
+; RUN: env HIDEIR_API_HOT_CALL_RATIO=4 opt -load-pass-plugin=%{api_hiding_plugin} -passes="EnterpriseAPIHiding" -S < %s | FileCheck %s --check-prefix=HOT
+
+; Calls inside a loop load (and if needed resolve) their import slot once in
+; the preheader of the outermost loop; calls to the same symbol in the nest
+; share that value. With HIDEIR_API_HOT_CALL_RATIO, calls in blocks that run
+; at least that many times per invocation stay direct. A loop without a
+; preheader resolves at the end of the entry block, which stays valid when the
+; entry block itself starts with a hidden call.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i64 @strlen(ptr)
+declare i32 @puts(ptr)
+
+@.str = private unnamed_addr constant [6 x i8] c"hello\00"
+
+define i64 @sum(i64 %n, ptr %s) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %acc = phi i64 [ 0, %entry ], [ %acc.inner, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %acc.in = phi i64 [ %acc, %outer ], [ %acc.inner, %inner ]
+  %len = call i64 @strlen(ptr %s)
+  %acc.inner = add i64 %acc.in, %len
+  %j.next = add i64 %j, 1
+  %j.done = icmp eq i64 %j.next, %n
+  br i1 %j.done, label %outer.latch, label %inner
+
+outer.latch:
+  %len2 = call i64 @strlen(ptr %s)
+  %i.next = add i64 %i, 1
+  %i.done = icmp eq i64 %i.next, %n
+  br i1 %i.done, label %exit, label %outer
+
+exit:
+  %r = call i32 @puts(ptr @.str)
+  ret i64 %acc.inner
+}
+
+define i64 @nopre(i1 %c, i64 %n, ptr %s) {
+entry:
+  %r = call i32 @puts(ptr @.str)
+  br i1 %c, label %loop, label %side
+
+side:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ 1, %side ], [ %i.next, %loop ]
+  %len = call i64 @strlen(ptr %s)
+  %i.next = add i64 %i, %len
+  %done = icmp uge i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i64 %i.next
+}
+
+; CHECK-LABEL: define i64 @sum(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %[[P:api_ptr[0-9]*]] = load atomic ptr, ptr @obf.api_slot.strlen acquire
+; CHECK-NEXT: %[[NULL:.*]] = icmp eq ptr %[[P]], null
+; CHECK-NEXT: br i1 %[[NULL]]
+; CHECK: call ptr @obf.api_resolve(ptr @obf.api_slot.strlen,
+; CHECK: %[[T:api_target[0-9]*]] = phi ptr [ %[[P]], %entry ], [ %{{.*}}, %{{.*}} ]
+; CHECK-NEXT: br label %outer
+; CHECK: inner:
+; CHECK-NOT: load atomic
+; CHECK: call i64 %[[T]](ptr %s)
+; CHECK: outer.latch:
+; CHECK-NEXT: call i64 %[[T]](ptr %s)
+; CHECK: exit:
+; CHECK-NEXT: load atomic ptr, ptr @obf.api_slot.puts acquire
+
+; HOT-NOT: @obf.api_slot.strlen
+; HOT-LABEL: define i64 @sum(
+; HOT: inner:
+; HOT: call i64 @strlen(ptr %s)
+; HOT: outer.latch:
+; HOT: call i64 @strlen(ptr %s)
+; HOT: exit:
+; HOT-NEXT: load atomic ptr, ptr @obf.api_slot.puts acquire
+
+; CHECK-LABEL: define i64 @nopre(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: load atomic ptr, ptr @obf.api_slot.puts acquire
+; CHECK: call i32 %{{.*}}(ptr @.str)
+; CHECK-NEXT: %[[Q:api_ptr[0-9]*]] = load atomic ptr, ptr @obf.api_slot.strlen acquire
+; CHECK: %[[U:api_target[0-9]*]] = phi ptr [ %[[Q]], %{{.*}} ], [ %{{.*}}, %{{.*}} ]
+; CHECK-NEXT: br i1 %c, label %loop, label %side
+; CHECK: loop:
+; CHECK-NOT: load atomic
+; CHECK: call i64 %[[U]](ptr %s)
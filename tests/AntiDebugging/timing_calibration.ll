@@ -0,0 +1,65 @@
+; RUN: env HIDEIR_TIMING_PROB=1.0 HIDEIR_TIMING_CONFIRM=1 opt -load-pass-plugin=%{anti_debug_plugin} -passes="EnterpriseAntiDebugging" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TIMING_PROB=1.0 HIDEIR_TIMING_LIMIT_MS=0 opt -load-pass-plugin=%{anti_debug_plugin} -passes="EnterpriseAntiDebugging" -S < %s | FileCheck %s --check-prefix=FIXED
+
+; The timing checks compare against obf.timing_threshold.250, which a
+; constructor sets to 250 ms worth of cycle counter ticks, timed against
+; clock_gettime(CLOCK_MONOTONIC). Both are shared by every module of the image
+; built with the same limit, so calibration runs once. With confirmation a
+; slow block only traps when its obf.timing_strike flag is still set from its
+; previous run; a fast run clears the flag. A limit of 0 keeps the fixed
+; threshold.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @work(i32 %x) {
+entry:
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 1
+  ret i32 %b
+}
+
+; CHECK: @obf.timing_threshold.250 = linkonce_odr hidden global i64 268435455, comdat
+; CHECK: @llvm.global_ctors = {{.*}}@obf.anti_debug_init{{.*}} { i32 0, ptr @obf.timing_calibrate.250, ptr @obf.timing_calibrate.250 }
+; CHECK: @obf.timing_strike = private global i8 0
+
+; CHECK-LABEL: define i32 @work(i32 %x)
+; CHECK: [[START:%.*]] = call i64 @llvm.readcyclecounter()
+; CHECK: [[END:%.*]] = call i64 @llvm.readcyclecounter()
+; CHECK-NEXT: [[DIFF:%.*]] = sub i64 [[END]], [[START]]
+; CHECK-NEXT: [[LIMIT:%.*]] = load i64, ptr @obf.timing_threshold.250
+; CHECK-NEXT: [[SLOW:%.*]] = icmp ugt i64 [[DIFF]], [[LIMIT]]
+; CHECK-NEXT: br i1 [[SLOW]], label %time_confirm, label %time_fast
+; CHECK: time_fast:
+; CHECK-NEXT: [[ARMED:%.*]] = load atomic i8, ptr @obf.timing_strike monotonic
+; CHECK-NEXT: [[CLEAR:%.*]] = icmp ne i8 [[ARMED]], 0
+; CHECK-NEXT: br i1 [[CLEAR]], label %time_clear, label %time_cont
+; CHECK: time_clear:
+; CHECK-NEXT: store atomic i8 0, ptr @obf.timing_strike monotonic
+; CHECK-NEXT: br label %time_cont
+; CHECK: time_confirm:
+; CHECK-NEXT: [[PREV:%.*]] = load atomic i8, ptr @obf.timing_strike monotonic
+; CHECK-NEXT: [[AGAIN:%.*]] = icmp ne i8 [[PREV]], 0
+; CHECK-NEXT: store atomic i8 1, ptr @obf.timing_strike monotonic
+; CHECK-NEXT: br i1 [[AGAIN]], label %time_trap, label %time_cont
+; CHECK: time_trap:
+; CHECK-NEXT: call void @llvm.trap()
+
+; CHECK-LABEL: define linkonce_odr hidden void @obf.timing_calibrate.250() comdat
+; CHECK: load i64, ptr @obf.timing_threshold.250
+; CHECK: br i1 %{{.*}}, label %calibrate.done, label %calibrate.begin
+; CHECK: call i32 @clock_gettime(i32 1, ptr %calibrate.clock)
+; CHECK: calibrate.spin:
+; CHECK: calibrate.rate:
+; CHECK: %ticks_per_ms = udiv i64
+; CHECK: calibrate.pairs:
+; CHECK: calibrate.store:
+; CHECK-NEXT: [[SCALED:%.*]] = mul i64 %ticks_per_ms, 250
+; CHECK-NEXT: [[THRESHOLD:%.*]] = add i64 [[SCALED]], %{{.*}}
+; CHECK-NEXT: store i64 [[THRESHOLD]], ptr @obf.timing_threshold.250
+
+; FIXED-NOT: @obf.timing_strike
+; FIXED-NOT: @obf.timing_threshold
+; FIXED-LABEL: define i32 @work(i32 %x)
+; FIXED: icmp ugt i64 %{{.*}}, 268435455
+; FIXED-NEXT: br i1 %{{.*}}, label %time_trap, label %time_cont
+; FIXED-NOT: @obf.timing_calibrate
@@ -0,0 +1,76 @@
+; RUN: env HIDEIR_TIMING_PROB=1.0 HIDEIR_TIMING_BUDGET=2 opt -load-pass-plugin=%{anti_debug_plugin} -passes="EnterpriseAntiDebugging" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TIMING_PROB=1.0 HIDEIR_TIMING_BUDGET=1 opt -load-pass-plugin=%{anti_debug_plugin} -passes="EnterpriseAntiDebugging" -S < %s | FileCheck %s --check-prefix=BUDGET1
+
+; Timing checks stay out of loops: @sum's entry (the loop preheader) and exit
+; are timed, once per call each, but not the loop body. The budget of two
+; checks per call stops @chain after its first two blocks; with a budget of
+; one only the entry blocks are timed. The entry check starts after the
+; allocas.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @sum(ptr %p, i32 %n) {
+entry:
+  %slot = alloca i32
+  %start = load i32, ptr %p
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %acc = phi i32 [ %start, %entry ], [ %add, %loop ]
+  %gep = getelementptr i32, ptr %p, i32 %i
+  %v = load i32, ptr %gep
+  %add = add i32 %acc, %v
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %res = mul i32 %add, 3
+  ret i32 %res
+}
+
+define i32 @chain(i32 %x) {
+b0:
+  %v0 = add i32 %x, 1
+  br label %b1
+b1:
+  %v1 = add i32 %v0, 1
+  br label %b2
+b2:
+  %v2 = add i32 %v1, 1
+  br label %b3
+b3:
+  %v3 = add i32 %v2, 1
+  ret i32 %v3
+}
+
+; CHECK-LABEL: define i32 @sum(ptr %p, i32 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %slot = alloca i32
+; CHECK-NEXT: call i64 @llvm.readcyclecounter()
+; CHECK: br i1 %{{.*}}, label %time_trap, label %time_cont
+; CHECK: loop:
+; CHECK-NOT: readcyclecounter
+; CHECK: exit:
+; CHECK-NEXT: call i64 @llvm.readcyclecounter()
+; CHECK: time_trap:
+
+; CHECK-LABEL: define i32 @chain(i32 %x)
+; CHECK: b0:
+; CHECK-NEXT: call i64 @llvm.readcyclecounter()
+; CHECK: b1:
+; CHECK-NEXT: call i64 @llvm.readcyclecounter()
+; CHECK: b2:
+; CHECK-NOT: readcyclecounter
+; CHECK: time_trap:
+
+; BUDGET1-LABEL: define i32 @sum(ptr %p, i32 %n)
+; BUDGET1: call i64 @llvm.readcyclecounter()
+; BUDGET1: exit:
+; BUDGET1-NEXT: %res = mul i32 %add, 3
+; BUDGET1-LABEL: define i32 @chain(i32 %x)
+; BUDGET1: b0:
+; BUDGET1-NEXT: call i64 @llvm.readcyclecounter()
+; BUDGET1: b1:
+; BUDGET1-NEXT: %v1 = add i32 %v0, 1
@@ -0,0 +1,50 @@
+; RUN: env HIDEIR_TAMPER_HASH=crc32c opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TAMPER_HASH=crc32c HIDEIR_TAMPER_BASELINE=postlink opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=POSTLINK
+; RUN: env HIDEIR_TAMPER_HASH=crc32c HIDEIR_TAMPER_BASELINE=postlink opt -mtriple=i686-unknown-linux-gnu -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=WIDE
+
+; The CRC32C kernel hashes 32-byte blocks in four crc32 lanes, the last
+; block ending at the hash length, and lengths below 32 bytewise. The
+; constructor gets the instruction's target feature too. Post-link tables
+; name the kernel in their magic. Without the instruction (here on i686) the
+; checks fall back to the multiply-add kernel.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @fast(i32 %x) #0 {
+entry:
+  %res = mul i32 %x, 3
+  ret i32 %res
+}
+
+attributes #0 = { "target-features"="+crc32,+sse4.2" }
+
+; CHECK-LABEL: define i32 @fast(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: br i1 true, label %hash.words, label %hash.bytes
+; CHECK: hash.words:
+; CHECK: %hash.off = phi i32 [ 0, %entry ], [ [[NEXT:%.*]], %hash.words ]
+; CHECK-COUNT-4: %hash.lane{{[0-9]*}} = phi i32 [ -1, %entry ]
+; CHECK-COUNT-4: call i64 @llvm.x86.sse42.crc32.64.64(i64 %{{.*}}, i64 %{{.*}})
+; CHECK: [[NEXT]] = select i1 %{{.*}}, i32 %{{.*}}, i32 32
+; CHECK: br i1 %{{.*}}, label %hash.words, label %hash.words.end
+; CHECK: hash.words.end:
+; CHECK-COUNT-3: call i64 @llvm.x86.sse42.crc32.64.64
+; CHECK: hash.done:
+; CHECK: xor i32 %hash.result, -1
+; CHECK: load volatile i32, ptr @obf.expected_hash.fast
+; CHECK: hash.loop:
+; CHECK: call i32 @llvm.x86.sse42.crc32.32.8(i32 %hash.val, i8 %{{.*}})
+; CHECK: define internal void @obf.tamper_init() [[INIT:#[0-9]+]]
+; CHECK: call i64 @llvm.x86.sse42.crc32.64.64
+; CHECK: attributes [[INIT]] = { "target-features"="+crc32" }
+
+; POSTLINK: @obf.tamper_baseline_table = private constant {{.*}} { [8 x i8] c"HIDEIRTC", i64 1,
+
+; WIDE: @obf.tamper_baseline_table = private constant {{.*}} { [8 x i8] c"HIDEIRTW", i{{[0-9]+}} 1,
+; WIDE-LABEL: define i32 @fast(i32 %x)
+; WIDE: hash.words:
+; WIDE-COUNT-4: %hash.lane{{[0-9]*}} = phi i64
+; WIDE: load volatile i64, ptr %{{.*}}, align 1
+; WIDE-NEXT: add i64
+; WIDE-NEXT: mul i64 %{{.*}}, -7046029254386353131
+; WIDE-NOT: @llvm.x86.sse42
@@ -0,0 +1,100 @@
+; RUN: env HIDEIR_TAMPER_MODE=page HIDEIR_TAMPER_EPOCH=250 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TAMPER_MODE=page opt -mtriple=x86_64-apple-macosx -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=NOSEG
+
+; In page mode each protected function's entry only tests its own verified
+; flag, one load from a fixed address. A clear flag re-hashes the function's
+; pages against the table built by the constructor and sets it again. On ELF
+; the constructor finds the executable segment holding the functions with
+; dl_iterate_phdr and hashes all of it, so code past the first 64 bytes of the
+; highest function, or outside the protected functions, is covered too. Each
+; 250 ms epoch, the obf.tamper_epoch thread that every page-mode module of the
+; image shares runs this module's round, which checks the table against its
+; root hash and clears every flag.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @first(i32 %x) {
+entry:
+  %res = mul i32 %x, 3
+  ret i32 %res
+}
+
+define i32 @second(i32 %x) {
+entry:
+  %res = add i32 %x, 3
+  ret i32 %res
+}
+
+; CHECK-NOT: @obf.expected_hash
+; CHECK: @obf.tamper_page_first = private global i32 0
+; CHECK: @obf.tamper_page_flags = private global [2 x i8] c"\01\01"
+; CHECK: @obf.tamper_epoch_record = private global { ptr, ptr } { ptr null, ptr @obf.tamper_epoch_round }
+; CHECK: @obf.tamper_epoch_list = linkonce_odr hidden global ptr null, comdat
+
+; CHECK-LABEL: define i32 @first(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: [[SET:%.*]] = load volatile i8, ptr getelementptr inbounds ([2 x i8], ptr @obf.tamper_page_flags, i32 0, i32 0)
+; CHECK-NEXT: [[OK:%.*]] = icmp ne i8 [[SET]], 0
+; CHECK-NEXT: br i1 [[OK]], label %tamper.cont, label %tamper.verify, !prof
+; CHECK: tamper.verify:
+; CHECK-NEXT: call void @obf.tamper_verify_page(ptr getelementptr inbounds ([2 x i8], ptr @obf.tamper_page_flags, i32 0, i32 0), ptr @first)
+; CHECK-NEXT: br label %tamper.cont
+
+; CHECK-LABEL: define i32 @second(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: load volatile i8, ptr getelementptr inbounds ([2 x i8], ptr @obf.tamper_page_flags, i32 0, i32 1)
+
+; CHECK-LABEL: define internal void @obf.tamper_verify_page(ptr %0, ptr %1)
+; CHECK: %page.own = trunc i64 %{{.*}} to i32
+; CHECK: load i32, ptr @obf.tamper_page_first
+; CHECK: page.visit:
+; CHECK: load volatile i8, ptr
+; CHECK: br i1 %{{.*}}, label %page.ok, label %page.hash
+; CHECK: page.ok:
+; CHECK: store volatile i8 1, ptr
+; CHECK: page.lead:
+; CHECK: icmp ugt i32 %{{.*}}, %page.own
+; CHECK: br i1 %{{.*}}, label %page.exit, label %page.visit
+; CHECK: page.exit:
+; CHECK-NEXT: store volatile i8 1, ptr %0
+; CHECK: hash.end:
+; CHECK: load volatile i32, ptr
+; CHECK: br i1 %{{.*}}, label %page.ok, label %tamper.trap
+
+; CHECK-LABEL: define internal void @obf.tamper_epoch_round()
+; CHECK: epoch.expire:
+; CHECK: call void @llvm.memset.p0.i64(ptr %{{.*}}, i8 0, i64 %{{.*}}, i1 true)
+; CHECK-NEXT: call void @llvm.memset.p0.i64(ptr @obf.tamper_page_flags, i8 0, i64 2, i1 true)
+; CHECK: load volatile i32, ptr @obf.tamper_page_root
+; CHECK: br i1 %{{.*}}, label %epoch.expire, label %tamper.trap
+
+; CHECK-LABEL: define linkonce_odr hidden ptr @obf.tamper_epoch(ptr %0) comdat
+; CHECK: thread.wake:
+; CHECK: call i32 @nanosleep(
+
+; The PT_LOAD (1) segment with PF_X (1) that holds the lowest target
+; CHECK-LABEL: define internal i32 @obf.tamper_page_segment(ptr %0, i64 %1, ptr %2)
+; CHECK: phdr.loop:
+; CHECK: mul i32 %phdr.idx, 56
+; CHECK: icmp eq i32 %{{.*}}, 1
+; CHECK: phdr.found:
+; CHECK: ret i32 1
+
+; CHECK-LABEL: define internal void @obf.tamper_init()
+; CHECK: %page.range = alloca { i64, i64, i64 }
+; CHECK: call i32 @dl_iterate_phdr(ptr @obf.tamper_page_segment, ptr %page.range)
+; CHECK: %page.lo = and i64 %{{.*}}, -4096
+; CHECK: %page.hi = and i64 %{{.*}}, -4096
+; CHECK: call ptr @calloc(
+; CHECK: store i32 %{{.*}}, ptr @obf.tamper_page_first
+; CHECK: page.hash:
+; CHECK: store volatile i32 %{{.*}}, ptr %{{.*}}
+; CHECK: store volatile i32 %{{.*}}, ptr @obf.tamper_page_root
+; CHECK-NEXT: call void @llvm.memset.p0.i64(ptr %{{.*}}, i8 1, i64 {{.*}}, i1 true)
+; CHECK-NEXT: call void @obf.tamper_epoch_register(ptr @obf.tamper_epoch_record, i64 250)
+
+; Without dl_iterate_phdr the pages end with the first 64 bytes of the highest
+; NOSEG-NOT: @obf.tamper_page_segment
+; NOSEG-LABEL: define internal void @obf.tamper_init()
+; NOSEG-NOT: dl_iterate_phdr
+; NOSEG: i64 63), {{(i64 )?}}-4096
@@ -0,0 +1,69 @@
+; RUN: env HIDEIR_TAMPER_BASELINE=postlink opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TAMPER_BASELINE=postlink HIDEIR_TAMPER_MODE=watchdog opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=WATCHDOG
+
+; With post-link baselines nothing is hashed at startup. Each function gets a
+; self-relative entry in the .hideir_tamper table, whose length and hash
+; hideir-tamper-patch fills in after linking; the checks read both from it.
+; A preemptible function is referenced through a private alias so the offset
+; needs no dynamic relocation; an interposable inline copy is left out, since
+; the linker may discard it.
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @exported(i32 %x) {
+entry:
+  %res = mul i32 %x, 3
+  ret i32 %res
+}
+
+define internal i32 @local(i32 %x) {
+entry:
+  %res = add i32 %x, 3
+  ret i32 %res
+}
+
+define linkonce_odr dso_local i32 @inline_local(i32 %x) {
+entry:
+  ret i32 %x
+}
+
+define linkonce_odr i32 @inline_preemptible(i32 %x) {
+entry:
+  ret i32 %x
+}
+
+; CHECK-NOT: @llvm.global_ctors
+; CHECK: @obf.tamper_baseline_table = private constant { [8 x i8], i64, [3 x { i64, i32, i32 }] } { [8 x i8] c"HIDEIRTP", i64 3,
+; CHECK-SAME: { i64 sub (i64 ptrtoint (ptr @obf.tamper_alias.exported to i64), i64 ptrtoint ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 0, i32 0) to i64)), i32 64, i32 0 }
+; CHECK-SAME: { i64 sub (i64 ptrtoint (ptr @local to i64), i64 ptrtoint ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 1, i32 0) to i64)), i32 64, i32 0 }
+; CHECK-SAME: { i64 sub (i64 ptrtoint (ptr @inline_local to i64), i64 ptrtoint ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 2, i32 0) to i64)), i32 64, i32 0 }
+; CHECK-SAME: section ".hideir_tamper", align 8
+; CHECK-NOT: @obf.expected_hash
+; CHECK: @obf.tamper_alias.exported = private alias i32 (i32), ptr @exported
+; CHECK-NOT: @obf.tamper_alias.local
+
+; CHECK-LABEL: define i32 @exported(i32 %x)
+; CHECK: load volatile i32, ptr getelementptr inbounds ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 0, i32 1)
+; CHECK: hash.loop:
+; CHECK: hash.end:
+; CHECK: load volatile i32, ptr getelementptr inbounds ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 0, i32 2)
+; CHECK: br i1 %{{.*}}, label %tamper.cont, label %tamper.trap
+
+; CHECK-LABEL: define linkonce_odr i32 @inline_preemptible(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i32 %x
+
+; CHECK-NOT: define internal void @obf.tamper_init()
+
+; In watchdog mode the constructor only registers the module with the thread.
+; WATCHDOG: @llvm.global_ctors
+; WATCHDOG: @obf.tamper_lengths = private constant [3 x ptr] [ptr getelementptr inbounds ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 0, i32 1), ptr getelementptr inbounds ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 1, i32 1), ptr getelementptr inbounds ({{.*}}@obf.tamper_baseline_table, i32 0, i32 2, i32 2, i32 1)]
+; WATCHDOG-LABEL: define internal void @obf.tamper_init()
+; WATCHDOG-NEXT: entry:
+; WATCHDOG-NEXT: call void @obf.tamper_watchdog_register(ptr @obf.tamper_watchdog_record, i64 1000)
+; WATCHDOG-NEXT: ret void
+; WATCHDOG-LABEL: define internal void @obf.tamper_watchdog_round()
+; WATCHDOG: watchdog.sweep:
+; WATCHDOG: load volatile i32, ptr %{{.*}}
+; WATCHDOG: hash.loop:
@@ -0,0 +1,53 @@
+; RUN: env HIDEIR_TAMPER_MODE=sampled HIDEIR_TAMPER_SAMPLE_RATE=16 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=SAMPLED
+; RUN: env HIDEIR_TAMPER_MODE=sampled HIDEIR_TAMPER_SAMPLE_RATE=16 HIDEIR_TAMPER_JITTER=1 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=JITTER
+; RUN: env HIDEIR_TAMPER_MODE=window HIDEIR_TAMPER_WINDOW=1000 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=WINDOW
+
+; In sampled mode each protected call decrements a thread-local countdown and
+; only hashes the function when it expires; window mode compares the cycle
+; counter against a thread-local deadline. The shared obf.tamper_rearm helper
+; sets the next countdown or deadline.
+
+define i32 @getter(i32 %x) {
+entry:
+  %res = mul i32 %x, 3
+  ret i32 %res
+}
+
+; SAMPLED: @obf.tamper_countdown = internal thread_local global i32 0
+; SAMPLED-LABEL: define i32 @getter(
+; SAMPLED-NEXT: entry:
+; SAMPLED-NEXT: %[[C:.*]] = load i32, ptr @obf.tamper_countdown
+; SAMPLED-NEXT: %[[L:.*]] = sub i32 %[[C]], 1
+; SAMPLED-NEXT: store i32 %[[L]], ptr @obf.tamper_countdown
+; SAMPLED-NEXT: %[[DUE:.*]] = icmp slt i32 %[[L]], 1
+; SAMPLED-NEXT: br i1 %[[DUE]], label %tamper.sample, label %tamper.cont, !prof ![[W:[0-9]+]]
+; SAMPLED: tamper.sample:
+; SAMPLED-NEXT: call void @obf.tamper_rearm()
+; SAMPLED-NEXT: br label %hash.loop
+; SAMPLED: hash.end:
+; SAMPLED: br i1 %{{.*}}, label %tamper.cont, label %tamper.trap
+; SAMPLED-LABEL: define internal void @obf.tamper_rearm()
+; SAMPLED-NEXT: entry:
+; SAMPLED-NEXT: store i32 16, ptr @obf.tamper_countdown
+; SAMPLED: ![[W]] = !{!"branch_weights", i32 1, i32 16}
+
+; JITTER: @obf.tamper_rng = internal thread_local global i32 0
+; JITTER-LABEL: define internal void @obf.tamper_rearm()
+; JITTER: shl i32 %{{.*}}, 13
+; JITTER: lshr i32 %{{.*}}, 17
+; JITTER: shl i32 %{{.*}}, 5
+; JITTER: store i32 %{{.*}}, ptr @obf.tamper_rng
+; JITTER: %[[OFF:.*]] = urem i32 %{{.*}}, 16
+; JITTER-NEXT: %[[NEXT:.*]] = add i32 8, %[[OFF]]
+; JITTER-NEXT: store i32 %[[NEXT]], ptr @obf.tamper_countdown
+
+; WINDOW: @obf.tamper_deadline = internal thread_local global i64 0
+; WINDOW-LABEL: define i32 @getter(
+; WINDOW: %[[NOW:.*]] = call i64 @llvm.readcyclecounter()
+; WINDOW-NEXT: %[[D:.*]] = load i64, ptr @obf.tamper_deadline
+; WINDOW-NEXT: %[[DUE:.*]] = icmp uge i64 %[[NOW]], %[[D]]
+; WINDOW-NEXT: br i1 %[[DUE]], label %tamper.sample, label %tamper.cont
+; WINDOW-LABEL: define internal void @obf.tamper_rearm()
+; WINDOW: %[[T:.*]] = call i64 @llvm.readcyclecounter()
+; WINDOW-NEXT: %[[NEXT:.*]] = add i64 %[[T]], 1000
+; WINDOW-NEXT: store i64 %[[NEXT]], ptr @obf.tamper_deadline
@@ -0,0 +1,107 @@
+; RUN: env HIDEIR_TAMPER_SELECT=auto HIDEIR_TAMPER_MIN_SIZE=4 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TAMPER_SELECT=auto HIDEIR_TAMPER_MIN_SIZE=4 HIDEIR_TAMPER_VOUCH=1 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=VOUCH
+; RUN: rm -f %t && env HIDEIR_TAMPER_SELECT=auto HIDEIR_TAMPER_MIN_SIZE=4 HIDEIR_TAMPER_VOUCH=1 HIDEIR_TAMPER_REPORT=%t opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -disable-output < %s && FileCheck %s --check-prefix=REPORT < %t
+; RUN: rm -f %t.full && env HIDEIR_TAMPER_SELECT=auto HIDEIR_TAMPER_MIN_SIZE=4 HIDEIR_TAMPER_BASELINE=postlink HIDEIR_TAMPER_FULL_LENGTH=1 HIDEIR_TAMPER_HASH=wide HIDEIR_TAMPER_REPORT=%t.full opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -disable-output < %s && FileCheck %s --check-prefix=FULL < %t.full
+
+; Auto selection protects @driver only: @tiny is too small, @helper has a
+; single caller and @always is always inlined, so the inliner would copy
+; their checks into the callers, and @hot runs about 32 times per @driver
+; call. With vouching, @driver's check also verifies @hot.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @tiny(i32 %x) {
+entry:
+  ret i32 %x
+}
+
+define internal i32 @helper(i32 %x) {
+entry:
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 1
+  %c = xor i32 %b, 5
+  ret i32 %c
+}
+
+define i32 @always(i32 %x) alwaysinline {
+entry:
+  %a = mul i32 %x, 5
+  %b = add i32 %a, 1
+  %c = xor i32 %b, 7
+  ret i32 %c
+}
+
+define i32 @hot(i32 %x) {
+entry:
+  %a = mul i32 %x, 7
+  %b = add i32 %a, 1
+  %c = xor i32 %b, 9
+  ret i32 %c
+}
+
+define i32 @driver(i32 %n) {
+entry:
+  %h = call i32 @helper(i32 %n)
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %acc = phi i32 [ %h, %entry ], [ %sum, %loop ]
+  %v = call i32 @hot(i32 %i)
+  %sum = add i32 %acc, %v
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %sum
+}
+
+; CHECK-LABEL: define i32 @tiny(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i32 %x
+; CHECK-LABEL: define internal i32 @helper(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = mul
+; CHECK-LABEL: define i32 @always(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = mul
+; CHECK-LABEL: define i32 @hot(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = mul
+; CHECK-LABEL: define i32 @driver(i32 %n)
+; CHECK: hash.loop:
+; CHECK: getelementptr inbounds i8, ptr @driver
+; CHECK: hash.end:
+; CHECK: load volatile i32, ptr @obf.expected_hash.driver
+; CHECK-NEXT: icmp eq
+; CHECK-NEXT: br i1 %{{.*}}, label %tamper.cont, label %tamper.trap
+; CHECK-LABEL: define internal void @obf.tamper_init()
+; CHECK-NOT: @obf.expected_hash.hot
+; CHECK: store volatile i32 %{{.*}}, ptr @obf.expected_hash.driver
+; CHECK-NOT: store volatile
+
+; VOUCH-LABEL: define i32 @hot(i32 %x)
+; VOUCH-NEXT: entry:
+; VOUCH-NEXT: %a = mul
+; VOUCH-LABEL: define i32 @driver(i32 %n)
+; VOUCH: load volatile i32, ptr @obf.expected_hash.driver
+; VOUCH: br i1 %{{.*}}, label %tamper.vouch, label %tamper.trap
+; VOUCH: tamper.vouch:
+; VOUCH: getelementptr inbounds i8, ptr @hot
+; VOUCH: load volatile i32, ptr @obf.expected_hash.hot
+; VOUCH: br i1 %{{.*}}, label %tamper.cont, label %tamper.trap
+; VOUCH-LABEL: define internal void @obf.tamper_init()
+; VOUCH: store volatile i32 %{{.*}}, ptr @obf.expected_hash.hot
+
+; REPORT: # <stdin>	kernel fnv1a	window 64
+; REPORT-NEXT: skipped	tiny	1	1.0	0	0	too small
+; REPORT-NEXT: skipped	helper	4	1.0	0	0	single caller, inlined
+; REPORT-NEXT: skipped	always	4	1.0	0	0	always inlined
+; REPORT-NEXT: vouched	hot	4	{{[0-9.]+}}	0	0	by driver
+; REPORT-NEXT: protected	driver	10	1.0	128	128	selected
+
+; Whole-function post-link windows are sized by the patcher, which reports
+; the lengths; the pass only names the kernel.
+; FULL: # <stdin>	kernel wide	window full
+; FULL: protected	driver	10	1.0	-	-	selected
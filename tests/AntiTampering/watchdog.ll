@@ -0,0 +1,82 @@
+; RUN: env HIDEIR_TAMPER_MODE=watchdog HIDEIR_TAMPER_WATCHDOG_PERIOD=250 HIDEIR_TAMPER_WATCHDOG_BUDGET=1 opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s
+; RUN: env HIDEIR_TAMPER_MODE=watchdog HIDEIR_TAMPER_WATCHDOG_PERIOD=250 HIDEIR_TAMPER_HASH=wide opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=KERNEL
+; RUN: env HIDEIR_TAMPER_MODE=watchdog HIDEIR_TAMPER_WATCHDOG_PERIOD=250 HIDEIR_TAMPER_HASH=crc32c opt -load-pass-plugin=%{anti_tamper_plugin} -passes="EnterpriseAntiTampering" -S < %s | FileCheck %s --check-prefix=KERNEL
+
+; In watchdog mode the protected functions get no inline checks. The
+; constructor records the baselines and registers the module's round with
+; obf.tamper_watchdog, a detached, reniced thread that every module of the
+; image shares (linkonce_odr in a COMDAT). The thread wakes every 250 ms and
+; runs each registered round; this one re-verifies one function, round-robin.
+; The wide and crc32c kernels leave their byte loop as the constructor's last
+; block, so registration must still land right before the constructor's ret.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @first(i32 %x) {
+entry:
+  %res = mul i32 %x, 3
+  ret i32 %res
+}
+
+define i32 @second(i32 %x) {
+entry:
+  %res = add i32 %x, 3
+  ret i32 %res
+}
+
+; CHECK: @obf.tamper_targets = private constant [2 x ptr] [ptr @first, ptr @second]
+; CHECK: @obf.tamper_baselines = private constant [2 x ptr] [ptr @obf.expected_hash.first, ptr @obf.expected_hash.second]
+; CHECK: @obf.tamper_watchdog_record = private global { ptr, ptr } { ptr null, ptr @obf.tamper_watchdog_round }
+; CHECK: @obf.tamper_watchdog_list = linkonce_odr hidden global ptr null, comdat
+; CHECK: @obf.tamper_watchdog_period = linkonce_odr hidden global i64 -1, comdat
+; CHECK: @obf.tamper_watchdog_started = linkonce_odr hidden global i32 0, comdat
+
+; CHECK-LABEL: define i32 @first(i32 %x)
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %res = mul i32 %x, 3
+
+; CHECK-LABEL: define internal void @obf.tamper_init()
+; CHECK: store volatile i32 %{{.*}}, ptr @obf.expected_hash.second
+; CHECK-NEXT: call void @obf.tamper_watchdog_register(ptr @obf.tamper_watchdog_record, i64 250)
+; CHECK-NEXT: ret void
+
+; KERNEL-LABEL: define internal void @obf.tamper_init()
+; KERNEL: store volatile i32 %{{.*}}, ptr @obf.expected_hash.second
+; KERNEL-NEXT: call void @obf.tamper_watchdog_register(ptr @obf.tamper_watchdog_record, i64 250)
+; KERNEL-NEXT: ret void
+; KERNEL: hash.end:
+; KERNEL-NOT: @obf.tamper_watchdog_register
+; KERNEL: }
+
+; CHECK-LABEL: define internal void @obf.tamper_watchdog_round()
+; CHECK: load i32, ptr @obf.tamper_watchdog_cursor
+; CHECK: watchdog.sweep:
+; CHECK: load ptr, ptr %{{.*}}
+; CHECK: hash.end:
+; CHECK: load volatile i32
+; CHECK: br i1 %{{.*}}, label %watchdog.verified, label %tamper.trap
+; CHECK: watchdog.verified:
+; CHECK: icmp ult i32 %{{.*}}, 1
+; CHECK: watchdog.exit:
+; CHECK-NEXT: store i32 %{{.*}}, ptr @obf.tamper_watchdog_cursor
+; CHECK: tamper.trap:
+; CHECK-NEXT: call void @llvm.trap()
+
+; CHECK-LABEL: define linkonce_odr hidden ptr @obf.tamper_watchdog(ptr %0) comdat
+; CHECK: call i32 @setpriority(i32 0, i32 0, i32 19)
+; CHECK: thread.wake:
+; CHECK: load atomic i64, ptr @obf.tamper_watchdog_period monotonic
+; CHECK: call i32 @nanosleep(ptr %watchdog.period, ptr null)
+; CHECK: load atomic ptr, ptr @obf.tamper_watchdog_list acquire
+; CHECK: thread.visit:
+; CHECK: call void %{{.*}}()
+
+; CHECK-LABEL: define linkonce_odr hidden void @obf.tamper_watchdog_register(ptr %0, i64 %1) comdat
+; CHECK: atomicrmw umin ptr @obf.tamper_watchdog_period, i64 %1 monotonic
+; CHECK: register.push:
+; CHECK: cmpxchg ptr @obf.tamper_watchdog_list, {{(ptr )?}}%{{.*}}, {{(ptr )?}}%0 release monotonic
+; CHECK: register.pushed:
+; CHECK: atomicrmw xchg ptr @obf.tamper_watchdog_started, i32 1 monotonic
+; CHECK: register.start:
+; CHECK: call i32 @pthread_create(ptr %watchdog.tid, ptr null, ptr @obf.tamper_watchdog, ptr null)
+; CHECK: call i32 @pthread_detach(
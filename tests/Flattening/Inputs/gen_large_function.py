@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""Emit a machine-generated-style function with N basic blocks.
+
+The function is a long chain of compare-and-branch blocks, each carrying
+values that are used in later blocks and merged through PHIs, which is the
+shape protocol-parser generators produce. Used by the compile-time tests.
+"""
+import sys
+
+
+def main():
+    n = int(sys.argv[1]) if len(sys.argv) > 1 else 50000
+    out = [
+        "define i32 @generated_parser(ptr %buf, i32 %len) {",
+        "entry:",
+        "  br label %b0",
+    ]
+    # Blocks come in b/m/j triples: b<i> tests a byte and either falls
+    # through to m<i> or skips it; j<i> merges both paths with a PHI.
+    for i in range(n // 3):
+        prev = "%len" if i == 0 else f"%acc{i - 1}"
+        out += [
+            f"b{i}:",
+            f"  %p{i} = getelementptr inbounds i8, ptr %buf, i32 {i % 4096}",
+            f"  %c{i} = load i8, ptr %p{i}",
+            f"  %z{i} = zext i8 %c{i} to i32",
+            f"  %t{i} = icmp ult i32 %z{i}, {(i * 37) % 256}",
+            f"  br i1 %t{i}, label %m{i}, label %j{i}",
+            f"m{i}:",
+            f"  %x{i} = mul i32 {prev}, %z{i}",
+            f"  br label %j{i}",
+            f"j{i}:",
+            f"  %acc{i} = phi i32 [ %x{i}, %m{i} ], [ {prev}, %b{i} ]",
+            f"  br label %b{i + 1}",
+        ]
+    last = n // 3
+    out += [
+        f"b{last}:",
+        f"  ret i32 %acc{last - 1}",
+        "}",
+    ]
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
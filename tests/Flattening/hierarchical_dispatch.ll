@@ -0,0 +1,66 @@
+; RUN: env HIDEIR_FLATTEN_FANOUT=2 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s
+; RUN: env HIDEIR_FLATTEN_FANOUT=2 HIDEIR_FLATTEN_DISPATCH=switch opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s --check-prefix=SWITCH
+; RUN: env HIDEIR_FLATTEN_FANOUT=8 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s --check-prefix=FLAT
+
+; Six dispatch targets with a fanout of 2 give a three-level dispatcher tree:
+; the root splits the state IDs into clusters of 4, the next level into pairs,
+; and every leaf jumps to at most two blocks. No dispatcher has more than two
+; successors.
+
+define i32 @classify(i32 %x) {
+entry:
+  %neg = icmp slt i32 %x, 0
+  br i1 %neg, label %negative, label %check_zero
+
+check_zero:
+  %zero = icmp eq i32 %x, 0
+  br i1 %zero, label %is_zero, label %positive
+
+negative:
+  br label %done
+
+is_zero:
+  br label %done
+
+positive:
+  br label %done
+
+done:
+  %r = phi i32 [ -1, %negative ], [ 0, %is_zero ], [ 1, %positive ]
+  ret i32 %r
+}
+
+; Indirect mode keeps integer state IDs and resolves them through one small
+; block-address table per leaf.
+; CHECK-COUNT-3: @obf.flatten_table{{.*}} = private constant [2 x ptr] [ptr blockaddress(@classify, %{{[a-z_]+}}), ptr blockaddress(@classify, %{{[a-z_]+}})]
+; CHECK-LABEL: define i32 @classify(
+; CHECK: %state_var = alloca i32
+; CHECK: store i32 {{[0-5]}}, ptr %state_var
+; CHECK: indirect_dispatch:
+; CHECK-NEXT: %load_state = load i32, ptr %state_var
+; CHECK-NEXT: %cluster = udiv i32 %load_state, 4
+; CHECK-NEXT: switch i32 %cluster, label %dispatch_default [
+; CHECK-NEXT: i32 0, label %dispatch_node
+; CHECK-NEXT: i32 1, label %dispatch_node{{[0-9]+}}
+; CHECK-NEXT: ]
+; CHECK: dispatch_node:
+; CHECK-NEXT: %node_state = phi i32 [ %load_state, %indirect_dispatch ]
+; CHECK-NEXT: udiv i32 %node_state, 2
+; CHECK: indirectbr ptr %target_addr, [label %{{[a-z_]+}}, label %{{[a-z_]+}}]
+; CHECK-NOT: indirectbr ptr %{{.*}}, [label %{{[^,]*}}, label %{{[^,]*}}, label
+
+; SWITCH-LABEL: define i32 @classify(
+; SWITCH: switch_dispatch:
+; SWITCH-NEXT: %load_state = load i32, ptr %state_var
+; SWITCH-NEXT: %cluster = udiv i32 %load_state, 4
+; SWITCH: dispatch_node{{[0-9]+}}:
+; SWITCH-NEXT: %node_state{{[0-9]+}} = phi i32
+; SWITCH-NEXT: switch i32 %node_state{{[0-9]+}}, label %dispatch_default [
+; SWITCH-NEXT: i32 {{[0-5]}}, label %{{[a-z_]+}}
+; SWITCH-NEXT: i32 {{[0-5]}}, label %{{[a-z_]+}}
+; SWITCH-NEXT: ]
+
+; Below the fanout the single dispatcher and BlockAddress states are unchanged.
+; FLAT-NOT: @obf.flatten_table
+; FLAT: store ptr blockaddress(@classify, %entry_logic), ptr %state_var
+; FLAT-NOT: dispatch_node
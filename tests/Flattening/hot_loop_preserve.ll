@@ -0,0 +1,48 @@
+; RUN: env HIDEIR_FLATTEN_KEEP_HOT_LOOPS=1 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s --check-prefix=ALL
+
+; The hot inner loop must stay intact as a single super-node entered through its
+; preheader, while the straight-line code around it is still flattened.
+define i32 @sum_positive(ptr %buf, i32 %n) {
+entry:
+  %empty = icmp sle i32 %n, 0
+  br i1 %empty, label %done, label %loop.preheader
+
+loop.preheader:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %loop.preheader ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %loop.preheader ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %buf, i32 %i
+  %v = load i32, ptr %p
+  %acc.next = add i32 %acc, %v
+  %i.next = add i32 %i, 1
+  %cont = icmp slt i32 %i.next, %n
+  br i1 %cont, label %loop, label %done
+
+done:
+  %res = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  ret i32 %res
+}
+
+; CHECK: loop.preheader:
+; CHECK-NEXT: br label %loop
+
+; The loop keeps its PHIs and its back edge, with no state traffic inside.
+; CHECK: loop:
+; CHECK-NEXT: %i = phi i32 [ 0, %loop.preheader ], [ %i.next, %loop ]
+; CHECK-NEXT: %acc = phi i32 [ 0, %loop.preheader ], [ %acc.next, %loop ]
+; CHECK-NOT: %state_var
+; CHECK: br i1 %cont, label %loop, label %loop_exit
+
+; Only the exit edge goes back through the dispatcher.
+; CHECK: loop_exit:
+; CHECK: store ptr blockaddress(@sum_positive, %done), ptr %state_var
+; CHECK-NEXT: br label %loop_end
+
+; CHECK: indirect_dispatch:
+; CHECK: indirectbr ptr %load_state, [label %loop.preheader, label %done, label %entry_logic]
+
+; Without the option every block, including the loop, is a dispatcher target.
+; ALL: indirectbr ptr %load_state, [label %loop.preheader, label %loop, label %done, label %entry_logic]
@@ -0,0 +1,9 @@
+; Flattening a machine-generated function with 50k blocks must finish within a
+; fixed time bound, in both the default and the register-state mode.
+; RUN: %{python} %S/Inputs/gen_large_function.py 50000 > %t.ll
+; RUN: timeout 60 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S %t.ll | FileCheck %s
+; RUN: env HIDEIR_FLATTEN_REGISTER_STATE=1 timeout 60 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S %t.ll | FileCheck %s
+
+; CHECK-LABEL: define i32 @generated_parser(
+; CHECK: ret i32
+; CHECK: dispatch_header:
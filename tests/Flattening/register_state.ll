@@ -0,0 +1,39 @@
+; RUN: env HIDEIR_FLATTEN_REGISTER_STATE=1 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s
+
+define i32 @simple_loop(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %next = add i32 %i, 1
+  %cond = icmp slt i32 %next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  ret i32 %i
+}
+
+; Neither the dispatcher state nor the demoted values stay in stack slots.
+; CHECK: entry:
+; CHECK-NOT: alloca
+; CHECK-NOT: store
+; CHECK: br label %dispatch_header
+
+; Transitions hand their next state to loop_end instead of storing it.
+; CHECK: loop:
+; CHECK: %[[SEL:.*]] = select i1 %{{.*}}, ptr blockaddress(@simple_loop, %loop), ptr blockaddress(@simple_loop, %exit)
+; CHECK-NEXT: br label %loop_end
+
+; CHECK: dispatch_header:
+; CHECK: %state = phi ptr [ blockaddress(@simple_loop, %entry_logic), %entry ], [ %state.next, %loop_end ]
+; CHECK: br label %indirect_dispatch
+
+; CHECK: loop_end:
+; CHECK: %state.next = phi ptr [ %[[SEL]], %loop ]
+
+; CHECK: indirect_dispatch:
+; CHECK-NEXT: indirectbr ptr %state, [label %loop, label %exit, label %entry_logic]
+
+; CHECK-NOT: load
+; CHECK-NOT: store
@@ -0,0 +1,53 @@
+; RUN: env HIDEIR_FLATTEN_DISPATCH=switch opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s
+; RUN: env HIDEIR_FLATTEN_DISPATCH=switch opt -load-pass-plugin=%{flattening_plugin} -load-pass-plugin=%{outlining_plugin} -passes="EnterpriseFlattening,EnterpriseFunctionOutlining" -S < %s | FileCheck %s --check-prefix=OUTLINE
+
+define i32 @nested_branches(i32 %x, i32 %y) {
+entry:
+  %c1 = icmp sgt i32 %x, 0
+  br i1 %c1, label %positive, label %negative
+
+positive:
+  %c2 = icmp sgt i32 %y, 0
+  br i1 %c2, label %both_pos, label %mixed
+
+both_pos:
+  %r1 = add i32 %x, %y
+  ret i32 %r1
+
+mixed:
+  %r2 = sub i32 %x, %y
+  ret i32 %r2
+
+negative:
+  %r3 = mul i32 %x, %y
+  ret i32 %r3
+}
+
+; The state is a dense integer ID instead of a block address.
+; CHECK: %state_var = alloca i32
+; CHECK: store i32 {{[0-4]}}, ptr %state_var
+; CHECK: br label %dispatch_header
+
+; CHECK: positive:
+; CHECK: %[[SEL:.*]] = select i1 %c2, i32 {{[0-4]}}, i32 {{[0-4]}}
+; CHECK: store i32 %[[SEL]], ptr %state_var
+; CHECK: br label %loop_end
+
+; CHECK: switch_dispatch:
+; CHECK: %load_state = load i32, ptr %state_var
+; CHECK: switch i32 %load_state, label %dispatch_default [
+; CHECK-DAG: i32 {{[0-4]}}, label %positive
+; CHECK-DAG: i32 {{[0-4]}}, label %both_pos
+; CHECK-DAG: i32 {{[0-4]}}, label %mixed
+; CHECK-DAG: i32 {{[0-4]}}, label %negative
+; CHECK-DAG: i32 {{[0-4]}}, label %entry_logic
+; CHECK: ]
+
+; CHECK: dispatch_default:
+; CHECK-NEXT: unreachable
+
+; CHECK-NOT: blockaddress
+; CHECK-NOT: indirectbr
+
+; Without blockaddress/indirectbr, later passes such as outlining still apply.
+; OUTLINE: define {{.*}} @nested_branches.obf.outlined
@@ -0,0 +1,59 @@
+; RUN: env HIDEIR_FLATTEN_THREADED=1.0 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s
+; RUN: env HIDEIR_FLATTEN_THREADED=1.0 HIDEIR_FLATTEN_DISPATCH=switch HIDEIR_FLATTEN_REGISTER_STATE=1 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s --check-prefix=SWITCH
+; RUN: env HIDEIR_FLATTEN_THREADED=0.5 opt -load-pass-plugin=%{flattening_plugin} -passes="EnterpriseFlattening" -S < %s | FileCheck %s --check-prefix=HALF
+
+; With every block threaded, each one ends in its own copy of the dispatcher:
+; a volatile round trip through the state slot followed by an indirect branch
+; over all targets. Only the shared dispatcher still jumps through loop_end.
+
+define i32 @classify(i32 %x) {
+entry:
+  %neg = icmp slt i32 %x, 0
+  br i1 %neg, label %negative, label %check_zero
+
+check_zero:
+  %zero = icmp eq i32 %x, 0
+  br i1 %zero, label %is_zero, label %positive
+
+negative:
+  br label %done
+
+is_zero:
+  br label %done
+
+positive:
+  br label %done
+
+done:
+  %r = phi i32 [ -1, %negative ], [ 0, %is_zero ], [ 1, %positive ]
+  ret i32 %r
+}
+
+; CHECK-LABEL: define i32 @classify(
+; CHECK: check_zero:
+; CHECK: %[[SEL:.*]] = select i1 %zero, ptr blockaddress(@classify, %is_zero), ptr blockaddress(@classify, %positive)
+; CHECK-NEXT: store volatile ptr %[[SEL]], ptr %state_var
+; CHECK-NEXT: %[[ST:.*]] = load volatile ptr, ptr %state_var
+; CHECK-NEXT: indirectbr ptr %[[ST]], [label %
+; CHECK: negative:
+; CHECK: store volatile ptr blockaddress(@classify, %done), ptr %state_var
+; CHECK-NEXT: load volatile ptr, ptr %state_var
+; CHECK-NEXT: indirectbr
+; CHECK-NOT: br label %loop_end
+; CHECK: indirect_dispatch:
+; CHECK-NEXT: %load_state = load ptr, ptr %state_var
+; CHECK-NEXT: indirectbr ptr %load_state
+
+; SWITCH-LABEL: define i32 @classify(
+; SWITCH: %state_var = alloca i32
+; SWITCH: check_zero:
+; SWITCH: store volatile i32 %{{.*}}, ptr %state_var
+; SWITCH-NEXT: %[[ST:.*]] = load volatile i32, ptr %state_var
+; SWITCH-NEXT: switch i32 %[[ST]], label %dispatch_default [
+; SWITCH: switch_dispatch:
+; SWITCH-NEXT: switch i32 %state, label %dispatch_default [
+
+; Half of the five routed blocks (rounded up) get a copy.
+; HALF-LABEL: define i32 @classify(
+; HALF-COUNT-3: load volatile ptr, ptr %state_var
+; HALF-NOT: load volatile
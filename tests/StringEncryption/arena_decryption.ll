@@ -0,0 +1,59 @@
+; RUN: env HIDEIR_STRING_MODE=arena opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+
+; In arena mode the ciphertext stays in a read-only global. Each use loads the
+; string's slot and only calls into the arena decryptor while it is null; the
+; use then reads the decrypted copy. Constant GEPs into the string become
+; instructions on the copy. A string that another global's initializer points
+; to cannot be redirected and is decrypted in place by the startup constructor,
+; and so is a writable string, which must not become read-only.
+
+@.str = private unnamed_addr constant [13 x i8] c"secret_token\00", align 1
+@.table_str = private unnamed_addr constant [12 x i8] c"table_entry\00", align 1
+@table = global [1 x ptr] [ptr @.table_str]
+@.buf = private unnamed_addr global [8 x i8] c"scratch\00", align 1
+
+declare i32 @puts(ptr)
+
+define void @print_secret() {
+entry:
+  %r = call i32 @puts(ptr @.str)
+  %r2 = call i32 @puts(ptr getelementptr inbounds ([13 x i8], ptr @.str, i64 0, i64 7))
+  ret void
+}
+
+define void @show_buf() {
+entry:
+  %r = call i32 @puts(ptr @.buf)
+  ret void
+}
+
+; CHECK-NOT: c"secret_token\00"
+; CHECK-NOT: c"table_entry\00"
+; CHECK: @.str = private unnamed_addr constant [13 x i8]
+; CHECK: @.table_str = private unnamed_addr global [12 x i8]
+; CHECK: @.buf = private unnamed_addr global [8 x i8]
+; CHECK: @obf.string_arena = private global [13 x i8] zeroinitializer, align 16
+; CHECK: @obf.string_slot = private global ptr null, align 8
+; CHECK: @obf.string_table = private constant [2 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @.table_str, i64 12, i64 {{-?[0-9]+}} }, { ptr, i64, i64 } { ptr @.buf, i64 8, i64 {{-?[0-9]+}} }]
+
+; CHECK-LABEL: define void @print_secret(
+; CHECK: %[[SLOT:string_copy[0-9]*]] = load atomic ptr, ptr @obf.string_slot acquire, align 8
+; CHECK-NEXT: %[[EMPTY:.*]] = icmp eq ptr %[[SLOT]], null
+; CHECK-NEXT: br i1 %[[EMPTY]], label %{{.*}}, label %{{.*}}, !prof
+; CHECK: %[[FRESH:.*]] = call ptr @obf.decrypt_to_arena(ptr @obf.string_flag, ptr @obf.string_slot, ptr @.str, i64 13, i64 {{-?[0-9]+}}, i64 1)
+; CHECK: %[[COPY:string_ptr[0-9]*]] = phi ptr [ %[[SLOT]], %{{.*}} ], [ %[[FRESH]], %{{.*}} ]
+; CHECK-NEXT: call i32 @puts(ptr %[[COPY]])
+; CHECK: %[[COPY2:string_ptr[0-9]*]] = phi ptr
+; CHECK-NEXT: %[[TAIL:.*]] = getelementptr inbounds [13 x i8], ptr %[[COPY2]], i64 0, i64 7
+; CHECK-NEXT: call i32 @puts(ptr %[[TAIL]])
+
+; CHECK-LABEL: define void @show_buf(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %r = call i32 @puts(ptr @.buf)
+
+; CHECK-LABEL: define internal ptr @obf.decrypt_to_arena(
+; CHECK: cmpxchg ptr %0, i32 0, i32 1 acquire acquire
+; CHECK: atomicrmw add ptr @obf.arena_next
+; CHECK: call void @llvm.memcpy
+; CHECK: call void @obf.xor_range(
+; CHECK: store atomic ptr %{{.*}}, ptr %1 release
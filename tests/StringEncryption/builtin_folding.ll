@@ -0,0 +1,68 @@
+; RUN: opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+; RUN: env HIDEIR_STRING_PREFOLD=all opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s --check-prefix=ALL
+; RUN: env HIDEIR_STRING_PREFOLD=none opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s --check-prefix=NONE
+
+; Library calls on string literals are folded before the literals are
+; encrypted, so their results stay constants. A literal whose only uses were
+; folded disappears instead of being encrypted. Small memcpys from a literal
+; become immediate stores only with HIDEIR_STRING_PREFOLD=all, since that puts
+; the copied bytes into the code.
+
+@.len_only = private unnamed_addr constant [13 x i8] c"secret_token\00", align 1
+@.cmd = private unnamed_addr constant [6 x i8] c"start\00", align 1
+@.other = private unnamed_addr constant [6 x i8] c"state\00", align 1
+@.magic = private unnamed_addr constant [9 x i8] c"HIDEIR01\00", align 1
+
+declare i64 @strlen(ptr)
+declare i32 @strcmp(ptr, ptr)
+declare i32 @strncmp(ptr, ptr, i64)
+declare i32 @memcmp(ptr, ptr, i64)
+declare i32 @puts(ptr)
+declare void @llvm.memcpy.p0.p0.i64(ptr, ptr, i64, i1)
+
+define i64 @token_length() {
+  %n = call i64 @strlen(ptr @.len_only)
+  ret i64 %n
+}
+
+define i32 @compare() {
+  %a = call i32 @strcmp(ptr @.cmd, ptr @.other)
+  %b = call i32 @strncmp(ptr @.cmd, ptr @.other, i64 3)
+  %c = call i32 @memcmp(ptr @.other, ptr @.cmd, i64 4)
+  %ab = add i32 %a, %b
+  %r = add i32 %ab, %c
+  %p = call i32 @puts(ptr @.cmd)
+  ret i32 %r
+}
+
+define void @write_header(ptr %dst) {
+  call void @llvm.memcpy.p0.p0.i64(ptr align 1 %dst, ptr align 1 @.magic, i64 8, i1 false)
+  ret void
+}
+
+define i64 @nobuiltin_length() {
+  %n = call i64 @strlen(ptr @.cmd) nobuiltin
+  ret i64 %n
+}
+
+; CHECK-NOT: @.len_only
+; CHECK-NOT: c"start\00"
+; CHECK-NOT: c"HIDEIR01\00"
+; CHECK-LABEL: define i64 @token_length(
+; CHECK-NEXT: ret i64 12
+; CHECK-LABEL: define i32 @compare(
+; CHECK-NEXT: %ab = add i32 -1, 0
+; CHECK-NEXT: %r = add i32 %ab, 1
+; CHECK-NEXT: call i32 @puts(ptr @.cmd)
+; CHECK-LABEL: define void @write_header(
+; CHECK-NEXT: call void @llvm.memcpy.p0.p0.i64(ptr align 1 %dst, ptr align 1 @.magic, i64 8, i1 false)
+; CHECK-LABEL: define i64 @nobuiltin_length(
+; CHECK-NEXT: call i64 @strlen(ptr @.cmd)
+
+; ALL-NOT: @.magic =
+; ALL-LABEL: define void @write_header(
+; ALL-NEXT: store i64 3544423381388773704, ptr %dst, align 1
+
+; NONE: @.len_only = private unnamed_addr global [13 x i8]
+; NONE-LABEL: define i64 @token_length(
+; NONE-NEXT: call i64 @strlen(ptr @.len_only)
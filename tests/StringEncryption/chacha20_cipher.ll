@@ -0,0 +1,36 @@
+; RUN: env HIDEIR_STRING_CIPHER=chacha20 opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+
+; With the ChaCha20 cipher every string is encrypted under one module key with
+; its own nonce, which takes the place of the rolling key in the string table.
+; The kernel computes several keystream blocks per iteration on vectors of
+; state rows, rotating with funnel shifts.
+
+@.str = private unnamed_addr constant [13 x i8] c"secret_token\00", align 1
+@.str.1 = private unnamed_addr constant [15 x i8] c"another_secret\00", align 1
+
+declare i32 @puts(ptr)
+
+define void @print_secrets() {
+entry:
+  %a = call i32 @puts(ptr @.str)
+  %b = call i32 @puts(ptr @.str.1)
+  ret void
+}
+
+; CHECK-NOT: c"secret_token\00"
+; CHECK-NOT: c"another_secret\00"
+; CHECK: @obf.string_key = private constant [8 x i32]
+; CHECK: @obf.string_table = private constant [2 x { ptr, i64, i64 }]
+
+; CHECK-LABEL: define internal void @obf.decrypt_strings(
+; CHECK: call void @obf.chacha20_xor(ptr %data, i64 %len, i64 %key)
+; CHECK-NOT: @obf.xor_range
+
+; CHECK-LABEL: define internal void @obf.chacha20_xor(ptr %0, i64 %1, i64 %2)
+; CHECK: load <4 x i32>, ptr @obf.string_key, align 16
+; CHECK: chunk:
+; CHECK: call <32 x i32> @llvm.fshl.v32i32(
+; CHECK: full:
+; CHECK: xor <16 x i32>
+; CHECK: tail:
+; CHECK: xor i8
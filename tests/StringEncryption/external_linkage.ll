@@ -0,0 +1,29 @@
+; RUN: env HIDEIR_STRING_MODE=lazy opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+; RUN: env HIDEIR_STRING_MODE=arena opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+; RUN: env HIDEIR_STRING_MODE=transient opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+
+; Other modules can read a string that is not local directly, past any guard,
+; slot or stack copy emitted here. Lazy, arena and transient mode therefore
+; leave such a string to the startup constructor and its uses untouched.
+
+@str = constant [13 x i8] c"secret_token\00"
+
+declare i32 @puts(ptr nocapture readonly)
+
+define void @print_secret() {
+entry:
+  %r = call i32 @puts(ptr @str)
+  ret void
+}
+
+; CHECK-NOT: c"secret_token\00"
+; CHECK: @str = global [13 x i8]
+; CHECK-NOT: @obf.string_flag
+; CHECK-NOT: @obf.string_slot
+; CHECK: @obf.string_table = private constant [1 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @str, i64 13, i64 {{-?[0-9]+}} }]
+; CHECK: @llvm.global_ctors = appending global {{.*}}@obf.decrypt_strings
+
+; CHECK-LABEL: define void @print_secret()
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %r = call i32 @puts(ptr @str)
+; CHECK-NEXT: ret void
@@ -0,0 +1,38 @@
+; RUN: env HIDEIR_STRING_MAX_SIZE=64 opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s --check-prefix=LAZY
+; RUN: env HIDEIR_STRING_MAX_SIZE=64 HIDEIR_STRING_LARGE_POLICY=eager opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s --check-prefix=EAGER
+; RUN: env HIDEIR_STRING_MAX_SIZE=64 HIDEIR_STRING_LARGE_POLICY=skip opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s --check-prefix=SKIP
+
+; Strings above HIDEIR_STRING_MAX_SIZE follow the large-blob policy instead of
+; the configured mode: by default they are decrypted on first use, "eager"
+; keeps them in the startup constructor and "skip" leaves them in plaintext.
+; Small strings are always handled by the configured (eager) mode.
+
+@.small = private unnamed_addr constant [13 x i8] c"secret_token\00", align 1
+@.blob = private unnamed_addr constant [81 x i8] c"-----BEGIN CERTIFICATE-----MIIBszCCAVmgAwIBAgIUQ2VydGlmaWNhdGVCbG9iRGF0YQ==-----\00", align 1
+
+declare i32 @puts(ptr)
+
+define void @print_both() {
+entry:
+  %a = call i32 @puts(ptr @.small)
+  %b = call i32 @puts(ptr @.blob)
+  ret void
+}
+
+; LAZY-NOT: c"secret_token\00"
+; LAZY-NOT: c"-----BEGIN CERTIFICATE
+; LAZY: @obf.string_flag = private global i32 0, align 4
+; LAZY: @obf.string_table = private constant [1 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @.small, i64 13, i64 {{-?[0-9]+}} }]
+; LAZY-LABEL: define void @print_both(
+; LAZY: load atomic i32, ptr @obf.string_flag acquire
+; LAZY: call void @obf.decrypt_once(ptr @obf.string_flag, ptr @.blob, i64 81, i64 {{-?[0-9]+}})
+; LAZY: call i32 @puts(ptr @.blob)
+
+; EAGER-NOT: c"-----BEGIN CERTIFICATE
+; EAGER-NOT: @obf.string_flag
+; EAGER: @obf.string_table = private constant [2 x { ptr, i64, i64 }]
+; EAGER-NOT: obf.decrypt_once
+
+; SKIP-NOT: c"secret_token\00"
+; SKIP: @.blob = private unnamed_addr constant [81 x i8] c"-----BEGIN CERTIFICATE
+; SKIP: @obf.string_table = private constant [1 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @.small, i64 13, i64 {{-?[0-9]+}} }]
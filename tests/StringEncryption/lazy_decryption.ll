@@ -0,0 +1,48 @@
+; RUN: env HIDEIR_STRING_MODE=lazy opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+
+; In lazy mode every use of a string is guarded by an acquire load of its own
+; flag, and only the first use calls into the shared decryptor. A string that
+; another global's initializer points to cannot be guarded, so it is still
+; decrypted by the startup constructor.
+
+@.str = private unnamed_addr constant [13 x i8] c"secret_token\00", align 1
+@.table_str = private unnamed_addr constant [12 x i8] c"table_entry\00", align 1
+@table = global [1 x ptr] [ptr @.table_str]
+
+declare i32 @puts(ptr)
+
+define void @print_secret(i1 %twice) {
+entry:
+  %r = call i32 @puts(ptr @.str)
+  br i1 %twice, label %again, label %done
+
+again:
+  %r2 = call i32 @puts(ptr @.str)
+  br label %done
+
+done:
+  ret void
+}
+
+; CHECK-NOT: c"secret_token\00"
+; CHECK-NOT: c"table_entry\00"
+; CHECK: @.str = private unnamed_addr global [13 x i8]
+; CHECK: @obf.string_flag = private global i32 0, align 4
+; CHECK: @obf.string_table = private constant [1 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @.table_str, i64 12, i64 {{-?[0-9]+}} }]
+; CHECK: @llvm.global_ctors = appending global {{.*}}@obf.decrypt_strings
+
+; CHECK-LABEL: define void @print_secret(
+; CHECK: %[[STATE:string_state[0-9]*]] = load atomic i32, ptr @obf.string_flag acquire, align 4
+; CHECK-NEXT: %[[PENDING:.*]] = icmp ne i32 %[[STATE]], 2
+; CHECK-NEXT: br i1 %[[PENDING]], label %{{.*}}, label %{{.*}}, !prof
+; CHECK: call void @obf.decrypt_once(ptr @obf.string_flag, ptr @.str, i64 13, i64 {{-?[0-9]+}})
+; CHECK: call i32 @puts(ptr @.str)
+; CHECK: load atomic i32, ptr @obf.string_flag acquire
+; CHECK: call void @obf.decrypt_once(ptr @obf.string_flag, ptr @.str
+; CHECK: call i32 @puts(ptr @.str)
+
+; CHECK-LABEL: define internal void @obf.decrypt_once(
+; CHECK: cmpxchg ptr %0, i32 0, i32 1 acquire acquire
+; CHECK: call void @obf.xor_range(ptr %1, i64 %2, i64 %3)
+; CHECK-NEXT: store atomic i32 2, ptr %0 release
+; CHECK: load atomic i32, ptr %0 acquire
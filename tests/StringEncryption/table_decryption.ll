@@ -0,0 +1,43 @@
+; RUN: opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+; RUN: opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption,default<O2>" -S < %s | FileCheck %s --check-prefix=OPT
+
+; The startup decryptor is a single loop over a descriptor table, whatever the
+; number or size of the strings, and XORs a 64-bit word at a time.
+
+@.short = private unnamed_addr constant [5 x i8] c"abcd\00", align 1
+@.long = private unnamed_addr constant [41 x i8] c"a string long enough to span a few words\00"
+
+define ptr @get_short() {
+entry:
+  ret ptr @.short
+}
+
+define ptr @get_long() {
+entry:
+  ret ptr @.long
+}
+
+; CHECK: @obf.string_table = private constant [2 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @.short, i64 5, i64 {{-?[0-9]+}} }, { ptr, i64, i64 } { ptr @.long, i64 41, i64 {{-?[0-9]+}} }]
+; CHECK: @obf.string_count = private constant i64 2
+
+; CHECK: define internal void @obf.decrypt_strings() [[ATTRS:#[0-9]+]]
+; CHECK: %num_strings = load volatile i64, ptr @obf.string_count
+; CHECK: decrypt:
+; CHECK: call void @obf.xor_range(ptr %data, i64 %len, i64 %key)
+; CHECK: icmp ult i64 %{{.*}}, %num_strings
+; CHECK-NOT: load volatile i8
+
+; CHECK-LABEL: define internal void @obf.xor_range(
+; CHECK: words:
+; CHECK: load i64, ptr %{{.*}}, align 1
+; CHECK: xor i64
+; CHECK: tail:
+; CHECK: xor i8
+
+; The constructor is no longer optnone, yet the optimizer must not evaluate it
+; and fold the plaintext back into the initializers.
+; CHECK: attributes [[ATTRS]] = { noinline }
+
+; OPT-NOT: c"abcd\00"
+; OPT-NOT: a string long enough
+; OPT: @llvm.global_ctors = {{.*}}@obf.decrypt_strings
@@ -0,0 +1,117 @@
+; RUN: env HIDEIR_STRING_MODE=transient opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s
+; RUN: env HIDEIR_STRING_MODE=transient HIDEIR_STRING_TRANSIENT_BUDGET=4 opt -load-pass-plugin=%{string_plugin} -passes="EnterpriseStringEncryption" -S < %s | FileCheck %s --check-prefix=BUDGET
+
+; Transient mode keeps the ciphertext read-only and decrypts into a stack buffer
+; around each use. Uses outside loops share one slot per function, sized to
+; the largest string, and a call with two string operands takes two. The use
+; inside the loop is decrypted once in the preheader into a buffer of its own
+; and wiped when the loop exits; past the per-function budget such a string is
+; decrypted eagerly. A string that escapes (here, it is returned or handed to
+; a callee that may keep it) cannot live in a stack buffer, and a writable one
+; cannot be made read-only; both are decrypted eagerly instead.
+
+@.msg = private unnamed_addr constant [6 x i8] c"hello\00", align 1
+@.tick = private unnamed_addr constant [5 x i8] c"tick\00", align 1
+@.name = private unnamed_addr constant [9 x i8] c"app_name\00", align 1
+@.ident = private unnamed_addr constant [7 x i8] c"daemon\00", align 1
+@.buf = private unnamed_addr global [8 x i8] c"scratch\00", align 1
+@.fmt = private unnamed_addr constant [7 x i8] c"%s=%d\0A\00", align 1
+@.key = private unnamed_addr constant [4 x i8] c"key\00", align 1
+@.done = private unnamed_addr constant [12 x i8] c"all done ok\00", align 1
+
+declare i32 @puts(ptr)
+declare void @openlog(ptr, i32, i32)
+declare i32 @fprintf(ptr, ptr, ...)
+
+define void @greet(i32 %n) {
+entry:
+  %r = call i32 @puts(ptr @.msg)
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %t = call i32 @puts(ptr @.tick)
+  %next = add i32 %i, 1
+  %cond = icmp slt i32 %next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @report(ptr %f, i32 %v) {
+entry:
+  %p = call i32 (ptr, ptr, ...) @fprintf(ptr %f, ptr @.fmt, ptr @.key, i32 %v)
+  %d = call i32 @puts(ptr @.done)
+  ret void
+}
+
+define ptr @get_name() {
+entry:
+  ret ptr @.name
+}
+
+define void @start_log() {
+entry:
+  call void @openlog(ptr @.ident, i32 1, i32 8)
+  ret void
+}
+
+define void @show_buf() {
+entry:
+  %r = call i32 @puts(ptr @.buf)
+  ret void
+}
+
+; CHECK: @.msg = private unnamed_addr constant [6 x i8]
+; CHECK: @.tick = private unnamed_addr constant [5 x i8]
+; CHECK: @.name = private unnamed_addr global [9 x i8]
+; CHECK: @.ident = private unnamed_addr global [7 x i8]
+; CHECK: @.buf = private unnamed_addr global [8 x i8]
+; CHECK: @obf.string_table = private constant [3 x { ptr, i64, i64 }] [{ ptr, i64, i64 } { ptr @.name, {{.*}} }, { ptr, i64, i64 } { ptr @.ident, {{.*}} }, { ptr, i64, i64 } { ptr @.buf,
+
+; CHECK-LABEL: define void @greet(
+; CHECK: entry:
+; CHECK-DAG: %[[TICK:str_buf[0-9]*]] = alloca [5 x i8]
+; CHECK-DAG: %[[MSG:str_slot[0-9]*]] = alloca [6 x i8]
+; CHECK: call void @llvm.memcpy.p0.p0.i64(ptr align 1 %[[MSG]], ptr align 1 @.msg, i64 6, i1 false)
+; CHECK-NEXT: call void @obf.xor_range(ptr %[[MSG]], i64 6, i64 {{-?[0-9]+}})
+; CHECK-NEXT: %r = call i32 @puts(ptr %[[MSG]])
+; CHECK-NEXT: call void @llvm.memset.p0.i64(ptr align 1 %[[MSG]], i8 0, i64 6, i1 true)
+; CHECK-NEXT: call void @llvm.memcpy.p0.p0.i64(ptr align 1 %[[TICK]], ptr align 1 @.tick, i64 5, i1 false)
+; CHECK-NEXT: call void @obf.xor_range(ptr %[[TICK]], i64 5, i64 {{-?[0-9]+}})
+; CHECK-NEXT: br label %loop
+; CHECK: loop:
+; CHECK-NOT: @obf.xor_range
+; CHECK: %t = call i32 @puts(ptr %[[TICK]])
+; CHECK: exit:
+; CHECK-NEXT: call void @llvm.memset.p0.i64(ptr align 1 %[[TICK]], i8 0, i64 5, i1 true)
+; CHECK-NEXT: ret void
+
+; CHECK-LABEL: define void @report(
+; CHECK: entry:
+; CHECK-DAG: %[[SLOT0:str_slot[0-9]*]] = alloca [12 x i8]
+; CHECK-DAG: %[[SLOT1:str_slot[0-9]*]] = alloca [4 x i8]
+; CHECK-NOT: alloca
+; CHECK: call void @llvm.memcpy.p0.p0.i64(ptr align 1 %[[SLOT0]], ptr align 1 @.fmt, i64 7, i1 false)
+; CHECK: call void @llvm.memcpy.p0.p0.i64(ptr align 1 %[[SLOT1]], ptr align 1 @.key, i64 4, i1 false)
+; CHECK: %p = call i32 (ptr, ptr, ...) @fprintf(ptr %f, ptr %[[SLOT0]], ptr %[[SLOT1]], i32 %v)
+; CHECK: call void @llvm.memcpy.p0.p0.i64(ptr align 1 %[[SLOT0]], ptr align 1 @.done, i64 12, i1 false)
+; CHECK: %d = call i32 @puts(ptr %[[SLOT0]])
+; CHECK-NEXT: call void @llvm.memset.p0.i64(ptr align 1 %[[SLOT0]], i8 0, i64 12, i1 true)
+
+; CHECK-LABEL: define ptr @get_name(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret ptr @.name
+
+; CHECK-LABEL: define void @start_log(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: call void @openlog(ptr @.ident, i32 1, i32 8)
+
+; CHECK-LABEL: define void @show_buf(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %r = call i32 @puts(ptr @.buf)
+
+; BUDGET: @.tick = private unnamed_addr global [5 x i8]
+; BUDGET-LABEL: define void @greet(
+; BUDGET: %t = call i32 @puts(ptr @.tick)
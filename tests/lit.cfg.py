@@ -1,4 +1,5 @@
 import os
+import sys
 import lit.formats
 from lit.llvm import llvm_config
 
@@ -6,6 +7,8 @@ config.name = 'EnterpriseObfuscator'
 config.test_format = lit.formats.ShTest(not llvm_config.use_lit_shell)
 config.suffixes = ['.ll']
 config.test_source_root = os.path.dirname(__file__)
+# Inputs/ holds helper files and generators, not tests
+config.excludes = ['Inputs']
 
 # Map the paths from the site config to lit substitutions
 # Braced syntax %{name} is required to prevent %s from mangling the paths
@@ -17,6 +20,7 @@ config.substitutions.append(('%{outlining_plugin}', config.outlining_plugin_path
 config.substitutions.append(('%{anti_debug_plugin}', config.anti_debug_plugin_path))
 config.substitutions.append(('%{anti_tamper_plugin}', config.anti_tamper_plugin_path))
 config.substitutions.append(('%{api_hiding_plugin}', config.api_hiding_plugin_path))
+config.substitutions.append(('%{python}', sys.executable))
 
 # Add LLVM tools (opt, FileCheck) to the PATH for the tests
 llvm_config.add_tool_substitutions(['opt', 'FileCheck'], config.llvm_tools_dir)
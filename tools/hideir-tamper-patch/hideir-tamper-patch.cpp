@@ -0,0 +1,369 @@
+// hideir-tamper-patch: fill in the AntiTampering baselines of a linked ELF
+// image built with HIDEIR_TAMPER_BASELINE=postlink.
+//
+// Every module protected in post-link mode contributes one table to the
+// .hideir_tamper section (see createBaselineTable in AntiTampering.cpp):
+//   char magic[8] = "HIDEIRT?"; uintN_t count;
+//   struct { intN_t offset; uint32_t length; uint32_t hash; } entries[count];
+// The last magic byte names the hash kernel: 'P' for FNV-1a, 'W' for the wide
+// multiply-add kernel, 'C' for CRC32C. `offset` locates the function relative
+// to its entry. The tool hashes the function bytes in the file with the same
+// kernel as the runtime check (see createHashLoop) and writes the hash back
+// in place. With --full-length, the length is widened
+// from the 64-byte window to the function's symbol size first. With
+// --report, the length and kernel of every patched baseline are appended to
+// the AntiTampering selection report.
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Object/ELF.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::object;
+using namespace llvm::support::endian;
+
+static cl::opt<std::string> InputFile(
+    cl::Positional,
+    cl::desc("<linked ELF image>"),
+    cl::Required);
+
+static cl::opt<bool> FullLength(
+    "full-length",
+    cl::desc("Hash whole functions, sized from the symbol table, instead of "
+             "their first 64 bytes"));
+
+static cl::opt<std::string> ReportFile(
+    "report",
+    cl::desc("Append the hashed length and kernel of every patched baseline "
+             "to <file>"),
+    cl::value_desc("file"));
+
+static cl::opt<bool> Verbose(
+    "v",
+    cl::desc("Print every patched baseline"));
+
+static const char TableMagic[7] = {'H', 'I', 'D', 'E', 'I', 'R', 'T'};
+
+// FNV-1a, as computed by the runtime hash loop
+static uint32_t hashFNV1a(ArrayRef<uint8_t> bytes) {
+    uint32_t hash = 0x811c9dc5;
+    for (uint8_t byte : bytes)
+        hash = (hash ^ byte) * 16777619u;
+    return hash;
+}
+
+// Visit the 32-byte blocks the wide and CRC32C kernels read: offsets 0, 32,
+// 64, ... and a last block at length - 32, overlapping its predecessor if
+// needed. Word k of each block goes to lane k.
+template <class Fn>
+static void forEachBlock(uint64_t length, Fn fn) {
+    uint64_t last = length - 32;
+    for (uint64_t offset = 0;; offset = std::min<uint64_t>(offset + 32, last)) {
+        fn(offset);
+        if (offset >= last)
+            break;
+    }
+}
+
+// Four 64-bit multiply-add lanes, FNV-1a below 32 bytes
+static uint32_t hashWide(ArrayRef<uint8_t> bytes) {
+    if (bytes.size() < 32)
+        return hashFNV1a(bytes);
+
+    const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+    auto mix = [&](uint64_t lane, uint64_t word) {
+        lane = (lane + word) * prime;
+        return lane ^ (lane >> 29);
+    };
+    uint64_t lanes[4] = {0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL,
+                         0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL};
+    forEachBlock(bytes.size(), [&](uint64_t offset) {
+        for (unsigned k = 0; k < 4; ++k)
+            lanes[k] = mix(lanes[k], read64le(bytes.data() + offset + 8 * k));
+    });
+
+    uint64_t hash = lanes[0];
+    for (unsigned k = 1; k < 4; ++k)
+        hash = mix(hash, lanes[k]);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// Four CRC32C (Castagnoli, reflected 0x82f63b78) lanes, each folded into the
+// first as an 8-byte word; a plain CRC32C below 32 bytes. The crc32
+// instruction on an 8-byte word equals the update with its bytes in order.
+static uint32_t hashCRC32C(ArrayRef<uint8_t> bytes) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+            t[i] = crc;
+        }
+        return t;
+    }();
+    auto update = [&](uint32_t crc, ArrayRef<uint8_t> data) {
+        for (uint8_t byte : data)
+            crc = (crc >> 8) ^ table[(crc ^ byte) & 0xff];
+        return crc;
+    };
+
+    if (bytes.size() < 32)
+        return ~update(0xffffffff, bytes);
+
+    uint32_t lanes[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    forEachBlock(bytes.size(), [&](uint64_t offset) {
+        for (unsigned k = 0; k < 4; ++k)
+            lanes[k] = update(lanes[k], bytes.slice(offset + 8 * k, 8));
+    });
+
+    uint32_t crc = lanes[0];
+    for (unsigned k = 1; k < 4; ++k) {
+        uint8_t word[8] = {};
+        write32le(word, lanes[k]);
+        crc = update(crc, word);
+    }
+    return ~crc;
+}
+
+static const char *kernelName(char kernel) {
+    switch (kernel) {
+    case 'W':
+        return "wide";
+    case 'C':
+        return "crc32c";
+    default:
+        return "fnv1a";
+    }
+}
+
+static uint32_t hashBytes(char kernel, ArrayRef<uint8_t> bytes) {
+    switch (kernel) {
+    case 'W':
+        return hashWide(bytes);
+    case 'C':
+        return hashCRC32C(bytes);
+    default:
+        return hashFNV1a(bytes);
+    }
+}
+
+template <class ELFT>
+static Error patchImage(MutableArrayRef<uint8_t> image, unsigned &patched,
+                        std::string &report) {
+    StringRef contents(reinterpret_cast<const char *>(image.data()), image.size());
+    Expected<ELFFile<ELFT>> elfOrErr = ELFFile<ELFT>::create(contents);
+    if (!elfOrErr)
+        return elfOrErr.takeError();
+    const ELFFile<ELFT> &elf = *elfOrErr;
+
+    unsigned type = elf.getHeader().e_type;
+    if (type != ELF::ET_EXEC && type != ELF::ET_DYN)
+        return createStringError(errc::invalid_argument,
+                                 "not a linked executable or shared object");
+
+    auto phdrsOrErr = elf.program_headers();
+    if (!phdrsOrErr)
+        return phdrsOrErr.takeError();
+    auto sectionsOrErr = elf.sections();
+    if (!sectionsOrErr)
+        return sectionsOrErr.takeError();
+
+    // File offset of the loaded bytes [addr, addr + size), or none when
+    // they are not all backed by the file.
+    auto fileOffset = [&](uint64_t addr, uint64_t size) -> std::optional<uint64_t> {
+        for (const auto &phdr : *phdrsOrErr) {
+            if (phdr.p_type != ELF::PT_LOAD)
+                continue;
+            if (addr >= phdr.p_vaddr && addr + size <= phdr.p_vaddr + phdr.p_filesz)
+                return phdr.p_offset + (addr - phdr.p_vaddr);
+        }
+        return std::nullopt;
+    };
+
+    // Function sizes by address, for --full-length, and names, for --report
+    std::map<uint64_t, uint64_t> funcSizes;
+    std::map<uint64_t, StringRef> funcNames;
+    if (FullLength || !ReportFile.empty()) {
+        for (const auto &sec : *sectionsOrErr) {
+            if (sec.sh_type != ELF::SHT_SYMTAB)
+                continue;
+            auto symsOrErr = elf.symbols(&sec);
+            if (!symsOrErr)
+                return symsOrErr.takeError();
+            auto strtabOrErr = elf.getStringTableForSymtab(sec);
+            if (!strtabOrErr)
+                return strtabOrErr.takeError();
+            for (const auto &sym : *symsOrErr) {
+                if (sym.getType() != ELF::STT_FUNC || sym.st_shndx == ELF::SHN_UNDEF)
+                    continue;
+                if (FullLength) {
+                    uint64_t &size = funcSizes[sym.st_value];
+                    size = std::max<uint64_t>(size, sym.st_size);
+                }
+                if (Expected<StringRef> name = sym.getName(*strtabOrErr))
+                    funcNames.emplace(sym.st_value, *name);
+                else
+                    consumeError(name.takeError());
+            }
+        }
+        if (FullLength && funcSizes.empty())
+            WithColor::warning() << InputFile
+                                 << ": no symbol table, keeping 64-byte hash windows\n";
+    }
+
+    const uint64_t wordSize = ELFT::Is64Bits ? 8 : 4;
+    const uint64_t entrySize = wordSize + 8;
+    auto readWord = [&](const uint8_t *p) -> uint64_t {
+        return ELFT::Is64Bits ? read64le(p) : read32le(p);
+    };
+
+    for (const auto &sec : *sectionsOrErr) {
+        auto nameOrErr = elf.getSectionName(sec);
+        if (!nameOrErr)
+            return nameOrErr.takeError();
+        if (*nameOrErr != ".hideir_tamper")
+            continue;
+        if (sec.sh_type == ELF::SHT_NOBITS || sec.sh_offset + sec.sh_size > image.size())
+            return createStringError(errc::invalid_argument,
+                                     ".hideir_tamper is not backed by the file");
+
+        // One table per protected module, word-aligned and back to back
+        uint64_t pos = 0;
+        while (pos + 8 + wordSize <= sec.sh_size) {
+            uint8_t *table = image.data() + sec.sh_offset + pos;
+            char kernel = static_cast<char>(table[sizeof(TableMagic)]);
+            if (std::memcmp(table, TableMagic, sizeof(TableMagic)) != 0 ||
+                (kernel != 'P' && kernel != 'W' && kernel != 'C')) {
+                if (readWord(table) != 0)
+                    return createStringError(errc::invalid_argument,
+                                             "malformed baseline table at offset 0x%llx",
+                                             (unsigned long long)(sec.sh_offset + pos));
+                pos += wordSize;
+                continue;
+            }
+
+            uint64_t count = readWord(table + 8);
+            uint64_t headerSize = 8 + wordSize;
+            if (count > (sec.sh_size - pos - headerSize) / entrySize)
+                return createStringError(errc::invalid_argument,
+                                         "truncated baseline table at offset 0x%llx",
+                                         (unsigned long long)(sec.sh_offset + pos));
+
+            for (uint64_t i = 0; i < count; ++i) {
+                uint8_t *entry = table + headerSize + i * entrySize;
+                uint64_t entryAddr = sec.sh_addr + pos + headerSize + i * entrySize;
+                int64_t offset = ELFT::Is64Bits
+                                     ? static_cast<int64_t>(read64le(entry))
+                                     : static_cast<int32_t>(read32le(entry));
+                uint64_t funcAddr = entryAddr + offset;
+
+                uint64_t length = read32le(entry + wordSize);
+                auto sized = funcSizes.find(funcAddr);
+                if (sized != funcSizes.end() && sized->second > 0 && sized->second <= UINT32_MAX)
+                    length = sized->second;
+
+                std::optional<uint64_t> funcOffset = fileOffset(funcAddr, length);
+                if (!funcOffset)
+                    return createStringError(errc::invalid_argument,
+                                             "function at 0x%llx is not in a loaded segment",
+                                             (unsigned long long)funcAddr);
+
+                uint32_t hash = hashBytes(kernel, ArrayRef<uint8_t>(image.data() + *funcOffset, length));
+                write32le(entry + wordSize, static_cast<uint32_t>(length));
+                write32le(entry + wordSize + 4, hash);
+                ++patched;
+
+                if (Verbose)
+                    outs() << format_hex(funcAddr, 2 + 2 * wordSize) << " length " << length
+                           << " hash " << format_hex(hash, 10) << "\n";
+                if (!ReportFile.empty()) {
+                    raw_string_ostream line(report);
+                    auto name = funcNames.find(funcAddr);
+                    line << "baseline\t";
+                    if (name != funcNames.end())
+                        line << name->second;
+                    else
+                        line << format_hex(funcAddr, 2 + 2 * wordSize);
+                    line << "\t" << kernelName(kernel) << "\t" << length << "\n";
+                }
+            }
+            pos += headerSize + count * entrySize;
+        }
+    }
+    return Error::success();
+}
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+    cl::ParseCommandLineOptions(argc, argv, "HideIR post-link anti-tampering baseline patcher\n");
+
+    auto bufferOrErr = MemoryBuffer::getFile(InputFile, /*IsText=*/false,
+                                             /*RequiresNullTerminator=*/false);
+    if (std::error_code EC = bufferOrErr.getError()) {
+        WithColor::error() << InputFile << ": " << EC.message() << "\n";
+        return 1;
+    }
+    StringRef contents = (*bufferOrErr)->getBuffer();
+    std::vector<uint8_t> image(contents.begin(), contents.end());
+
+    if (image.size() < ELF::EI_NIDENT || std::memcmp(image.data(), ELF::ElfMagic, 4) != 0) {
+        WithColor::error() << InputFile << ": not an ELF file\n";
+        return 1;
+    }
+    if (image[ELF::EI_DATA] != ELF::ELFDATA2LSB) {
+        WithColor::error() << InputFile << ": only little-endian ELF is supported\n";
+        return 1;
+    }
+
+    unsigned patched = 0;
+    std::string report;
+    Error err = image[ELF::EI_CLASS] == ELF::ELFCLASS64
+                    ? patchImage<ELF64LE>(image, patched, report)
+                    : patchImage<ELF32LE>(image, patched, report);
+    if (err) {
+        WithColor::error() << InputFile << ": " << toString(std::move(err)) << "\n";
+        return 1;
+    }
+
+    // Images without post-link baselines are left untouched
+    if (patched == 0)
+        return 0;
+
+    std::error_code EC;
+    raw_fd_ostream out(InputFile, EC, sys::fs::OF_None);
+    if (EC) {
+        WithColor::error() << InputFile << ": " << EC.message() << "\n";
+        return 1;
+    }
+    out.write(reinterpret_cast<const char *>(image.data()), image.size());
+
+    // One "baseline\t<function>\t<kernel>\t<hashed bytes>" line per entry
+    // under a "# <image> (post-link)" header
+    if (!ReportFile.empty()) {
+        raw_fd_ostream reportOut(ReportFile, EC, sys::fs::OF_Append | sys::fs::OF_Text);
+        if (EC) {
+            WithColor::error() << ReportFile << ": " << EC.message() << "\n";
+            return 1;
+        }
+        reportOut << "# " << InputFile << " (post-link)\n" << report;
+    }
+    if (Verbose)
+        outs() << "patched " << patched << " baselines\n";
+    return 0;
+}